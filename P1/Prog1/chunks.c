@@ -95,6 +95,7 @@ void endChunk() {
        statusProd = EXIT_FAILURE;
        pthread_exit (&statusProd);
      }
+  pthread_once (&init, initialization);                                              /* internal data initialization */
 
   while (full)                                                           /* wait if the data transfer region is full */
   { if ((statusProd = pthread_cond_wait (&fifoFull, &accessCR)) != 0)
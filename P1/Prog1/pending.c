@@ -0,0 +1,131 @@
+/**
+ *  \file pending.c (implementation file)
+ *
+ *  \brief Problem name: Count Words.
+ *
+ *  In this file the functions to keep track of the work stored in the data transfer region and not yet processed
+ *  are implemented.
+ *  Synchronization based on monitors.
+ *  Both threads and the monitor are implemented using the pthread library which enables the creation of a
+ *  monitor of the Lampson / Redell type.
+ *
+ *  Definition of the operations carried out by the main thread:
+ *     \li addPending
+ *     \li waitPending.
+ *  Definition of the operations carried out by the worker threads:
+ *     \li removePending
+ *
+ *  \author Diogo Filipe Amaral Carvalho - 92969 - April 2022
+ *  \author Rafael Ferreira Baptista - 93367 - April 2022
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <errno.h>
+
+#include "pending.h"
+
+/** \brief main producer thread return status */
+extern int statusProd;
+
+/** \brief consumer threads return status array */
+extern int *statusWorkers;
+
+/** \brief number of values stored that were not processed yet */
+static unsigned int pending = 0;
+
+/** \brief locking flag which warrants mutual exclusion inside the monitor */
+static pthread_mutex_t accessCR = PTHREAD_MUTEX_INITIALIZER;
+
+/** \brief main thread synchronization point while there are values to be processed */
+static pthread_cond_t allProcessed = PTHREAD_COND_INITIALIZER;
+
+/**
+ *  \brief Count a value about to be stored in the data transfer region as not yet processed.
+ *
+ *  Operation carried out by the main thread, before the value is stored.
+ */
+void addPending ()
+{
+  if ((statusProd = pthread_mutex_lock (&accessCR)) != 0)                                   /* enter monitor */
+     { errno = statusProd;                                                            /* save error in errno */
+       perror ("error on entering monitor(CF)");
+       statusProd = EXIT_FAILURE;
+       pthread_exit (&statusProd);
+     }
+
+  pending += 1;
+
+  if ((statusProd = pthread_mutex_unlock (&accessCR)) != 0)                                  /* exit monitor */
+     { errno = statusProd;                                                            /* save error in errno */
+       perror ("error on exiting monitor(CF)");
+       statusProd = EXIT_FAILURE;
+       pthread_exit (&statusProd);
+     }
+}
+
+/**
+ *  \brief Signal that a value retrieved from the data transfer region was processed.
+ *
+ *  Operation carried out by the workers.
+ *
+ *  \param workerId consumer identification
+ */
+void removePending (unsigned int workerId)
+{
+  if ((statusWorkers[workerId] = pthread_mutex_lock (&accessCR)) != 0)                                   /* enter monitor */
+     { errno = statusWorkers[workerId];                                                            /* save error in errno */
+       perror ("error on entering monitor(CF)");
+       statusWorkers[workerId] = EXIT_FAILURE;
+       pthread_exit (&statusWorkers[workerId]);
+     }
+
+  pending -= 1;
+
+  if ((pending == 0) && ((statusWorkers[workerId] = pthread_cond_signal (&allProcessed)) != 0))  /* let the main thread
+                                                                                           know the batch is done */
+     { errno = statusWorkers[workerId];                                                             /* save error in errno */
+       perror ("error on signaling in allProcessed");
+       statusWorkers[workerId] = EXIT_FAILURE;
+       pthread_exit (&statusWorkers[workerId]);
+     }
+
+  if ((statusWorkers[workerId] = pthread_mutex_unlock (&accessCR)) != 0)                                   /* exit monitor */
+     { errno = statusWorkers[workerId];                                                             /* save error in errno */
+       perror ("error on exiting monitor(CF)");
+       statusWorkers[workerId] = EXIT_FAILURE;
+       pthread_exit (&statusWorkers[workerId]);
+     }
+}
+
+/**
+ *  \brief Wait until every value stored in the data transfer region has been processed.
+ *
+ *  Operation carried out by the main thread.
+ */
+void waitPending ()
+{
+  if ((statusProd = pthread_mutex_lock (&accessCR)) != 0)                                   /* enter monitor */
+     { errno = statusProd;                                                            /* save error in errno */
+       perror ("error on entering monitor(CF)");
+       statusProd = EXIT_FAILURE;
+       pthread_exit (&statusProd);
+     }
+
+  while (pending > 0)                                       /* wait while there are stored values not yet processed */
+  { if ((statusProd = pthread_cond_wait (&allProcessed, &accessCR)) != 0)
+       { errno = statusProd;                                                          /* save error in errno */
+         perror ("error on waiting in allProcessed");
+         statusProd = EXIT_FAILURE;
+         pthread_exit (&statusProd);
+       }
+  }
+
+  if ((statusProd = pthread_mutex_unlock (&accessCR)) != 0)                                  /* exit monitor */
+     { errno = statusProd;                                                            /* save error in errno */
+       perror ("error on exiting monitor(CF)");
+       statusProd = EXIT_FAILURE;
+       pthread_exit (&statusProd);
+     }
+}
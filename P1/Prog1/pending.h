@@ -0,0 +1,50 @@
+/**
+ *  \file pending.h (interface file)
+ *
+ *  \brief Problem name: Count Words.
+ *
+ *  In this file the functions to keep track of the work stored in the data transfer region and not yet processed
+ *  are defined, so the main thread can wait until its workers have processed every value it stored.
+ *  Shared by the worker processes of P2/Prog1 (chunks) and P2/Prog2 (runs of matrices), which wait for the workers
+ *  of a batch before reusing its buffer.
+ *  Synchronization based on monitors.
+ *  Both threads and the monitor are implemented using the pthread library which enables the creation of a
+ *  monitor of the Lampson / Redell type.
+ *
+ *  Definition of the operations carried out by the main thread:
+ *     \li addPending
+ *     \li waitPending.
+ *  Definition of the operations carried out by the worker threads:
+ *     \li removePending
+ *
+ *  \author Diogo Filipe Amaral Carvalho - 92969 - April 2022
+ *  \author Rafael Ferreira Baptista - 93367 - April 2022
+ */
+
+#ifndef PENDING_H
+#define PENDING_H
+
+/**
+ *  \brief Count a value about to be stored in the data transfer region as not yet processed.
+ *
+ *  Operation carried out by the main thread, before the value is stored.
+ */
+extern void addPending ();
+
+/**
+ *  \brief Signal that a value retrieved from the data transfer region was processed.
+ *
+ *  Operation carried out by the workers.
+ *
+ *  \param workerId consumer identification
+ */
+extern void removePending (unsigned int workerId);
+
+/**
+ *  \brief Wait until every value stored in the data transfer region has been processed.
+ *
+ *  Operation carried out by the main thread.
+ */
+extern void waitPending ();
+
+#endif /* PENDING_H */
@@ -0,0 +1,377 @@
+/**
+ *  \file autotune.c (implementation file)
+ *
+ *  \brief Problem name: Compute Matrix Determinant.
+ *
+ *  Benchmark of the kernels of computeDet on the local machine, to write the tuning profile that computeDet loads at
+ *  startup (tuning.c), with the fastest kernels and tile width for a range of orders.
+ *
+ *  Up to order BATCH_MAX_ORDER, every order is benchmarked: each variant of the batched kernels (kernels.c) computes
+ *  the determinants of a batch of MATRICES_PER_BATCH random matrices. From order 1.5 LU_PANEL on (the smaller orders
+ *  have little or no trailing matrix to update), orders 4/3 and 1.5 times apart are benchmarked up to the largest
+ *  order: each variant of the kernel of the trailing matrix update runs, with each tile width, the updates of the
+ *  blocked LU decomposition of a random matrix of the order. The panels are left out, since they are the same for
+ *  every kernel and tile width. Each measurement is repeated for at least the given time.
+ *
+ *  In the benchmark mode (-b) no profile is written: for each order up to SPECIALIZED_MAX_ORDER and each vector
+ *  variant, the batched kernel specialized for the order is measured against the generic kernel of the variant, on
+ *  the same random matrices (fixed seed), and a table with both rates, the speedup and the largest relative difference
+ *  of the determinants is printed.
+ *
+ *  How to compile: gcc -Wall -O3 -o autotune autotune.c kernels.c tuning.c -lm
+ *  How to run: ./autotune -m 2048 -o computeDet.profile
+ *              ./autotune -b -s 0.2
+ *
+ *  \author Diogo Filipe Amaral Carvalho - 92969 - April 2022
+ *  \author Rafael Ferreira Baptista - 93367 - April 2022
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include <time.h>
+#include <libgen.h>
+#include <unistd.h>
+
+#include "kernels.h"
+#include "tuning.h"
+#include "probConst.h"
+
+/** \brief largest tile width benchmarked */
+#define  MAX_TILE  1024
+
+/** \brief function responsible to present the program usage */
+static void printUsage(char *cmdName);
+
+/** \brief function to measure the rate of the batched kernel of a variant */
+static double benchmarkBatch(int variant, bool generic, const double * matrices, int order_of_matrix, double min_time);
+
+/** \brief function to print the table of the specialized batched kernels against the generic ones */
+static void benchmarkSpecialized(double min_time);
+
+/** \brief function to measure the rate of the trailing matrix updates with the kernel of a variant and a tile width */
+static double benchmarkUpdate(int variant, int tile, double * matrix, const double * original, int order_of_matrix,
+                              double min_time);
+
+/** \brief function to run the trailing matrix updates of the blocked LU decomposition of a matrix */
+static void runUpdates(int variant, int tile, double * matrix, const double * original, int order_of_matrix);
+
+/** \brief function to read the monotonic clock, in seconds */
+static double now(void);
+
+int main(int argc, char *argv[])
+{
+    /* process command line arguments */
+
+    int opt;                            /* selected option */
+    char *oName = DEFAULT_PROFILE;      /* profile name */
+    int max_order = 1024;               /* largest order benchmarked */
+    double min_time = 0.05;             /* minimum time of each measurement, in seconds */
+    bool bench = false;                 /* benchmark mode: specialized against generic batched kernels */
+
+    opterr = 0;
+    do
+    {
+        switch ((opt = getopt(argc, argv, "o:m:s:bh")))
+        {
+        case 'o': /* profile name */
+            oName = optarg;
+            break;
+        case 'm': /* largest order */
+            max_order = atoi(optarg);
+            break;
+        case 's': /* minimum time of each measurement */
+            min_time = atof(optarg);
+            break;
+        case 'b': /* benchmark mode */
+            bench = true;
+            break;
+        case 'h': /* help mode */
+            printUsage(basename(argv[0]));
+            return EXIT_SUCCESS;
+        case '?': /* invalid option */
+            fprintf(stderr, "%s: invalid option\n", basename(argv[0]));
+            printUsage(basename(argv[0]));
+            return EXIT_FAILURE;
+        case -1:
+            break;
+        }
+    } while (opt != -1);
+    if (max_order <= 0 || min_time <= 0)
+    {
+        fprintf(stderr, "%s: invalid format\n", basename(argv[0]));
+        printUsage(basename(argv[0]));
+        return EXIT_FAILURE;
+    }
+
+    int heuristic = fastestKernel();    // variant of the built-in heuristics
+    printf("Kernels supported =");
+    for (int variant = 0; variant < NUMBER_OF_KERNELS; variant++)
+        if (kernelSupported(variant))
+            printf(" %s", kernelNames[variant]);
+    printf(" \n");
+
+    if (bench) {
+        benchmarkSpecialized(min_time);
+        return EXIT_SUCCESS;
+    }
+
+    struct Tuning * tunings = malloc((BATCH_MAX_ORDER + 64) * sizeof(struct Tuning));
+    int number_of_tunings = 0;
+    srand48(1);
+
+    /* small orders: the batched kernels */
+
+    double * matrices = malloc((size_t) MATRICES_PER_BATCH * BATCH_MAX_ORDER * BATCH_MAX_ORDER * sizeof(double));
+    for (size_t c = 0; c < (size_t) MATRICES_PER_BATCH * BATCH_MAX_ORDER * BATCH_MAX_ORDER; c++)
+        matrices[c] = 2 * drand48() - 1;
+
+    for (int n = 1; n <= BATCH_MAX_ORDER && n <= max_order; n++) {
+        struct Tuning tuning = { n, heuristic, LU_TILE, KERNEL_SCALAR };
+        double best = 0, baseline = 0;
+
+        for (int variant = 0; variant < NUMBER_OF_KERNELS; variant++) {
+            if (!kernelSupported(variant))
+                continue;
+            double rate = benchmarkBatch(variant, false, matrices, n, min_time);
+            if (variant == heuristic)
+                baseline = rate;
+            if (rate > best) {
+                best = rate;
+                tuning.batch_kernel = variant;
+            }
+        }
+
+        tunings[number_of_tunings++] = tuning;
+        printf("Order %d: %s batched kernel, %.0f matrices/s (%.2f times the built-in heuristics) \n", n,
+               kernelNames[tuning.batch_kernel], best, best / baseline);
+    }
+
+    free(matrices);
+
+    /* larger orders: the kernel and the tile width of the trailing matrix update */
+
+    int row_length = (max_order + ROW_PADDING - 1) / ROW_PADDING * ROW_PADDING;
+    double * matrix = aligned_alloc(ROW_PADDING * sizeof(double), (size_t) max_order * row_length * sizeof(double));
+    double * original = malloc((size_t) max_order * row_length * sizeof(double));
+
+    for (int n = LU_PANEL * 3 / 2, step = 0; n <= max_order; n = (step++ % 2 == 0) ? n * 4 / 3 : n * 3 / 2) {
+        struct Tuning tuning = { n, heuristic, LU_TILE, heuristic };
+        double best = 0, baseline = 0;
+
+        // The coefficients are small, so the updates do not make them grow
+        int length = (n + ROW_PADDING - 1) / ROW_PADDING * ROW_PADDING;
+        for (size_t c = 0; c < (size_t) n * length; c++)
+            original[c] = (c % length < n) ? (2 * drand48() - 1) / n : 0;
+
+        for (int variant = 0; variant < NUMBER_OF_KERNELS; variant++) {
+            if (!kernelSupported(variant))
+                continue;
+            for (int tile = LU_PANEL; tile <= MAX_TILE; tile *= 2) {
+                double rate = benchmarkUpdate(variant, tile, matrix, original, n, min_time);
+                if (variant == heuristic && tile == LU_TILE)
+                    baseline = rate;
+                if (rate > best) {
+                    best = rate;
+                    tuning.update_kernel = variant;
+                    tuning.tile = tile;
+                }
+                if (tile >= n - LU_PANEL)       // wider tiles are all the same
+                    break;
+            }
+        }
+        if (baseline == 0)      // LU_TILE is wider than the trailing matrix
+            baseline = benchmarkUpdate(heuristic, LU_TILE, matrix, original, n, min_time);
+
+        tunings[number_of_tunings++] = tuning;
+        printf("Order %d: %s update kernel, tiles of %d columns, %.3f GFLOP/s (%.2f times the built-in heuristics) \n", n,
+               kernelNames[tuning.update_kernel], tuning.tile, best / 1e9, best / baseline);
+    }
+
+    free(matrix);
+    free(original);
+
+    /* write the profile */
+
+    if (!saveProfile(oName, tunings, number_of_tunings)) {
+        perror("error on writing the tuning profile");
+        exit(EXIT_FAILURE);
+    }
+    free(tunings);
+
+    printf("Tuning profile of %d orders written to %s \n", number_of_tunings, oName);
+
+    return EXIT_SUCCESS;
+}
+
+
+/**
+ *  \brief print usage.
+ */
+static void printUsage(char *cmdName)
+{
+    fprintf(stderr, "\nSynopsis: %s OPTIONS\n"
+                    "  OPTIONS:\n"
+                    "  -h      --- print this help\n"
+                    "  -o      --- tuning profile name (" DEFAULT_PROFILE " by default)\n"
+                    "  -m      --- largest order benchmarked (1024 by default)\n"
+                    "  -s      --- minimum time of each measurement, in seconds (0.05 by default)\n"
+                    "  -b      --- benchmark mode: the specialized batched kernels against the generic ones, no profile is written\n",
+            cmdName);
+}
+
+
+/**
+ *  \brief Function to measure the rate of the batched kernel of a variant.
+ *
+ *  Its role is to compute the determinants of a batch of MATRICES_PER_BATCH matrices again and again, for at least
+ *  the minimum time, after a first run to warm up the caches.
+ *
+ *  \param variant variant of the kernels
+ *  \param matrices pointer to the matrices, one after the other
+ *  \param order_of_matrix order of the matrices
+ *  \param min_time minimum time of the measurement, in seconds
+ *
+ *  \return number of determinants computed per second
+ */
+static double benchmarkBatch(int variant, bool generic, const double * matrices, int order_of_matrix, double min_time) {
+
+    void (*kernel) (int, const double *, int, int, double *) = generic ? determinantBatchGeneric : determinantBatch;
+    double determinants[MATRICES_PER_BATCH];
+    long runs = 0;
+
+    kernel(variant, matrices, order_of_matrix, MATRICES_PER_BATCH, determinants);
+
+    double start = now(), elapsed;
+    do {
+        kernel(variant, matrices, order_of_matrix, MATRICES_PER_BATCH, determinants);
+        runs += 1;
+    } while ((elapsed = now() - start) < min_time);
+
+    return runs * MATRICES_PER_BATCH / elapsed;
+}
+
+
+/**
+ *  \brief Function to print the table of the specialized batched kernels against the generic ones.
+ *
+ *  Its role is to measure, for each order up to SPECIALIZED_MAX_ORDER and each vector variant supported by the
+ *  processor, the rate of the batched kernel specialized for the order and the one of the generic kernel of the
+ *  variant, on the same batch of random matrices (the seed is fixed, so every run benchmarks the same matrices).
+ *  The scalar variant is left out, since it has no specialized kernels.
+ *
+ *  \param min_time minimum time of each measurement, in seconds
+ */
+static void benchmarkSpecialized(double min_time) {
+
+    double * matrices = malloc((size_t) MATRICES_PER_BATCH * SPECIALIZED_MAX_ORDER * SPECIALIZED_MAX_ORDER * sizeof(double));
+    double specialized_dets[MATRICES_PER_BATCH], generic_dets[MATRICES_PER_BATCH];
+
+    srand48(1);
+    for (size_t c = 0; c < (size_t) MATRICES_PER_BATCH * SPECIALIZED_MAX_ORDER * SPECIALIZED_MAX_ORDER; c++)
+        matrices[c] = 2 * drand48() - 1;
+
+    printf("%5s %8s %16s %16s %8s %12s \n", "order", "variant", "specialized/s", "generic/s", "speedup", "difference");
+    for (int n = 1; n <= SPECIALIZED_MAX_ORDER; n++)
+        for (int variant = KERNEL_SCALAR + 1; variant < NUMBER_OF_KERNELS; variant++) {
+            if (!kernelSupported(variant))
+                continue;
+
+            // The matrices of the batch are the first ones of the buffer, so each order uses the same seed
+            double difference = 0;
+            determinantBatch(variant, matrices, n, MATRICES_PER_BATCH, specialized_dets);
+            determinantBatchGeneric(variant, matrices, n, MATRICES_PER_BATCH, generic_dets);
+            for (int m = 0; m < MATRICES_PER_BATCH; m++)
+                if (generic_dets[m] != 0 && fabs(specialized_dets[m] - generic_dets[m]) / fabs(generic_dets[m]) > difference)
+                    difference = fabs(specialized_dets[m] - generic_dets[m]) / fabs(generic_dets[m]);
+
+            double specialized = benchmarkBatch(variant, false, matrices, n, min_time);
+            double generic = benchmarkBatch(variant, true, matrices, n, min_time);
+            printf("%5d %8s %16.0f %16.0f %8.2f %12.1e \n", n, kernelNames[variant], specialized, generic,
+                   specialized / generic, difference);
+        }
+
+    free(matrices);
+}
+
+
+/**
+ *  \brief Function to measure the rate of the trailing matrix updates with the kernel of a variant and a tile width.
+ *
+ *  Its role is to run the updates of the blocked LU decomposition of a matrix again and again, for at least the
+ *  minimum time, after a first run to warm up the caches.
+ *
+ *  \param variant variant of the kernels
+ *  \param tile number of columns of a tile
+ *  \param matrix pointer to a buffer for the matrix, with aligned rows
+ *  \param original pointer to the matrix, with its rows padded to ROW_PADDING coefficients
+ *  \param order_of_matrix order of the matrix
+ *  \param min_time minimum time of the measurement, in seconds
+ *
+ *  \return floating point operations of the updates per second
+ */
+static double benchmarkUpdate(int variant, int tile, double * matrix, const double * original, int order_of_matrix,
+                              double min_time) {
+
+    int n = order_of_matrix;
+    double flops = 0;
+    long runs = 0;
+
+    for (int panel = 0; panel < n; panel += LU_PANEL) {
+        int panel_end = (panel + LU_PANEL < n) ? panel + LU_PANEL : n;
+        flops += 2.0 * (n - panel_end) * (n - panel_end) * (panel_end - panel);
+    }
+
+    runUpdates(variant, tile, matrix, original, n);
+
+    double start = now(), elapsed;
+    do {
+        runUpdates(variant, tile, matrix, original, n);
+        runs += 1;
+    } while ((elapsed = now() - start) < min_time);
+
+    return runs * flops / elapsed;
+}
+
+
+/**
+ *  \brief Function to run the trailing matrix updates of the blocked LU decomposition of a matrix.
+ *
+ *  Its role is to copy the matrix from the original and update it like det_factor (det.c): after each
+ *  panel of LU_PANEL columns, the trailing matrix is updated a tile of columns at a time.
+ *
+ *  \param variant variant of the kernels
+ *  \param tile number of columns of a tile
+ *  \param matrix pointer to a buffer for the matrix, with aligned rows
+ *  \param original pointer to the matrix, with its rows padded to ROW_PADDING coefficients
+ *  \param order_of_matrix order of the matrix
+ */
+static void runUpdates(int variant, int tile, double * matrix, const double * original, int order_of_matrix) {
+
+    int n = order_of_matrix;
+    int row_length = (n + ROW_PADDING - 1) / ROW_PADDING * ROW_PADDING;
+
+    memcpy(matrix, original, (size_t) n * row_length * sizeof(double));
+    for (int panel = 0; panel < n; panel += LU_PANEL) {
+        int panel_end = (panel + LU_PANEL < n) ? panel + LU_PANEL : n;
+
+        for (int t = panel_end; t < n; t += tile)
+            updateKernels[variant](matrix, row_length, panel_end, n, panel, panel_end, t, (t + tile < n) ? t + tile : n);
+    }
+}
+
+
+/**
+ *  \brief Function to read the monotonic clock.
+ *
+ *  \return time, in seconds
+ */
+static double now(void) {
+
+    struct timespec time;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &time);
+
+    return time.tv_sec + time.tv_nsec / 1000000000.0;
+}
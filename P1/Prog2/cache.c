@@ -0,0 +1,473 @@
+/**
+ *  \file cache.c (implementation file)
+ *
+ *  \brief Problem name: Compute Matrix Determinant.
+ *
+ *  In this file the functions of the deduplication cache of the determinants are implemented.
+ *  Synchronization based on monitors.
+ *  Both threads and the monitor are implemented using the pthread library which enables the creation of a
+ *  monitor of the Lampson / Redell type.
+ *
+ *  The coefficients are hashed a row at a time, right after the row is copied, while it is in the L1 cache, by the
+ *  rounds of xxHash64 on four lanes, so the multiplications of the lanes overlap. The entries of the cache are split in
+ *  CACHE_SHARDS shards by their hash, each one a monitor with a table of chained buckets that doubles as it fills up.
+ *
+ *  A cache file is made of CACHE_MAGIC and a record (struct CacheRecord) for each entry.
+ *
+ *  Definition of the operations carried out by the main thread:
+ *     \li initCache
+ *     \li cacheStatistics
+ *     \li saveCache.
+ *  Definition of the operations carried out by the worker threads:
+ *     \li copyAndHash
+ *     \li lookupDeterminant
+ *     \li insertDeterminant.
+ *  Definition of the operations carried out by the reader thread (batch mode):
+ *     \li forgetMatrices.
+ *
+ *  \author Diogo Filipe Amaral Carvalho - 92969 - April 2022
+ *  \author Rafael Ferreira Baptista - 93367 - April 2022
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <pthread.h>
+#include <errno.h>
+
+#include "cache.h"
+
+/** \brief number of shards of the cache (a power of 2) */
+#define  CACHE_SHARDS   64
+
+/** \brief initial number of buckets of a shard (a power of 2) */
+#define  CACHE_BUCKETS  64
+
+/** \brief magic number at the start of a cache file */
+#define  CACHE_MAGIC    "DETCACH1"
+
+/** \brief primes of xxHash64 */
+#define  PRIME1  11400714785074694791ULL
+#define  PRIME2  14029467366897019727ULL
+#define  PRIME3   1609587929392839161ULL
+#define  PRIME4   9650029242287828579ULL
+#define  PRIME5   2870177450012600261ULL
+
+/** \brief struct with an entry of the cache */
+struct CacheEntry {
+   struct CacheKey key;             /* key of the matrix */
+   const double * matrix;           /* matrix, to compare (NULL for the entries loaded from a file) */
+   int row_length;                  /* number of coefficients of a row of the matrix, padding included */
+   double determinant;              /* mantissa of the determinant */
+   int exponent;                    /* binary exponent of the determinant */
+   double seconds;                  /* time taken by the decomposition */
+   struct CacheEntry * next;        /* next entry of the bucket */
+};
+
+/** \brief struct with an entry of a cache file */
+struct CacheRecord {
+   uint64_t hash, check;            /* hashes of the coefficients */
+   int32_t order_of_matrix;         /* order of the matrix */
+   int32_t exponent;                /* binary exponent of the determinant */
+   double determinant;              /* mantissa of the determinant */
+   double seconds;                  /* time taken by the decomposition */
+};
+
+/** \brief struct with a shard of the cache */
+struct Shard {
+   pthread_mutex_t access;          /* locking flag which warrants mutual exclusion inside the shard */
+   struct CacheEntry ** buckets;    /* chained buckets */
+   int number_of_buckets;           /* number of buckets */
+   long number_of_entries;          /* number of entries */
+   long lookups, hits;              /* number of lookups and of determinants found */
+   double seconds_saved;            /* time taken by the decompositions of the determinants found */
+};
+
+/** \brief consumer threads return status array */
+extern int *statusWorkers;
+
+/** \brief shards of the cache */
+static struct Shard shards[CACHE_SHARDS];
+
+/**
+ *  \brief Enter the monitor of a shard.
+ *
+ *  \param workerId worker identification
+ *  \param shard pointer to the shard
+ */
+static void enterShard (unsigned int workerId, struct Shard * shard)
+{
+  if ((statusWorkers[workerId] = pthread_mutex_lock (&shard->access)) != 0)                           /* enter monitor */
+     { errno = statusWorkers[workerId];                                                            /* save error in errno */
+       perror ("error on entering monitor(CA)");
+       statusWorkers[workerId] = EXIT_FAILURE;
+       pthread_exit (&statusWorkers[workerId]);
+     }
+}
+
+/**
+ *  \brief Exit the monitor of a shard.
+ *
+ *  \param workerId worker identification
+ *  \param shard pointer to the shard
+ */
+static void exitShard (unsigned int workerId, struct Shard * shard)
+{
+  if ((statusWorkers[workerId] = pthread_mutex_unlock (&shard->access)) != 0)                          /* exit monitor */
+     { errno = statusWorkers[workerId];                                                            /* save error in errno */
+       perror ("error on exiting monitor(CA)");
+       statusWorkers[workerId] = EXIT_FAILURE;
+       pthread_exit (&statusWorkers[workerId]);
+     }
+}
+
+/**
+ *  \brief Rotate a 64-bit word to the left.
+ */
+static inline uint64_t rotateLeft (uint64_t word, int bits)
+{
+  return (word << bits) | (word >> (64 - bits));
+}
+
+/**
+ *  \brief Round of xxHash64: mix a word into a lane.
+ */
+static inline uint64_t round64 (uint64_t lane, uint64_t word)
+{
+  return rotateLeft (lane + word * PRIME2, 31) * PRIME1;
+}
+
+/**
+ *  \brief Merge the four lanes into a hash, in the given order, and spread its bits (avalanche of xxHash64).
+ */
+static uint64_t mergeLanes (uint64_t a, uint64_t b, uint64_t c, uint64_t d, uint64_t length)
+{
+  uint64_t hash = rotateLeft (a, 1) + rotateLeft (b, 7) + rotateLeft (c, 12) + rotateLeft (d, 18);
+
+  hash = (hash ^ round64 (0, a)) * PRIME1 + PRIME4;
+  hash = (hash ^ round64 (0, b)) * PRIME1 + PRIME4;
+  hash = (hash ^ round64 (0, c)) * PRIME1 + PRIME4;
+  hash = (hash ^ round64 (0, d)) * PRIME1 + PRIME4;
+  hash += length;
+
+  hash ^= hash >> 33;
+  hash *= PRIME2;
+  hash ^= hash >> 29;
+  hash *= PRIME3;
+  hash ^= hash >> 32;
+
+  return hash;
+}
+
+/**
+ *  \brief Find whether an entry holds the determinant of a matrix.
+ */
+static bool matches (const struct CacheEntry * entry, const struct CacheKey * key, const double * matrix, int row_length)
+{
+  if ((entry->key.hash != key->hash) || (entry->key.order_of_matrix != key->order_of_matrix))
+     return false;
+  if (entry->matrix == NULL)
+     return entry->key.check == key->check;
+
+  for (int l = 0; l < key->order_of_matrix; l++)
+    if (memcmp (entry->matrix + (size_t) l * entry->row_length, matrix + (size_t) l * row_length,
+                key->order_of_matrix * sizeof (double)) != 0)
+       return false;
+
+  return true;
+}
+
+/**
+ *  \brief Add an entry to a shard, doubling its buckets when there are twice as many entries.
+ *
+ *  Operation carried out inside the monitor of the shard (or by the main thread, before the workers are created).
+ */
+static void addEntry (struct Shard * shard, struct CacheEntry * entry)
+{
+  if (shard->number_of_entries >= 2 * (long) shard->number_of_buckets)
+     { int number_of_buckets = 2 * shard->number_of_buckets;
+       struct CacheEntry ** buckets = calloc (number_of_buckets, sizeof (struct CacheEntry *));
+
+       for (int b = 0; b < shard->number_of_buckets; b++)
+         while (shard->buckets[b] != NULL)
+         { struct CacheEntry * moved = shard->buckets[b];
+           shard->buckets[b] = moved->next;
+           moved->next = buckets[(moved->key.hash / CACHE_SHARDS) & (number_of_buckets - 1)];
+           buckets[(moved->key.hash / CACHE_SHARDS) & (number_of_buckets - 1)] = moved;
+         }
+       free (shard->buckets);
+       shard->buckets = buckets;
+       shard->number_of_buckets = number_of_buckets;
+     }
+
+  struct CacheEntry ** bucket = &shard->buckets[(entry->key.hash / CACHE_SHARDS) & (shard->number_of_buckets - 1)];
+  entry->next = *bucket;
+  *bucket = entry;
+  shard->number_of_entries += 1;
+}
+
+/**
+ *  \brief Create the cache, with the entries saved to a file by a previous run.
+ *
+ *  Operation carried out by the main thread, before the workers are created. A file that is not a cache file ends the program.
+ *
+ *  \param name name of the file (NULL for an empty cache)
+ *
+ *  \return number of entries loaded (0 if the file does not exist)
+ */
+int initCache (const char * name)
+{
+  for (int s = 0; s < CACHE_SHARDS; s++)
+  { pthread_mutex_init (&shards[s].access, NULL);
+    shards[s].buckets = calloc (CACHE_BUCKETS, sizeof (struct CacheEntry *));
+    shards[s].number_of_buckets = CACHE_BUCKETS;
+    shards[s].number_of_entries = shards[s].lookups = shards[s].hits = 0;
+    shards[s].seconds_saved = 0;
+  }
+
+  FILE * file = (name != NULL) ? fopen (name, "rb") : NULL;
+  if (file == NULL)
+     { if ((name != NULL) && (errno != ENOENT))
+          { perror ("error on opening the cache file");
+            exit (EXIT_FAILURE);
+          }
+       return 0;
+     }
+
+  char magic[sizeof (CACHE_MAGIC) - 1];
+  if ((fread (magic, sizeof (magic), 1, file) != 1) || (memcmp (magic, CACHE_MAGIC, sizeof (magic)) != 0))
+     { fprintf (stderr, "%s: not a cache file\n", name);
+       exit (EXIT_FAILURE);
+     }
+
+  struct CacheRecord record;
+  int loaded = 0;
+  while (fread (&record, sizeof (record), 1, file) == 1)
+  { struct CacheEntry * entry = malloc (sizeof (struct CacheEntry));
+    entry->key = (struct CacheKey) { record.hash, record.check, record.order_of_matrix };
+    entry->matrix = NULL;
+    entry->row_length = 0;
+    entry->determinant = record.determinant;
+    entry->exponent = record.exponent;
+    entry->seconds = record.seconds;
+    addEntry (&shards[record.hash & (CACHE_SHARDS - 1)], entry);
+    loaded += 1;
+  }
+
+  fclose (file);
+
+  return loaded;
+}
+
+/**
+ *  \brief Copy a matrix to a scratch buffer and hash its coefficients.
+ *
+ *  Operation carried out by the workers.
+ *
+ *  \param scratch pointer to the scratch buffer
+ *  \param scratch_length number of coefficients of a row of the scratch buffer, padding included
+ *  \param matrix pointer to the matrix
+ *  \param order_of_matrix order of the matrix
+ *  \param row_length number of coefficients of a row of the matrix, padding included
+ *
+ *  \return key of the matrix
+ */
+struct CacheKey copyAndHash (double * scratch, int scratch_length, const double * matrix, int order_of_matrix, int row_length)
+{
+  uint64_t a = PRIME1 + PRIME2, b = PRIME2, c = 0, d = -PRIME1;                                            /* lanes */
+  int n = order_of_matrix;
+
+  for (int l = 0; l < n; l++)
+  { double * row = scratch + (size_t) l * scratch_length;
+    memcpy (row, matrix + (size_t) l * row_length, n * sizeof (double));
+
+    uint64_t words[4];
+    int j = 0;
+    for (; j + 4 <= n; j += 4)
+    { memcpy (words, row + j, sizeof (words));
+      a = round64 (a, words[0]);
+      b = round64 (b, words[1]);
+      c = round64 (c, words[2]);
+      d = round64 (d, words[3]);
+    }
+    for (; j < n; j++)                                                         /* the last coefficients of the row */
+    { memcpy (words, row + j, sizeof (uint64_t));
+      a = round64 (a, words[0]);
+    }
+  }
+
+  uint64_t length = (uint64_t) n * n * sizeof (double);
+
+  return (struct CacheKey) { mergeLanes (a, b, c, d, length), mergeLanes (d ^ PRIME5, c, b, a, length), n };
+}
+
+/**
+ *  \brief Look up the determinant of a matrix.
+ *
+ *  Operation carried out by the workers.
+ *
+ *  \param workerId worker identification
+ *  \param key key of the matrix
+ *  \param matrix pointer to the matrix (it must stay in memory while the cache is used)
+ *  \param row_length number of coefficients of a row of the matrix, padding included
+ *  \param determinant pointer to a double to store the mantissa of the determinant, if it is found
+ *  \param exponent pointer to an int to store the binary exponent of the determinant, if it is found
+ *
+ *  \return true if the determinant is found
+ */
+bool lookupDeterminant (unsigned int workerId, const struct CacheKey * key, const double * matrix, int row_length,
+                        double * determinant, int * exponent)
+{
+  struct Shard * shard = &shards[key->hash & (CACHE_SHARDS - 1)];
+  bool found = false;
+
+  enterShard (workerId, shard);
+
+  shard->lookups += 1;
+  for (struct CacheEntry * entry = shard->buckets[(key->hash / CACHE_SHARDS) & (shard->number_of_buckets - 1)];
+       (entry != NULL) && !found; entry = entry->next)
+    if (matches (entry, key, matrix, row_length))
+       { *determinant = entry->determinant;
+         *exponent = entry->exponent;
+         shard->hits += 1;
+         shard->seconds_saved += entry->seconds;
+         found = true;
+       }
+
+  exitShard (workerId, shard);
+
+  return found;
+}
+
+/**
+ *  \brief Insert the determinant of a matrix.
+ *
+ *  Operation carried out by the workers.
+ *
+ *  \param workerId worker identification
+ *  \param key key of the matrix
+ *  \param matrix pointer to the matrix (it must stay in memory while the cache is used)
+ *  \param row_length number of coefficients of a row of the matrix, padding included
+ *  \param determinant mantissa of the determinant
+ *  \param exponent binary exponent of the determinant
+ *  \param seconds time taken by the decomposition, saved by each later hit
+ */
+void insertDeterminant (unsigned int workerId, const struct CacheKey * key, const double * matrix, int row_length,
+                        double determinant, int exponent, double seconds)
+{
+  struct Shard * shard = &shards[key->hash & (CACHE_SHARDS - 1)];
+  struct CacheEntry * entry = malloc (sizeof (struct CacheEntry));
+
+  entry->key = *key;
+  entry->matrix = matrix;
+  entry->row_length = row_length;
+  entry->determinant = determinant;
+  entry->exponent = exponent;
+  entry->seconds = seconds;
+
+  enterShard (workerId, shard);
+
+  bool found = false;                           /* another worker may have decomposed the same matrix meanwhile */
+  for (struct CacheEntry * other = shard->buckets[(key->hash / CACHE_SHARDS) & (shard->number_of_buckets - 1)];
+       (other != NULL) && !found; other = other->next)
+    found = matches (other, key, matrix, row_length);
+  if (!found)
+     addEntry (shard, entry);
+
+  exitShard (workerId, shard);
+
+  if (found)
+     free (entry);
+}
+
+/**
+ *  \brief Forget the matrices of a file about to be unmapped.
+ *
+ *  The entries of the matrices of the file are kept, without their matrix, like the entries loaded from a cache file:
+ *  they are checked by the second hash.
+ *
+ *  Operation carried out by the reader thread, in the batch mode, when the matrices of the file are all done.
+ *
+ *  \param readerId reader identification
+ *  \param start pointer to the start of the file mapped in memory
+ *  \param length length of the file
+ */
+void forgetMatrices (unsigned int readerId, const void * start, size_t length)
+{
+  const char * first = start, * last = first + length;
+
+  for (int s = 0; s < CACHE_SHARDS; s++)
+  { enterShard (readerId, &shards[s]);
+
+    for (int b = 0; b < shards[s].number_of_buckets; b++)
+      for (struct CacheEntry * entry = shards[s].buckets[b]; entry != NULL; entry = entry->next)
+        if ((entry->matrix != NULL) && ((const char *) entry->matrix >= first) && ((const char *) entry->matrix < last))
+           entry->matrix = NULL;
+
+    exitShard (readerId, &shards[s]);
+  }
+}
+
+/**
+ *  \brief Get the statistics of the cache.
+ *
+ *  Operation carried out by the main thread, after the workers terminate.
+ *
+ *  \param lookups pointer to a long to store the number of lookups
+ *  \param hits pointer to a long to store the number of determinants found
+ *  \param seconds_saved pointer to a double to store the time the decompositions of the determinants found took
+ *
+ *  \return number of entries
+ */
+long cacheStatistics (long * lookups, long * hits, double * seconds_saved)
+{
+  long entries = 0;
+
+  *lookups = *hits = 0;
+  *seconds_saved = 0;
+  for (int s = 0; s < CACHE_SHARDS; s++)
+  { entries += shards[s].number_of_entries;
+    *lookups += shards[s].lookups;
+    *hits += shards[s].hits;
+    *seconds_saved += shards[s].seconds_saved;
+  }
+
+  return entries;
+}
+
+/**
+ *  \brief Save the cache to a file, for the next runs.
+ *
+ *  The cache is written to a temporary file first, which then replaces the file, so a run that fails halfway does not
+ *  leave a truncated cache behind.
+ *
+ *  Operation carried out by the main thread, after the workers terminate.
+ *
+ *  \param name name of the file
+ *
+ *  \return true if the cache was saved
+ */
+bool saveCache (const char * name)
+{
+  char temporary[strlen (name) + 5];
+  sprintf (temporary, "%s.tmp", name);
+
+  FILE * file = fopen (temporary, "wb");
+  if (file == NULL)
+     return false;
+
+  bool written = (fwrite (CACHE_MAGIC, sizeof (CACHE_MAGIC) - 1, 1, file) == 1);
+  for (int s = 0; s < CACHE_SHARDS; s++)
+    for (int b = 0; b < shards[s].number_of_buckets; b++)
+      for (struct CacheEntry * entry = shards[s].buckets[b]; entry != NULL; entry = entry->next)
+      { struct CacheRecord record = { entry->key.hash, entry->key.check, entry->key.order_of_matrix, entry->exponent,
+                                      entry->determinant, entry->seconds };
+        written = written && (fwrite (&record, sizeof (record), 1, file) == 1);
+      }
+
+  written = (fclose (file) == 0) && written;
+
+  return written && (rename (temporary, name) == 0);
+}
@@ -0,0 +1,143 @@
+/**
+ *  \file cache.h (interface file)
+ *
+ *  \brief Problem name: Compute Matrix Determinant.
+ *
+ *  In this file the functions of the deduplication cache of the determinants are defined.
+ *  Synchronization based on monitors.
+ *  Both threads and the monitor are implemented using the pthread library which enables the creation of a
+ *  monitor of the Lampson / Redell type.
+ *
+ *  Each matrix is hashed while it is copied to the scratch buffer of its worker, and its determinant is looked up in a
+ *  hash map split in shards, each one a monitor of its own, so the workers seldom wait for each other. The matrix of an
+ *  entry with the same hash is compared byte by byte, so two matrices with the same hash are never taken for each
+ *  other. The cache may be saved to a file and loaded by the next runs; the entries loaded have no matrix to compare,
+ *  so they are checked by a second, independent, 64-bit hash instead.
+ *
+ *  Definition of the operations carried out by the main thread:
+ *     \li initCache
+ *     \li cacheStatistics
+ *     \li saveCache.
+ *  Definition of the operations carried out by the worker threads:
+ *     \li copyAndHash
+ *     \li lookupDeterminant
+ *     \li insertDeterminant.
+ *  Definition of the operations carried out by the reader thread (batch mode):
+ *     \li forgetMatrices.
+ *
+ *  \author Diogo Filipe Amaral Carvalho - 92969 - April 2022
+ *  \author Rafael Ferreira Baptista - 93367 - April 2022
+ */
+
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/** \brief struct with the key of a matrix in the cache */
+struct CacheKey {
+   uint64_t hash;             /* hash of the coefficients */
+   uint64_t check;            /* second hash of the coefficients, to check the entries loaded from a file */
+   int order_of_matrix;       /* order of the matrix */
+};
+
+/**
+ *  \brief Create the cache, with the entries saved to a file by a previous run.
+ *
+ *  Operation carried out by the main thread, before the workers are created. A file that is not a cache file ends the program.
+ *
+ *  \param name name of the file (NULL for an empty cache)
+ *
+ *  \return number of entries loaded (0 if the file does not exist)
+ */
+extern int initCache (const char * name);
+
+/**
+ *  \brief Copy a matrix to a scratch buffer and hash its coefficients.
+ *
+ *  Operation carried out by the workers.
+ *
+ *  \param scratch pointer to the scratch buffer
+ *  \param scratch_length number of coefficients of a row of the scratch buffer, padding included
+ *  \param matrix pointer to the matrix
+ *  \param order_of_matrix order of the matrix
+ *  \param row_length number of coefficients of a row of the matrix, padding included
+ *
+ *  \return key of the matrix
+ */
+extern struct CacheKey copyAndHash (double * scratch, int scratch_length, const double * matrix, int order_of_matrix, int row_length);
+
+/**
+ *  \brief Look up the determinant of a matrix.
+ *
+ *  Operation carried out by the workers.
+ *
+ *  \param workerId worker identification
+ *  \param key key of the matrix
+ *  \param matrix pointer to the matrix (it must stay in memory while the cache is used)
+ *  \param row_length number of coefficients of a row of the matrix, padding included
+ *  \param determinant pointer to a double to store the mantissa of the determinant, if it is found
+ *  \param exponent pointer to an int to store the binary exponent of the determinant, if it is found
+ *
+ *  \return true if the determinant is found
+ */
+extern bool lookupDeterminant (unsigned int workerId, const struct CacheKey * key, const double * matrix, int row_length,
+                               double * determinant, int * exponent);
+
+/**
+ *  \brief Insert the determinant of a matrix.
+ *
+ *  Operation carried out by the workers.
+ *
+ *  \param workerId worker identification
+ *  \param key key of the matrix
+ *  \param matrix pointer to the matrix (it must stay in memory while the cache is used)
+ *  \param row_length number of coefficients of a row of the matrix, padding included
+ *  \param determinant mantissa of the determinant
+ *  \param exponent binary exponent of the determinant
+ *  \param seconds time taken by the decomposition, saved by each later hit
+ */
+extern void insertDeterminant (unsigned int workerId, const struct CacheKey * key, const double * matrix, int row_length,
+                               double determinant, int exponent, double seconds);
+
+/**
+ *  \brief Forget the matrices of a file about to be unmapped.
+ *
+ *  The entries of the matrices of the file are kept, without their matrix, like the entries loaded from a cache file:
+ *  they are checked by the second hash.
+ *
+ *  Operation carried out by the reader thread, in the batch mode, when the matrices of the file are all done.
+ *
+ *  \param readerId reader identification
+ *  \param start pointer to the start of the file mapped in memory
+ *  \param length length of the file
+ */
+extern void forgetMatrices (unsigned int readerId, const void * start, size_t length);
+
+/**
+ *  \brief Get the statistics of the cache.
+ *
+ *  Operation carried out by the main thread, after the workers terminate.
+ *
+ *  \param lookups pointer to a long to store the number of lookups
+ *  \param hits pointer to a long to store the number of determinants found
+ *  \param seconds_saved pointer to a double to store the time the decompositions of the determinants found took
+ *
+ *  \return number of entries
+ */
+extern long cacheStatistics (long * lookups, long * hits, double * seconds_saved);
+
+/**
+ *  \brief Save the cache to a file, for the next runs.
+ *
+ *  Operation carried out by the main thread, after the workers terminate.
+ *
+ *  \param name name of the file
+ *
+ *  \return true if the cache was saved
+ */
+extern bool saveCache (const char * name);
+
+#endif /* CACHE_H */
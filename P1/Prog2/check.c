@@ -0,0 +1,108 @@
+/**
+ *  \file check.c (implementation file)
+ *
+ *  \brief Problem name: Compute Matrix Determinant.
+ *
+ *  In this file the function to check the determinants computed against the known ones, written by generate, is
+ *  implemented. It is shared by P1/Prog2/computeDet and P2/Prog2/computeDet.
+ *
+ *  Definition of the operations carried out by the main thread:
+ *     \li checkDeterminants.
+ *
+ *  \author Diogo Filipe Amaral Carvalho - 92969 - April 2022
+ *  \author Rafael Ferreira Baptista - 93367 - April 2022
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "check.h"
+
+/** \brief function to sort the relative errors of the determinants, for qsort */
+static int compareErrors(const void * a, const void * b);
+
+/**
+ *  \brief Function to check the determinants against the known ones.
+ *
+ *  Its role is to read the known determinants ("id sign log10|det|" lines, as written by generate) and print the
+ *  distribution of the relative errors of the determinants computed: the median, the largest one and the number of
+ *  matrices in each range. The errors are computed from the logarithms, so they do not overflow at large orders.
+ *  A determinant with the wrong sign is counted apart. Any error reading the file ends the program.
+ *
+ *  \param aName name of the file with the known determinants
+ *  \param determinants mantissa of the determinant of each matrix
+ *  \param exponents binary exponent of the determinant of each matrix
+ *  \param number_of_matrices number of matrices
+ *
+ *  \return largest relative error (INFINITY if a determinant has the wrong sign)
+ */
+double checkDeterminants(const char * aName, const double * determinants, const int * exponents, int number_of_matrices) {
+
+    FILE * answers = fopen(aName, "r");
+    if (answers == NULL) {
+        fprintf(stderr, "It occoured an error while openning file. \n");
+        exit(EXIT_FAILURE);
+    }
+
+    double * errors = malloc((number_of_matrices + 1) * sizeof(double));
+    int wrong_signs = 0;
+
+    for (int m = 0; m < number_of_matrices; m++) {
+        int matrix_id, sign;
+        double log_determinant;
+        if (fscanf(answers, "%d %d %lf", &matrix_id, &sign, &log_determinant) != 3 || matrix_id != m + 1) {
+            fprintf(stderr, "%s: the determinant of matrix %d is missing\n", aName, m + 1);
+            exit(EXIT_FAILURE);
+        }
+
+        double mantissa = determinants[m];
+        if ((mantissa > 0) - (mantissa < 0) != sign) {
+            errors[m] = INFINITY;
+            wrong_signs += 1;
+        } else if (sign == 0)
+            errors[m] = 0;
+        else
+            errors[m] = fabs(expm1((log10(fabs(mantissa)) + exponents[m] * log10(2.0) - log_determinant) * log(10.0)));
+    }
+    fclose(answers);
+
+    qsort(errors, number_of_matrices, sizeof(double), compareErrors);
+
+    printf("\nDeterminants checked against %s: %d matrices, %d with the wrong sign \n", aName, number_of_matrices, wrong_signs);
+    if (number_of_matrices > wrong_signs)
+        printf("Relative error: median %.2e, max %.2e \n", errors[number_of_matrices / 2], errors[number_of_matrices - wrong_signs - 1]);
+
+    // Number of matrices in each range of errors (the errors are sorted)
+    static const double limits[] = {1e-15, 1e-13, 1e-11, 1e-9, 1e-7, 1e-5, INFINITY};
+    double lower = 0;
+    int m = 0;
+    for (int l = 0; l < (int) (sizeof(limits) / sizeof(limits[0])); l++) {
+        int first = m;
+        while (m < number_of_matrices && errors[m] < limits[l])
+            m++;
+        printf("  [%.0e, %.0e[ : %d \n", lower, limits[l], m - first);
+        lower = limits[l];
+    }
+
+    double largest = (number_of_matrices > 0) ? errors[number_of_matrices - 1] : 0;
+    free(errors);
+
+    return largest;
+}
+
+
+/**
+ *  \brief Function to compare two relative errors, for qsort.
+ *
+ *  \param a pointer to an error
+ *  \param b pointer to another error
+ *
+ *  \return negative if the first error is the smallest
+ */
+static int compareErrors(const void * a, const void * b) {
+
+    double first = *(const double *) a, second = *(const double *) b;
+
+    return (first > second) - (first < second);
+}
@@ -0,0 +1,37 @@
+/**
+ *  \file check.h (interface file)
+ *
+ *  \brief Problem name: Compute Matrix Determinant.
+ *
+ *  In this file the function to check the determinants computed against the known ones, written by generate, is defined.
+ *
+ *  Definition of the operations carried out by the main thread:
+ *     \li checkDeterminants.
+ *
+ *  \author Diogo Filipe Amaral Carvalho - 92969 - April 2022
+ *  \author Rafael Ferreira Baptista - 93367 - April 2022
+ */
+
+#ifndef CHECK_H
+#define CHECK_H
+
+/**
+ *  \brief Check the determinants against the known ones and print the distribution of their relative errors.
+ *
+ *  The known determinants are read as "id sign log10|det|" lines; the median, the largest error and the number of
+ *  matrices in each range of errors are printed. A determinant with the wrong sign is counted apart. Any error
+ *  reading the file ends the program.
+ *
+ *  Operation carried out by the main thread, after the determinants are computed.
+ *
+ *  \param aName name of the file with the known determinants
+ *  \param determinants mantissa of the determinant of each matrix
+ *  \param exponents binary exponent of the determinant of each matrix
+ *  \param number_of_matrices number of matrices
+ *
+ *  \return largest relative error (INFINITY if a determinant has the wrong sign)
+ */
+extern double checkDeterminants (const char * aName, const double * determinants, const int * exponents, int number_of_matrices);
+
+
+#endif /* CHECK_H */
@@ -3,18 +3,42 @@
  *
  *  \brief Problem name: Compute Matrix Determinant.
  *
- *  In this file the functions to save/get the information of each matrix are implemented.
+ *  In this file the functions to get the information of each matrix are implemented.
  *  Synchronization based on monitors.
  *  Both threads and the monitor are implemented using the pthread library which enables the creation of a
  *  monitor of the Lampson / Redell type.
  *
- *  Data transfer region implemented as a monitor.
+ *  The matrices are read in place, from the file mapped in memory: the monitor only hands out the next matrix
+ *  (or batch of small matrices) to the worker that asks for it.
+ *
+ *  The matrices of a container file are handed out from a work list, in the order of the list.
+ *
+ *  In the streaming mode, the matrices are read from a file, pipe or stdin by the worker that asks for them, into a buffer
+ *  of its own, and the determinants are written to the output file in the order of the matrices, as soon as all the
+ *  matrices before them are done. The matrices handed out but not written yet are kept in a window of STREAM_WINDOW
+ *  matrices, so the memory used does not depend on the number of matrices.
+ *
+ *  In the exact mode, the determinant of each matrix modulo each of its primes is a task of its own, so the matrices of
+ *  a file with few matrices are spread over all the workers. The tasks are handed out matrix by matrix.
+ *
+ *  In the batch mode, the files are mapped in memory by a reader thread, a few at a time, and put in a window of open
+ *  files; the matrices are handed out from the first file of the window with matrices left, so the workers go on to
+ *  the next file while the last matrices of a file are decomposed. The matrices handed out to a worker are done when it
+ *  asks for more, and a file whose matrices are all done is given back to the reader, which unmaps it and maps the next.
  *
  *  Definition of the operations carried out by the main thread:
- *     \li putMatrix
- *     \li endMatrix.
+ *     \li initMatrices
+ *     \li initMatrixList
+ *     \li initStream
+ *     \li initResidueTasks
+ *     \li initFiles.
+ *  Definition of the operations carried out by the reader thread (batch mode):
+ *     \li putFile
+ *     \li retireFile.
  *  Definition of the operations carried out by the worker threads:
  *     \li getMatrix
+ *     \li putDeterminants
+ *     \li getResidueTask.
  *
  *  \author Diogo Filipe Amaral Carvalho - 92969 - April 2022
  *  \author Rafael Ferreira Baptista - 93367 - April 2022
@@ -23,6 +47,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <math.h>
 #include <unistd.h>
 #include <pthread.h>
 #include <errno.h>
@@ -34,160 +59,393 @@ struct MatrixInfo {
    int matrix_id;        /* matrix identifier */  
    int order_of_matrix;    /* Order of the matrix */
    double * matrix_pointer;  /* Pointer to the start of the matrix */
+   int number_of_matrices;   /* Number of matrices stored one after the other (a batch of small matrices) */
+   int row_length;           /* Number of coefficients of a row of the matrix, padding included */
+   const struct MatrixInfo * list;   /* Matrices of a batch taken from a work list (NULL if they are one after the other) */
 };
 
-/** \brief main producer thread return status */
-extern int statusProd;
+/** \brief struct to store the information of a file of the batch mode */
+struct MatrixFile {
+   int file_id;                      /* index of the file */
+   int first_id;                     /* identifier of the first matrix of the file */
+   int number_of_matrices;           /* number of matrices */
+   int order_of_matrix;              /* order of the matrices (legacy file) */
+   double * matrices;                /* pointer to the first matrix (legacy file) */
+   const struct MatrixInfo * list;   /* work list of the matrices (container file, NULL for a legacy file) */
+   int handed_out;                   /* number of matrices handed out */
+   int done;                         /* number of matrices done */
+};
+
+/** \brief struct to store one task of the exact mode */
+struct ResidueTask {
+   int matrix;           /* index of the matrix (-1 if there are no more tasks) */
+   int prime;            /* index of the prime */
+};
 
 /** \brief consumer threads return status array */
 extern int *statusWorkers;
 
-/** \brief storage region for matrixes struct */
-static struct MatrixInfo mem[K];
+/** \brief pointer to the first matrix of the file mapped in memory */
+static double * matrices;
+
+/** \brief number of matrices of the file */
+static int number_of_matrix;
+
+/** \brief order of the matrices of the file */
+static int order_of_matrix;
+
+/** \brief number of matrices handed out at a time */
+static int batch_size;
+
+/** \brief index of the next matrix to hand out */
+static int next_matrix;
+
+/** \brief work list of the matrices (NULL if the matrices are one after the other) */
+static const struct MatrixInfo * workList;
+
+/** \brief file the matrices are read from, in the streaming mode (NULL if the file is mapped in memory) */
+static FILE * input;
+
+/** \brief file the determinants are written to, in the streaming mode */
+static FILE * output;
+
+/** \brief buffer of each worker for the matrices read from the input, in the streaming mode */
+static double ** streamBuffers;
+
+/** \brief determinants of the matrices handed out and not written yet, in the streaming mode (mantissa and binary exponent) */
+static double window[STREAM_WINDOW];
+static int windowExponents[STREAM_WINDOW];
+
+/** \brief flags signaling the determinants of the window that are computed */
+static bool windowDone[STREAM_WINDOW];
+
+/** \brief the determinants are written as their sign and log10 of their absolute value */
+static bool logMode;
+
+/** \brief index of the next determinant to write */
+static int next_to_write;
+
+/** \brief number of primes of each matrix, in the exact mode */
+static const int * primesPerMatrix;
+
+/** \brief index of the next prime of the matrix next_matrix to hand out, in the exact mode */
+static int next_prime;
 
-/** \brief insertion pointer */
-static unsigned int ii;
+/** \brief window of the files open at once, in the batch mode (NULL otherwise) */
+static struct MatrixFile * openFiles;
 
-/** \brief retrieval pointer */
-static unsigned int ri;
+/** \brief flags signaling the slots of the window in use */
+static bool * slotInUse;
 
-/** \brief flag signaling the data transfer region is full */
-static bool full;
+/** \brief number of slots of the window */
+static int number_of_slots;
+
+/** \brief number of files, and of files put in the window by the reader */
+static int number_of_files, files_put;
+
+/** \brief slot of the file of the matrices handed out to each worker, and their number (0 if they are done) */
+static int * heldSlot, * heldCount;
 
 /** \brief locking flag which warrants mutual exclusion inside the monitor */
 static pthread_mutex_t accessCR = PTHREAD_MUTEX_INITIALIZER;
 
-/** \brief flag which warrants that the data transfer region is initialized exactly once */
-static pthread_once_t init = PTHREAD_ONCE_INIT;;
+/** \brief workers synchronization point when the window is full */
+static pthread_cond_t windowFull = PTHREAD_COND_INITIALIZER;
+
+/** \brief workers synchronization point when the files of the window are all handed out (batch mode) */
+static pthread_cond_t fileReady = PTHREAD_COND_INITIALIZER;
 
-/** \brief producers synchronization point when the data transfer region is full */
-static pthread_cond_t fifoFull;
+/** \brief reader synchronization point when no file of the window is done (batch mode) */
+static pthread_cond_t fileDone = PTHREAD_COND_INITIALIZER;
 
-/** \brief consumers synchronization point when the data transfer region is empty */
-static pthread_cond_t fifoEmpty;
+/** \brief function to get the next matrix (or batch of matrices) from the window of open files (batch mode) */
+static struct MatrixInfo getFileMatrix (unsigned int workerId);
 
 /**
- *  \brief Initialization of the data transfer region.
+ *  \brief Set the matrices to hand out.
  *
- *  Internal monitor operation.
+ *  Operation carried out by the main thread, before the workers are created.
+ *
+ *  \param matrix_pointer pointer to the first matrix (the matrices are stored one after the other, row by row)
+ *  \param number_of_matrices number of matrices
+ *  \param order order of the matrices
+ *  \param matrices_per_get number of matrices handed out at a time
  */
-static void initialization (void)
+void initMatrices (double * matrix_pointer, int number_of_matrices, int order, int matrices_per_get)
 {
-                                                                                   /* initialize FIFO in empty state */
-  ii = ri = 0;                                        /* FIFO insertion and retrieval pointers set to the same value */
-  full = false;                                                                                  /* FIFO is not full */
+  matrices = matrix_pointer;
+  number_of_matrix = number_of_matrices;
+  order_of_matrix = order;
+  batch_size = matrices_per_get;
+  next_matrix = 0;
+}
 
-  pthread_cond_init (&fifoFull, NULL);                                      /* initialize main synchronization point */
-  pthread_cond_init (&fifoEmpty, NULL);                                  /* initialize workers synchronization point */
+/**
+ *  \brief Set the work list of the matrices to hand out.
+ *
+ *  Operation carried out by the main thread, before the workers are created.
+ *  Consecutive matrices of the list with the same order, up to BATCH_MAX_ORDER, are handed out together.
+ *
+ *  \param list work list, with the information of each matrix
+ *  \param number_of_matrices number of matrices
+ *  \param matrices_per_get maximum number of matrices handed out at a time
+ */
+void initMatrixList (const struct MatrixInfo * list, int number_of_matrices, int matrices_per_get)
+{
+  initMatrices (NULL, number_of_matrices, 0, matrices_per_get);
+  workList = list;
 }
 
+/**
+ *  \brief Set the file to read the matrices from and the file to write the determinants to (streaming mode).
+ *
+ *  Operation carried out by the main thread, before the workers are created, after reading the header of the input.
+ *
+ *  \param input_file file, pipe or stdin positioned at the first matrix
+ *  \param output_file file to write the determinants to
+ *  \param number_of_matrices number of matrices
+ *  \param order order of the matrices
+ *  \param matrices_per_get number of matrices handed out at a time (at most STREAM_WINDOW)
+ *  \param number_of_workers number of workers
+ *  \param log_mode true to write the sign and log10 of the absolute value of each determinant
+ */
+void initStream (FILE * input_file, FILE * output_file, int number_of_matrices, int order, int matrices_per_get,
+                 int number_of_workers, bool log_mode)
+{
+  initMatrices (NULL, number_of_matrices, order, matrices_per_get);
+  input = input_file;
+  output = output_file;
+  streamBuffers = calloc (number_of_workers, sizeof (double *));
+  logMode = log_mode;
+  next_to_write = 0;
+}
 
 /**
- *  \brief Store a struct in fifo to inform that there are no more matrices to be processed.
+ *  \brief Set the tasks of the exact mode: the determinant of each matrix modulo each of its primes.
  *
- *  Operation carried out by the main thread.
+ *  Operation carried out by the main thread, before the workers are created.
  *
+ *  \param primes_per_matrix number of primes of each matrix
+ *  \param number_of_matrices number of matrices
  */
-void endMatrix() {
-  if ((statusProd = pthread_mutex_lock (&accessCR)) != 0)                                   /* enter monitor */
-     { errno = statusProd;                                                            /* save error in errno */
+void initResidueTasks (const int * primes_per_matrix, int number_of_matrices)
+{
+  initMatrices (NULL, number_of_matrices, 0, 1);
+  primesPerMatrix = primes_per_matrix;
+  next_prime = 0;
+}
+
+/**
+ *  \brief Set the files to hand out the matrices of (batch mode).
+ *
+ *  Operation carried out by the main thread, before the workers and the reader are created.
+ *
+ *  \param number_of_input_files number of files
+ *  \param files_open_at_once maximum number of files in the window
+ *  \param matrices_per_get number of matrices of order above BATCH_MAX_ORDER of a legacy file handed out at a time
+ *  \param number_of_workers number of workers
+ */
+void initFiles (int number_of_input_files, int files_open_at_once, int matrices_per_get, int number_of_workers)
+{
+  initMatrices (NULL, 0, 0, matrices_per_get);
+  number_of_files = number_of_input_files;
+  number_of_slots = files_open_at_once;
+  files_put = 0;
+  openFiles = malloc (number_of_slots * sizeof (struct MatrixFile));
+  slotInUse = calloc (number_of_slots, sizeof (bool));
+  heldSlot = calloc (number_of_workers, sizeof (int));
+  heldCount = calloc (number_of_workers, sizeof (int));
+}
+
+/**
+ *  \brief Put a file mapped in memory in the window of open files (batch mode).
+ *
+ *  Operation carried out by the reader, when the window has a free slot (it holds less than files_open_at_once files).
+ *
+ *  \param readerId reader identification
+ *  \param file information of the file
+ */
+void putFile (unsigned int readerId, const struct MatrixFile * file)
+{
+  if ((statusWorkers[readerId] = pthread_mutex_lock (&accessCR)) != 0)                                   /* enter monitor */
+     { errno = statusWorkers[readerId];                                                            /* save error in errno */
        perror ("error on entering monitor(CF)");
-       statusProd = EXIT_FAILURE;
-       pthread_exit (&statusProd);
+       statusWorkers[readerId] = EXIT_FAILURE;
+       pthread_exit (&statusWorkers[readerId]);
      }
 
-  while (full)                                                           /* wait if the data transfer region is full */
-  { if ((statusProd = pthread_cond_wait (&fifoFull, &accessCR)) != 0)
-       { errno = statusProd;                                                          /* save error in errno */
-         perror ("error on waiting in fifoFull");
-         statusProd = EXIT_FAILURE;
-         pthread_exit (&statusProd);
-       }
-  }
+  int slot = 0;
+  while (slotInUse[slot])                                                                      /* find a free slot */
+    slot += 1;
+  openFiles[slot] = *file;
+  openFiles[slot].handed_out = openFiles[slot].done = 0;
+  slotInUse[slot] = true;
+  files_put += 1;
+
+  if ((statusWorkers[readerId] = pthread_cond_broadcast (&fileReady)) != 0)   /* let the workers know there is a file */
+     { errno = statusWorkers[readerId];                                                             /* save error in errno */
+       perror ("error on broadcasting in fileReady");
+       statusWorkers[readerId] = EXIT_FAILURE;
+       pthread_exit (&statusWorkers[readerId]);
+     }
+
+  if ((statusWorkers[readerId] = pthread_mutex_unlock (&accessCR)) != 0)                                   /* exit monitor */
+     { errno = statusWorkers[readerId];                                                             /* save error in errno */
+       perror ("error on exiting monitor(CF)");
+       statusWorkers[readerId] = EXIT_FAILURE;
+       pthread_exit (&statusWorkers[readerId]);
+     }
+}
 
-  mem[ii].matrix_id = -1;                                                                   /* store values in the FIFO */
-  mem[ii].order_of_matrix = -1;
-  mem[ii].matrix_pointer =  NULL;
-  ii = (ii + 1) % K;
-  full = (ii == ri);
+/**
+ *  \brief Take a file whose matrices are all done out of the window of open files (batch mode).
+ *
+ *  Operation carried out by the reader, which waits until a file of the window is done.
+ *
+ *  \param readerId reader identification
+ *
+ *  \return information of the file, to unmap it
+ */
+struct MatrixFile retireFile (unsigned int readerId)
+{
+  struct MatrixFile file;                                                                             /* retrieved value */
+  int slot;
 
-  if ((statusProd = pthread_cond_signal (&fifoEmpty)) != 0)       /* let a worker know that a value has been stored */
-     { errno = statusProd;                                                             /* save error in errno */
-       perror ("error on signaling in fifoEmpty");
-       statusProd = EXIT_FAILURE;
-       pthread_exit (&statusProd);
+  if ((statusWorkers[readerId] = pthread_mutex_lock (&accessCR)) != 0)                                   /* enter monitor */
+     { errno = statusWorkers[readerId];                                                            /* save error in errno */
+       perror ("error on entering monitor(CF)");
+       statusWorkers[readerId] = EXIT_FAILURE;
+       pthread_exit (&statusWorkers[readerId]);
      }
 
-  if ((statusProd = pthread_mutex_unlock (&accessCR)) != 0)                                  /* exit monitor */
-     { errno = statusProd;                                                            /* save error in errno */
+  while (true)
+  { for (slot = 0; slot < number_of_slots; slot++)                                           /* find a file done */
+      if (slotInUse[slot] && (openFiles[slot].done == openFiles[slot].number_of_matrices))
+         break;
+    if (slot < number_of_slots)
+       break;
+    if ((statusWorkers[readerId] = pthread_cond_wait (&fileDone, &accessCR)) != 0)         /* wait for a file done */
+       { errno = statusWorkers[readerId];                                                          /* save error in errno */
+         perror ("error on waiting in fileDone");
+         statusWorkers[readerId] = EXIT_FAILURE;
+         pthread_exit (&statusWorkers[readerId]);
+       }
+  }
+
+  file = openFiles[slot];
+  slotInUse[slot] = false;
+
+  if ((statusWorkers[readerId] = pthread_mutex_unlock (&accessCR)) != 0)                                   /* exit monitor */
+     { errno = statusWorkers[readerId];                                                             /* save error in errno */
        perror ("error on exiting monitor(CF)");
-       statusProd = EXIT_FAILURE;
-       pthread_exit (&statusProd);
+       statusWorkers[readerId] = EXIT_FAILURE;
+       pthread_exit (&statusWorkers[readerId]);
      }
-}
 
+  return file;
+}
 
 /**
- *  \brief Store a matrix in the data transfer region.
+ *  \brief Get the next matrix (or batch of matrices).
  *
- *  Operation carried out by the main thread.
+ *  Operation carried out by the workers.
  *
- *  \param matrix_pointer pointer to the start of the matrix
- *  \param order_of_matrix number of bytes of the chunk
- *  \param matrix_id file identifier
+ *  \param workerId consumer identification
+ *
+ *  \return value (matrix_id is -1 if there are no more matrices to process)
  */
-void putMatrix (double * matrix_pointer, int order_of_matrix, int matrix_id)
+struct MatrixInfo getMatrix (unsigned int workerId)
 {
-  if ((statusProd = pthread_mutex_lock (&accessCR)) != 0)                                   /* enter monitor */
-     { errno = statusProd;                                                            /* save error in errno */
+  struct MatrixInfo matrixinfo;                                                                       /* retrieved value */
+
+  if (openFiles != NULL)                                                                                /* batch mode */
+     return getFileMatrix (workerId);
+
+  if ((statusWorkers[workerId] = pthread_mutex_lock (&accessCR)) != 0)                                   /* enter monitor */
+     { errno = statusWorkers[workerId];                                                            /* save error in errno */
        perror ("error on entering monitor(CF)");
-       statusProd = EXIT_FAILURE;
-       pthread_exit (&statusProd);
+       statusWorkers[workerId] = EXIT_FAILURE;
+       pthread_exit (&statusWorkers[workerId]);
      }
-  pthread_once (&init, initialization);                                              /* internal data initialization */
 
-  while (full)                                                           /* wait if the data transfer region is full */
-  { if ((statusProd = pthread_cond_wait (&fifoFull, &accessCR)) != 0)
-       { errno = statusProd;                                                          /* save error in errno */
-         perror ("error on waiting in fifoFull");
-         statusProd = EXIT_FAILURE;
-         pthread_exit (&statusProd);
+  int count = (number_of_matrix - next_matrix < batch_size) ? number_of_matrix - next_matrix : batch_size;
+  size_t size = (size_t) order_of_matrix * order_of_matrix;
+
+  while ((input != NULL) && (count > 0) && (next_matrix + count - next_to_write > STREAM_WINDOW))
+  { if ((statusWorkers[workerId] = pthread_cond_wait (&windowFull, &accessCR)) != 0)   /* wait for room in the window */
+       { errno = statusWorkers[workerId];                                                          /* save error in errno */
+         perror ("error on waiting in windowFull");
+         statusWorkers[workerId] = EXIT_FAILURE;
+         pthread_exit (&statusWorkers[workerId]);
        }
+    count = (number_of_matrix - next_matrix < batch_size) ? number_of_matrix - next_matrix : batch_size;
   }
 
-  mem[ii].matrix_id = matrix_id;                                                              /* store values in the FIFO */
-  mem[ii].order_of_matrix = order_of_matrix;
-  mem[ii].matrix_pointer =  matrix_pointer;
-  ii = (ii + 1) % K;
-  full = (ii == ri);
+  if ((input != NULL) && (count > 0))                                          /* read the next matrices (streaming) */
+     { if (streamBuffers[workerId] == NULL)
+          streamBuffers[workerId] = malloc (batch_size * size * sizeof (double));
+       if (fread (streamBuffers[workerId], count * size * sizeof (double), 1, input) != 1)
+          { fprintf (stderr, "error on reading matrix %d: the input ended\n", next_matrix + 1);
+            number_of_matrix = next_matrix;                                      /* no more matrices to hand out */
+            count = 0;
+          }
+     }
 
-  if ((statusProd = pthread_cond_signal (&fifoEmpty)) != 0)       /* let a worker know that a value has been stored */
-     { errno = statusProd;                                                             /* save error in errno */
-       perror ("error on signaling in fifoEmpty");
-       statusProd = EXIT_FAILURE;
-       pthread_exit (&statusProd);
+  if ((workList != NULL) && (count > 0))                             /* hand out the next matrices of the work list */
+     { matrixinfo = workList[next_matrix];
+       matrixinfo.list = &workList[next_matrix];
+       count = 1;
+       while ((matrixinfo.order_of_matrix <= BATCH_MAX_ORDER) && (count < batch_size) && (next_matrix + count < number_of_matrix) &&
+              (workList[next_matrix + count].order_of_matrix == matrixinfo.order_of_matrix))
+         count += 1;
+       matrixinfo.number_of_matrices = count;
+       next_matrix += count;
+     }
+  else if (count > 0)                                                                  /* hand out the next matrices */
+     { matrixinfo.matrix_id = next_matrix + 1;
+       matrixinfo.order_of_matrix = order_of_matrix;
+       matrixinfo.matrix_pointer = (input != NULL) ? streamBuffers[workerId] : matrices + next_matrix * size;
+       matrixinfo.number_of_matrices = count;
+       matrixinfo.row_length = order_of_matrix;
+       matrixinfo.list = NULL;
+       next_matrix += count;
+     }
+  else                                                                                /* there are no more matrices */
+     { matrixinfo.matrix_id = -1;
+       matrixinfo.order_of_matrix = -1;
+       matrixinfo.matrix_pointer = NULL;
+       matrixinfo.number_of_matrices = 0;
+       matrixinfo.row_length = 0;
+       matrixinfo.list = NULL;
      }
 
-  if ((statusProd = pthread_mutex_unlock (&accessCR)) != 0)                                  /* exit monitor */
-     { errno = statusProd;                                                            /* save error in errno */
+  if ((statusWorkers[workerId] = pthread_mutex_unlock (&accessCR)) != 0)                                   /* exit monitor */
+     { errno = statusWorkers[workerId];                                                             /* save error in errno */
        perror ("error on exiting monitor(CF)");
-       statusProd = EXIT_FAILURE;
-       pthread_exit (&statusProd);
+       statusWorkers[workerId] = EXIT_FAILURE;
+       pthread_exit (&statusWorkers[workerId]);
      }
+
+  return matrixinfo;
 }
 
 /**
- *  \brief Get a matrix from the data transfer region.
+ *  \brief Get the next matrix (or batch of matrices) from the window of open files (batch mode).
+ *
+ *  The matrices handed out to the worker before are done. The next ones are taken from the first file of the window
+ *  with matrices left, as in the other modes: batches of small matrices, runs of matrices_per_get larger matrices of a
+ *  legacy file, and single matrices of a work list.
  *
  *  Operation carried out by the workers.
  *
  *  \param workerId consumer identification
  *
- *  \return value
+ *  \return value (matrix_id is -1 if there are no more matrices to process)
  */
-struct MatrixInfo getMatrix (unsigned int workerId)
+static struct MatrixInfo getFileMatrix (unsigned int workerId)
 {
   struct MatrixInfo matrixinfo;                                                                       /* retrieved value */
+  int slot;
 
   if ((statusWorkers[workerId] = pthread_mutex_lock (&accessCR)) != 0)                                   /* enter monitor */
      { errno = statusWorkers[workerId];                                                            /* save error in errno */
@@ -195,25 +453,123 @@ struct MatrixInfo getMatrix (unsigned int workerId)
        statusWorkers[workerId] = EXIT_FAILURE;
        pthread_exit (&statusWorkers[workerId]);
      }
-  pthread_once (&init, initialization);                                                /* internal data initialization */
 
-  while ((ii == ri) && !full)                                             /* wait if the data transfer region is empty */
-  { if ((statusWorkers[workerId] = pthread_cond_wait (&fifoEmpty, &accessCR)) != 0)
+  if (heldCount[workerId] > 0)                                          /* the matrices handed out before are done */
+     { struct MatrixFile * file = &openFiles[heldSlot[workerId]];
+       file->done += heldCount[workerId];
+       heldCount[workerId] = 0;
+       if ((file->done == file->number_of_matrices) &&
+           ((statusWorkers[workerId] = pthread_cond_signal (&fileDone)) != 0))    /* let the reader know it is done */
+          { errno = statusWorkers[workerId];                                                        /* save error in errno */
+            perror ("error on signaling in fileDone");
+            statusWorkers[workerId] = EXIT_FAILURE;
+            pthread_exit (&statusWorkers[workerId]);
+          }
+     }
+
+  while (true)
+  { int first = -1;                                              /* first file of the window with matrices left */
+    for (slot = 0; slot < number_of_slots; slot++)
+      if (slotInUse[slot] && (openFiles[slot].handed_out < openFiles[slot].number_of_matrices) &&
+          ((first < 0) || (openFiles[slot].first_id < openFiles[first].first_id)))
+         first = slot;
+    slot = first;
+    if ((slot >= 0) || (files_put == number_of_files))
+       break;
+    if ((statusWorkers[workerId] = pthread_cond_wait (&fileReady, &accessCR)) != 0)      /* wait for the next file */
        { errno = statusWorkers[workerId];                                                          /* save error in errno */
-         perror ("error on waiting in fifoEmpty");
+         perror ("error on waiting in fileReady");
          statusWorkers[workerId] = EXIT_FAILURE;
          pthread_exit (&statusWorkers[workerId]);
        }
   }
 
-  matrixinfo = mem[ri];                                                              /* retrieve a  value from the FIFO */
-  ri = (ri + 1) % K;
-  full = false;
+  if (slot >= 0)                                                                       /* hand out the next matrices */
+     { struct MatrixFile * file = &openFiles[slot];
+       int left = file->number_of_matrices - file->handed_out, count = 1;
+
+       if (file->list != NULL)
+          { matrixinfo = file->list[file->handed_out];
+            matrixinfo.list = &file->list[file->handed_out];
+            while ((matrixinfo.order_of_matrix <= BATCH_MAX_ORDER) && (count < MATRICES_PER_BATCH) && (count < left) &&
+                   (file->list[file->handed_out + count].order_of_matrix == matrixinfo.order_of_matrix))
+              count += 1;
+          }
+       else
+          { int per_get = (file->order_of_matrix <= BATCH_MAX_ORDER) ? MATRICES_PER_BATCH : batch_size;
+            count = (left < per_get) ? left : per_get;
+            matrixinfo.matrix_id = file->first_id + file->handed_out;
+            matrixinfo.order_of_matrix = file->order_of_matrix;
+            matrixinfo.matrix_pointer = file->matrices + (size_t) file->handed_out * file->order_of_matrix * file->order_of_matrix;
+            matrixinfo.row_length = file->order_of_matrix;
+            matrixinfo.list = NULL;
+          }
+       matrixinfo.number_of_matrices = count;
+       file->handed_out += count;
+       heldSlot[workerId] = slot;
+       heldCount[workerId] = count;
+     }
+  else                                                                                /* there are no more matrices */
+     { matrixinfo.matrix_id = -1;
+       matrixinfo.order_of_matrix = -1;
+       matrixinfo.matrix_pointer = NULL;
+       matrixinfo.number_of_matrices = 0;
+       matrixinfo.row_length = 0;
+       matrixinfo.list = NULL;
+     }
+
+  if ((statusWorkers[workerId] = pthread_mutex_unlock (&accessCR)) != 0)                                   /* exit monitor */
+     { errno = statusWorkers[workerId];                                                             /* save error in errno */
+       perror ("error on exiting monitor(CF)");
+       statusWorkers[workerId] = EXIT_FAILURE;
+       pthread_exit (&statusWorkers[workerId]);
+     }
+
+  return matrixinfo;
+}
+
+/**
+ *  \brief Save the determinants of matrices handed out by getMatrix (streaming mode).
+ *
+ *  The determinants are written to the output as soon as the determinants of all the matrices before them are written.
+ *
+ *  Operation carried out by the workers.
+ *
+ *  \param workerId consumer identification
+ *  \param matrix_id identifier of the first matrix
+ *  \param number_of_matrices number of matrices
+ *  \param determinants determinants of the matrices (mantissas, if the exponents are given)
+ *  \param exponents binary exponents of the determinants (NULL if they are 0)
+ */
+void putDeterminants (unsigned int workerId, int matrix_id, int number_of_matrices, double * determinants, int * exponents)
+{
+  if ((statusWorkers[workerId] = pthread_mutex_lock (&accessCR)) != 0)                                   /* enter monitor */
+     { errno = statusWorkers[workerId];                                                            /* save error in errno */
+       perror ("error on entering monitor(CF)");
+       statusWorkers[workerId] = EXIT_FAILURE;
+       pthread_exit (&statusWorkers[workerId]);
+     }
+
+  for (int m = 0; m < number_of_matrices; m++)                                   /* store the determinants in the window */
+  { window[(matrix_id - 1 + m) % STREAM_WINDOW] = determinants[m];
+    windowExponents[(matrix_id - 1 + m) % STREAM_WINDOW] = (exponents != NULL) ? exponents[m] : 0;
+    windowDone[(matrix_id - 1 + m) % STREAM_WINDOW] = true;
+  }
+
+  while ((next_to_write < next_matrix) && windowDone[next_to_write % STREAM_WINDOW])        /* write the ones in order */
+  { double mantissa = window[next_to_write % STREAM_WINDOW];
+    int exponent = windowExponents[next_to_write % STREAM_WINDOW];
+    if (logMode)
+       fprintf (output, "%d %d %.17e\n", next_to_write + 1, (mantissa > 0) - (mantissa < 0),
+                log10 (fabs (mantissa)) + exponent * log10 (2.0));
+    else fprintf (output, "%d %.17e\n", next_to_write + 1, ldexp (mantissa, exponent));
+    windowDone[next_to_write % STREAM_WINDOW] = false;
+    next_to_write += 1;
+  }
 
-  if ((statusWorkers[workerId] = pthread_cond_signal (&fifoFull)) != 0)       /* let a producer know that a value has been
-                                                                                                            retrieved */
+  if ((statusWorkers[workerId] = pthread_cond_broadcast (&windowFull)) != 0)    /* let the workers know there is room */
      { errno = statusWorkers[workerId];                                                             /* save error in errno */
-       perror ("error on signaling in fifoFull");
+       perror ("error on broadcasting in windowFull");
        statusWorkers[workerId] = EXIT_FAILURE;
        pthread_exit (&statusWorkers[workerId]);
      }
@@ -224,6 +580,49 @@ struct MatrixInfo getMatrix (unsigned int workerId)
        statusWorkers[workerId] = EXIT_FAILURE;
        pthread_exit (&statusWorkers[workerId]);
      }
+}
 
-  return matrixinfo;
+/**
+ *  \brief Get the next task of the exact mode.
+ *
+ *  Operation carried out by the workers.
+ *
+ *  \param workerId consumer identification
+ *
+ *  \return value (matrix is -1 if there are no more tasks)
+ */
+struct ResidueTask getResidueTask (unsigned int workerId)
+{
+  struct ResidueTask task;                                                                            /* retrieved value */
+
+  if ((statusWorkers[workerId] = pthread_mutex_lock (&accessCR)) != 0)                                   /* enter monitor */
+     { errno = statusWorkers[workerId];                                                            /* save error in errno */
+       perror ("error on entering monitor(CF)");
+       statusWorkers[workerId] = EXIT_FAILURE;
+       pthread_exit (&statusWorkers[workerId]);
+     }
+
+  while ((next_matrix < number_of_matrix) && (next_prime >= primesPerMatrix[next_matrix]))   /* go to the next matrix */
+  { next_matrix += 1;
+    next_prime = 0;
+  }
+
+  if (next_matrix < number_of_matrix)                                                          /* hand out the next task */
+     { task.matrix = next_matrix;
+       task.prime = next_prime;
+       next_prime += 1;
+     }
+  else                                                                                  /* there are no more tasks */
+     { task.matrix = -1;
+       task.prime = -1;
+     }
+
+  if ((statusWorkers[workerId] = pthread_mutex_unlock (&accessCR)) != 0)                                   /* exit monitor */
+     { errno = statusWorkers[workerId];                                                             /* save error in errno */
+       perror ("error on exiting monitor(CF)");
+       statusWorkers[workerId] = EXIT_FAILURE;
+       pthread_exit (&statusWorkers[workerId]);
+     }
+
+  return task;
 }
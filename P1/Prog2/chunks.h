@@ -3,18 +3,34 @@
  *
  *  \brief Problem name: Compute Matrix Determinant.
  *
- *  In this file the functions to save/get the information of each matrix are implemented.
+ *  In this file the functions to get the information of each matrix are implemented.
  *  Synchronization based on monitors.
  *  Both threads and the monitor are implemented using the pthread library which enables the creation of a
  *  monitor of the Lampson / Redell type.
  *
- *  Data transfer region implemented as a monitor.
+ *  The matrices are read in place, from the file mapped in memory: the monitor only hands out the next matrix
+ *  (or batch of small matrices) to the worker that asks for it.
+ *  The matrices of a container file are handed out from a work list.
+ *  In the streaming mode, the matrices are read from a file, pipe or stdin, and the determinants are written to
+ *  an output file in the order of the matrices, through a window of STREAM_WINDOW matrices.
+ *
+ *  In the exact mode, the monitor hands out the determinant of a matrix modulo one of its primes at a time.
+ *  In the batch mode, the matrices of many files are handed out from a window of the files mapped in memory by a
+ *  reader thread, which gets back the files whose matrices are all done, to unmap them and map the next ones.
  *
  *  Definition of the operations carried out by the main thread:
- *     \li putMatrix
- *     \li endMatrix.
+ *     \li initMatrices
+ *     \li initMatrixList
+ *     \li initStream
+ *     \li initResidueTasks
+ *     \li initFiles.
+ *  Definition of the operations carried out by the reader thread (batch mode):
+ *     \li putFile
+ *     \li retireFile.
  *  Definition of the operations carried out by the worker threads:
  *     \li getMatrix
+ *     \li putDeterminants
+ *     \li getResidueTask.
  *
  *  \author Diogo Filipe Amaral Carvalho - 92969 - April 2022
  *  \author Rafael Ferreira Baptista - 93367 - April 2022
@@ -23,43 +39,165 @@
 #ifndef CHUNKS_H
 #define CHUNKS_H
 
+#include <stdio.h>
+#include <stdbool.h>
+
+/** \brief struct to store the information of one matrix (defined below) */
+struct MatrixInfo;
+
+/** \brief struct to store one task of the exact mode (defined below) */
+struct ResidueTask;
+
+/** \brief struct to store the information of a file of the batch mode (defined below) */
+struct MatrixFile;
+
+/**
+ *  \brief Set the matrices to hand out.
+ *
+ *  Operation carried out by the main thread, before the workers are created.
+ *
+ *  \param matrix_pointer pointer to the first matrix (the matrices are stored one after the other, row by row)
+ *  \param number_of_matrices number of matrices
+ *  \param order order of the matrices
+ *  \param matrices_per_get number of matrices handed out at a time
+ */
+extern void initMatrices (double * matrix_pointer, int number_of_matrices, int order, int matrices_per_get);
+
+/**
+ *  \brief Set the work list of the matrices to hand out.
+ *
+ *  Operation carried out by the main thread, before the workers are created.
+ *  Consecutive matrices of the list with the same order, up to BATCH_MAX_ORDER, are handed out together.
+ *
+ *  \param list work list, with the information of each matrix
+ *  \param number_of_matrices number of matrices
+ *  \param matrices_per_get maximum number of matrices handed out at a time
+ */
+extern void initMatrixList (const struct MatrixInfo * list, int number_of_matrices, int matrices_per_get);
+
+/**
+ *  \brief Set the file to read the matrices from and the file to write the determinants to (streaming mode).
+ *
+ *  Operation carried out by the main thread, before the workers are created, after reading the header of the input.
+ *
+ *  \param input_file file, pipe or stdin positioned at the first matrix
+ *  \param output_file file to write the determinants to
+ *  \param number_of_matrices number of matrices
+ *  \param order order of the matrices
+ *  \param matrices_per_get number of matrices handed out at a time (at most STREAM_WINDOW)
+ *  \param number_of_workers number of workers
+ *  \param log_mode true to write the sign and log10 of the absolute value of each determinant
+ */
+extern void initStream (FILE * input_file, FILE * output_file, int number_of_matrices, int order, int matrices_per_get,
+                        int number_of_workers, bool log_mode);
+
+/**
+ *  \brief Set the tasks of the exact mode: the determinant of each matrix modulo each of its primes.
+ *
+ *  Operation carried out by the main thread, before the workers are created.
+ *
+ *  \param primes_per_matrix number of primes of each matrix
+ *  \param number_of_matrices number of matrices
+ */
+extern void initResidueTasks (const int * primes_per_matrix, int number_of_matrices);
+
 /**
- *  \brief Store a struct to inform that there are no more matrices to be processed.
+ *  \brief Set the files to hand out the matrices of (batch mode).
  *
- *  Operation carried out by the main thread.
+ *  Operation carried out by the main thread, before the workers and the reader are created.
  *
+ *  \param number_of_input_files number of files
+ *  \param files_open_at_once maximum number of files in the window
+ *  \param matrices_per_get number of matrices of order above BATCH_MAX_ORDER of a legacy file handed out at a time
+ *  \param number_of_workers number of workers
  */
-extern void endMatrix();
+extern void initFiles (int number_of_input_files, int files_open_at_once, int matrices_per_get, int number_of_workers);
 
+/**
+ *  \brief Put a file mapped in memory in the window of open files (batch mode).
+ *
+ *  Operation carried out by the reader, when the window has a free slot (it holds less than files_open_at_once files).
+ *
+ *  \param readerId reader identification
+ *  \param file information of the file
+ */
+extern void putFile (unsigned int readerId, const struct MatrixFile * file);
 
 /**
- *  \brief Store a matrix in the data transfer region.
+ *  \brief Take a file whose matrices are all done out of the window of open files (batch mode).
+ *
+ *  Operation carried out by the reader, which waits until a file of the window is done.
  *
- *  Operation carried out by the main thread.
+ *  \param readerId reader identification
  *
- *  \param buffer pointer to the start of the chunk
- *  \param order_of_matrix number of bytes of the chunk
- *  \param matrix_id file identifier
+ *  \return information of the file, to unmap it
  */
-extern void putMatrix (double * buffer, int order_of_matrix, int matrix_id);
+extern struct MatrixFile retireFile (unsigned int readerId);
 
 /**
- *  \brief Get a chunk from the data transfer region.
+ *  \brief Get the next matrix (or batch of matrices).
  *
  *  Operation carried out by the workers.
  *
  *  \param workerId consumer identification
  *
- *  \return value
+ *  \return value (matrix_id is -1 if there are no more matrices to process)
  */
 extern struct MatrixInfo getMatrix (unsigned int workerId);
 
+/**
+ *  \brief Save the determinants of matrices handed out by getMatrix (streaming mode).
+ *
+ *  The determinants are written to the output as soon as the determinants of all the matrices before them are written.
+ *
+ *  Operation carried out by the workers.
+ *
+ *  \param workerId consumer identification
+ *  \param matrix_id identifier of the first matrix
+ *  \param number_of_matrices number of matrices
+ *  \param determinants determinants of the matrices (mantissas, if the exponents are given)
+ *  \param exponents binary exponents of the determinants (NULL if they are 0)
+ */
+extern void putDeterminants (unsigned int workerId, int matrix_id, int number_of_matrices, double * determinants, int * exponents);
+
+/**
+ *  \brief Get the next task of the exact mode.
+ *
+ *  Operation carried out by the workers.
+ *
+ *  \param workerId consumer identification
+ *
+ *  \return value (matrix is -1 if there are no more tasks)
+ */
+extern struct ResidueTask getResidueTask (unsigned int workerId);
+
 /** \brief struct to store the information of one matrix */
 extern struct MatrixInfo {
    int matrix_id;        /* matrix identifier */  
    int order_of_matrix;    /* Order of the matrix */
-   double * matrix_pointer;  /* Pointer to the start of the matrix */
+   double * matrix_pointer;  /* Pointer to the start of the matrix (read only in the file mapped in memory) */
+   int number_of_matrices;   /* Number of matrices stored one after the other (a batch of small matrices) */
+   int row_length;           /* Number of coefficients of a row of the matrix, padding included */
+   const struct MatrixInfo * list;   /* Matrices of a batch taken from a work list (NULL if they are one after the other) */
 } MatrixInfo;
 
+/** \brief struct to store one task of the exact mode */
+extern struct ResidueTask {
+   int matrix;           /* index of the matrix (-1 if there are no more tasks) */
+   int prime;            /* index of the prime */
+} ResidueTask;
+
+/** \brief struct to store the information of a file of the batch mode */
+extern struct MatrixFile {
+   int file_id;                      /* index of the file */
+   int first_id;                     /* identifier of the first matrix of the file */
+   int number_of_matrices;           /* number of matrices */
+   int order_of_matrix;              /* order of the matrices (legacy file) */
+   double * matrices;                /* pointer to the first matrix (legacy file) */
+   const struct MatrixInfo * list;   /* work list of the matrices (container file, NULL for a legacy file) */
+   int handed_out;                   /* number of matrices handed out */
+   int done;                         /* number of matrices done */
+} MatrixFile;
+
 
 #endif /* CHUNKS_H */
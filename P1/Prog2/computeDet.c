@@ -15,14 +15,34 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
 #include <string.h>
 #include <stdbool.h>
 #include <time.h>
 #include <libgen.h>
 #include <unistd.h>
 #include <pthread.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdint.h>
+#include <dirent.h>
+#include <glob.h>
 
 #include "chunks.h"
+#include "det.h"
+#include "kernels.h"
+#include "tuning.h"
+#include "tasks.h"
+#include "structure.h"
+#include "incremental.h"
+#include "cache.h"
+#include "check.h"
+#include "exact.h"
+#include "outofcore.h"
+#include "container.h"
+#include "probConst.h"
 
 /** \brief function responsible to present the program usage */
 static void printUsage(char *cmdName);
@@ -30,17 +50,103 @@ static void printUsage(char *cmdName);
 /** \brief worker life cycle routine */
 static void *worker(void *par);
 
+/** \brief function to run the tasks of the decomposition of the matrices of a group of workers */
+static void runTasks(unsigned int id, unsigned int group, bool leader);
+
+/** \brief function to compute the determinants of the matrices modulo their primes, in the exact mode */
+static void runResidueTasks(unsigned int id);
+
+/** \brief function to compute the determinants of a run of consecutive matrices, in the incremental mode */
+static void runIncremental(unsigned int id, struct MatrixInfo run, double * scratch, int * pivots);
+
+/** \brief function to copy a matrix to the scratch buffer, find its structure and decompose it */
+static int decomposeMatrix(unsigned int id, unsigned int group, struct MatrixInfo matrixinfo, double * scratch, int * pivots,
+                           double * determinant, int * exponent);
+
 /** \brief worker threads return status array */
 int *statusWorkers;
 
-/** \brief main thread return status */
-int statusProd;
+/** \brief number of matrices of each structure (enum Structure) processed by each worker */
+static int (*structureCounts)[NUMBER_OF_STRUCTURES];
 
-/** \brief to store the determinant of each matrix */
+/** \brief to store the determinant of each matrix (its mantissa, with the binary exponent in matrixExponents) */
 double * matrixDeterminants;
 
-/** \brief function to compute determinant of a matrix */
-static void computeDeterminant(struct MatrixInfo * matrixinfo, double * determinant);
+/** \brief to store the binary exponent of the determinant of each matrix */
+int * matrixExponents;
+
+/** \brief log mode: the sign and log10 of the absolute value of each determinant are printed, so they do not overflow */
+static bool log_mode = false;
+
+/** \brief exact mode: the matrices are of integers and their determinants are computed exactly, by multi-modular arithmetic */
+static bool exact = false;
+
+/** \brief matrices of the exact mode, with their pointers and row lengths */
+static const struct MatrixInfo * exactList;
+
+/** \brief number of primes of each matrix, in the exact mode */
+static int * primesPerMatrix;
+
+/** \brief determinant of each matrix modulo each of its primes, in the exact mode */
+static uint64_t ** matrixResidues;
+
+/** \brief incremental mode: each matrix is updated from the last one factored when they differ in a few rows or columns */
+static bool incremental = false;
+
+/** \brief deduplication mode: the determinant of a matrix seen before is taken from the cache instead of computed again */
+static bool dedup = false;
+
+/** \brief streaming mode: the determinants are written to a file as they are computed, instead of stored */
+static bool streaming = false;
+
+/** \brief struct to store the information of an input file of the batch mode */
+struct InputFile {
+    char * name;                        // name of the file
+    bool container;                     // container file (otherwise a legacy file)
+    int number_of_matrices;             // number of matrices
+    int order_of_matrix;                // order of the matrices of a legacy file
+    int first_id;                       // identifier of its first matrix (the matrices of all the files are numbered together)
+    off_t size;                         // size of the file
+    char * mapping;                     // file mapped in memory by the reader (NULL if it is not open)
+    struct MatrixInfo * work_list;      // work list of a container file, while it is open
+    bool skipped;                       // skipped by the reader (the file can not be mapped, or its index is invalid)
+};
+
+/** \brief input files of the batch mode */
+static struct InputFile * inputFiles;
+
+/** \brief number of input files of the batch mode */
+static int number_of_inputs = 0;
+
+/** \brief number of files mapped in memory at once in the batch mode */
+static int files_open_at_once = BATCH_OPEN_FILES;
+
+/** \brief number of worker threads */
+int num_of_threads = 1;
+
+/** \brief number of groups of workers, each one decomposes a matrix at a time */
+int number_of_groups = 1;
+
+/** \brief function to validate a container file and build its work list */
+static struct MatrixInfo * loadContainer(char * mapping, off_t size, char * fName, int * number_of_matrices);
+
+/** \brief function to expand the directories and patterns given into the input files of the batch mode */
+static int expandInputs(char ** names, int number_of_names, char *** files, bool * expanded);
+
+/** \brief function to read the headers of the input files of the batch mode, and number their matrices */
+static int scanInputs(char ** files, int number_of_files, int * largest_order, int * smallest_order, double * flops);
+
+/** \brief function of the reader thread of the batch mode: it maps the input files a few at a time */
+static void *reader(void *par);
+
+/** \brief function to sort the work list of a container file, the largest matrices first */
+static int compareCost(const void * a, const void * b);
+
+/** \brief function to decompose a panel of a matrix (task of a group of workers) */
+static int factorPanel(struct Task * task);
+
+/** \brief function to update a block of columns of a matrix with a panel (task of a group of workers) */
+static void updateBlock(struct Task * task);
 
 int main(int argc, char *argv[])
 {   
@@ -48,21 +154,37 @@ int main(int argc, char *argv[])
 
     int opt;            /* selected option */
     char *fName = "";   /* file name (initialized to "no name" by default) */
-    int num_of_threads = 1; /* number of threads that will be used */
+    char *oName = NULL; /* output file name of the streaming mode (NULL if the determinants are printed) */
+    char *aName = NULL; /* file with the known determinants (NULL if they are not checked) */
+    int stack_size = 0;     /* stack size of each thread, in KiB (0 means the default of the system) */
+    size_t memory_budget = 0;   /* memory budget of the copy of a matrix, in bytes (0 means no budget) */
+    char *pName = NULL;     /* tuning profile name (NULL for the default one, which may not exist) */
+    char *kName = NULL;     /* persistent cache file name (NULL if the cache is not kept across runs) */
+    char **fNames = malloc(argc * sizeof(char *));  /* file names, directories and patterns given (batch mode if more than one) */
+    int number_of_names = 0;
 
     opterr = 0;
     do
     {
-        switch ((opt = getopt(argc, argv, "t:f:h")))
+        switch ((opt = getopt(argc, argv, "t:f:o:s:c:m:p:k:b:liueh")))
         {
-        case 'f': /* file name */
-            if (optarg[0] == '-')
+        case 'f': /* file name ("-" is stdin) */
+            if (optarg[0] == '-' && optarg[1] != '\0')
             {
                 fprintf(stderr, "%s: file name is missing\n", basename(argv[0]));
                 printUsage(basename(argv[0]));
                 return EXIT_FAILURE;
             }
-            fName = optarg;
+            fName = fNames[number_of_names++] = optarg;
+            break;
+        case 'b': /* files open at once (batch mode) */
+            if (atoi(optarg) <= 0)
+            {
+                fprintf(stderr, "%s: number of files open at once must be positive\n", basename(argv[0]));
+                printUsage(basename(argv[0]));
+                return EXIT_FAILURE;
+            }
+            files_open_at_once = atoi(optarg);
             break;
         case 't': /* file name */
             if (optarg[0] == '-')
@@ -73,6 +195,73 @@ int main(int argc, char *argv[])
             }
             num_of_threads = atoi(optarg);
             break;
+        case 'o': /* output file name (streaming mode) */
+            if (optarg[0] == '-')
+            {
+                fprintf(stderr, "%s: output file name is missing\n", basename(argv[0]));
+                printUsage(basename(argv[0]));
+                return EXIT_FAILURE;
+            }
+            oName = optarg;
+            break;
+        case 'c': /* file with the known determinants */
+            if (optarg[0] == '-')
+            {
+                fprintf(stderr, "%s: answers file name is missing\n", basename(argv[0]));
+                printUsage(basename(argv[0]));
+                return EXIT_FAILURE;
+            }
+            aName = optarg;
+            break;
+        case 's': /* stack size of each thread */
+            if (atoi(optarg) <= 0)
+            {
+                fprintf(stderr, "%s: stack size must be positive\n", basename(argv[0]));
+                printUsage(basename(argv[0]));
+                return EXIT_FAILURE;
+            }
+            stack_size = atoi(optarg);
+            break;
+        case 'm': /* memory budget */
+            if (atoi(optarg) <= 0)
+            {
+                fprintf(stderr, "%s: memory budget must be positive\n", basename(argv[0]));
+                printUsage(basename(argv[0]));
+                return EXIT_FAILURE;
+            }
+            memory_budget = (size_t) atoi(optarg) << 20;
+            break;
+        case 'p': /* tuning profile */
+            if (optarg[0] == '-')
+            {
+                fprintf(stderr, "%s: tuning profile name is missing\n", basename(argv[0]));
+                printUsage(basename(argv[0]));
+                return EXIT_FAILURE;
+            }
+            pName = optarg;
+            break;
+        case 'k': /* persistent cache file */
+            if (optarg[0] == '-')
+            {
+                fprintf(stderr, "%s: cache file name is missing\n", basename(argv[0]));
+                printUsage(basename(argv[0]));
+                return EXIT_FAILURE;
+            }
+            kName = optarg;
+            dedup = true;
+            break;
+        case 'u': /* deduplication mode */
+            dedup = true;
+            break;
+        case 'l': /* log mode */
+            log_mode = true;
+            break;
+        case 'i': /* incremental mode */
+            incremental = true;
+            break;
+        case 'e': /* exact mode */
+            exact = true;
+            break;
         case 'h': /* help mode */
             printUsage(basename(argv[0]));
             return EXIT_SUCCESS;
@@ -91,16 +280,83 @@ int main(int argc, char *argv[])
         return EXIT_FAILURE;
     }
 
+    /* batch mode: several files, a directory or a pattern, whose matrices go through the same workers */
+
+    for (int i = optind; i < argc; i++)
+        fNames[number_of_names++] = argv[i];
+    if (number_of_names > 0)
+        fName = fNames[0];
+
+    char ** batchFiles = NULL;
+    bool expanded;
+    int number_of_files = expandInputs(fNames, number_of_names, &batchFiles, &expanded);
+    bool batch = (number_of_names > 1) || expanded;
+    free(fNames);
+
+    if (batch && (oName != NULL || exact || memory_budget > 0 || aName != NULL)) {
+        fprintf(stderr, "%s: the batch mode (several files) can not be combined with -o, -e, -m or -c\n", basename(argv[0]));
+        printUsage(basename(argv[0]));
+        return EXIT_FAILURE;
+    }
+
     int *status_p;
 
-    /* open the text file */
+    /* open the input: the file is mapped in memory, or read as it comes in the streaming mode */
 
-    FILE * fpointer;
-    fpointer = fopen(fName, "rb");
+    streaming = (oName != NULL);
+    if (!streaming && strcmp(fName, "-") == 0) {
+        fprintf(stderr, "%s: stdin can only be read in the streaming mode (-o)\n", basename(argv[0]));
+        printUsage(basename(argv[0]));
+        return EXIT_FAILURE;
+    }
+    if (streaming && aName != NULL) {
+        fprintf(stderr, "%s: the determinants can not be checked in the streaming mode (-o)\n", basename(argv[0]));
+        printUsage(basename(argv[0]));
+        return EXIT_FAILURE;
+    }
 
-    if (fpointer == NULL) {
-        fprintf(stderr, "It occoured an error while openning file. \n"); 
-        exit(EXIT_FAILURE);
+    if (exact && (streaming || log_mode || aName != NULL)) {
+        fprintf(stderr, "%s: the exact mode (-e) can not be combined with -o, -l or -c\n", basename(argv[0]));
+        printUsage(basename(argv[0]));
+        return EXIT_FAILURE;
+    }
+
+    if (incremental && (exact || memory_budget > 0)) {
+        fprintf(stderr, "%s: the incremental mode (-i) can not be combined with -e or -m\n", basename(argv[0]));
+        printUsage(basename(argv[0]));
+        return EXIT_FAILURE;
+    }
+
+    // The cache keeps pointers to the matrices, which the streaming mode reuses for the next ones
+    if (dedup && (streaming || exact)) {
+        fprintf(stderr, "%s: the deduplication mode (-u, -k) can not be combined with -o or -e\n", basename(argv[0]));
+        printUsage(basename(argv[0]));
+        return EXIT_FAILURE;
+    }
+
+    if (memory_budget > 0 && (streaming || exact)) {
+        fprintf(stderr, "%s: the memory budget (-m) can not be combined with -o or -e\n", basename(argv[0]));
+        printUsage(basename(argv[0]));
+        return EXIT_FAILURE;
+    }
+
+    FILE * input = NULL, * output = NULL;
+    int fd = -1;
+    struct stat file_status;
+
+    if (streaming) {
+        input = (strcmp(fName, "-") == 0) ? stdin : fopen(fName, "rb");
+        output = fopen(oName, "w");
+        if (input == NULL || output == NULL) {
+            fprintf(stderr, "It occoured an error while openning file. \n"); 
+            exit(EXIT_FAILURE);
+        }
+    } else if (!batch) {
+        fd = open(fName, O_RDONLY);
+        if (fd == -1 || fstat(fd, &file_status) == -1) {
+            fprintf(stderr, "It occoured an error while openning file. \n"); 
+            exit(EXIT_FAILURE);
+        }
     }
 
     /* measure time */
@@ -109,59 +365,240 @@ int main(int argc, char *argv[])
     double elapsed;
     clock_gettime(CLOCK_MONOTONIC_RAW, &start);
 
-    /* generate worker threads */
+    /* load the kernels and tile widths chosen by autotune for each order, or fall back to the built-in heuristics */
 
-    statusWorkers = malloc(num_of_threads * sizeof(int));   // Allocate memory to save the status of each worker
-    pthread_t tIdWorkers[num_of_threads];
-    unsigned int workers[num_of_threads];
-    for (int i = 0; i < num_of_threads; i++)
-        workers[i] = i;
+    int profile_size = det_init(pName);
+    if (profile_size > 0)
+        printf("Tuning = profile %s, %d orders \n", (pName != NULL) ? pName : DEFAULT_PROFILE, profile_size);
+    else if (pName != NULL) {
+        fprintf(stderr, "%s: the tuning profile does not exist\n", pName);
+        exit(EXIT_FAILURE);
+    } else
+        printf("Tuning = built-in heuristics, %s kernels, tiles of %d columns \n", kernelNames[fastestKernel()], LU_TILE);
 
-    for (int i = 0; i < num_of_threads; i++)
-    if (pthread_create (&tIdWorkers[i], NULL, worker, &workers[i]) != 0)                              /* thread worker */
-    { perror ("error on creating thread worker");
-        exit (EXIT_FAILURE);
+    /* create the deduplication cache, with the determinants of the previous runs */
+
+    if (dedup) {
+        int cache_size = initCache(kName);
+        if (kName != NULL)
+            printf("Deduplication cache = %s, %d determinants loaded \n", kName, cache_size);
+        else
+            printf("Deduplication cache = empty \n");
     }
 
-    /* read file content */
+    /* read file header */
 
-    int number_of_matrix;
-    int order_of_matrix;
-    
-    // Read Number of Matrix from File
-    if(fread(&number_of_matrix, sizeof(int), 1, fpointer) != 1)
-        strerror(1);
-    printf("Number of matrices to be read = %i \n", number_of_matrix);
+    char * mapping = NULL;
+    struct MatrixInfo * work_list = NULL;      // work list of a container file (NULL for the legacy files)
+    int number_of_matrix, order_of_matrix, smallest_order;
+    double flops = 0;                          // floating point operations of the decompositions (2n^3/3 for each matrix)
+    int header[2] = {0, 0};                    // number and order of the matrices of a legacy file
+
+    if (!streaming && !batch) {
+        if (file_status.st_size < (off_t) sizeof(header)) {
+            fprintf(stderr, "%s: the file has no header\n", fName);
+            exit(EXIT_FAILURE);
+        }
+
+        // The workers read the matrices in place
+        mapping = mmap(NULL, file_status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            perror("error on mapping the file in memory");
+            exit(EXIT_FAILURE);
+        }
+        close(fd);
+    }
+
+    if (batch) {
+
+        // Batch mode: the headers are read first, and the reader maps the files a few at a time as the workers go
+        number_of_matrix = scanInputs(batchFiles, number_of_files, &order_of_matrix, &smallest_order, &flops);
+        printf("Batch mode = %d files (%d skipped), %d mapped in memory at once \n", number_of_inputs,
+               number_of_files - number_of_inputs, files_open_at_once);
+        printf("Number of matrices to be read = %i \n", number_of_matrix);
+        printf("Matrices order = %i to %i \n", smallest_order, order_of_matrix);
+    } else if (!streaming && file_status.st_size >= (off_t) sizeof(struct ContainerHeader) &&
+        memcmp(mapping, CONTAINER_MAGIC, sizeof(CONTAINER_MAGIC) - 1) == 0) {
+
+        // Container file: the matrices are handed out from the largest to the smallest
+        if (incremental) {
+            fprintf(stderr, "%s: the incremental mode (-i) needs the matrices in the order of the file, in a legacy file\n", fName);
+            exit(EXIT_FAILURE);
+        }
+        work_list = loadContainer(mapping, file_status.st_size, fName, &number_of_matrix);
+        if (work_list == NULL)
+            exit(EXIT_FAILURE);
+        order_of_matrix = (number_of_matrix > 0) ? work_list[0].order_of_matrix : 1;
+        smallest_order = (number_of_matrix > 0) ? work_list[number_of_matrix - 1].order_of_matrix : 1;
+        printf("Number of matrices to be read = %i \n", number_of_matrix);
+        printf("Matrices order = %i to %i \n", smallest_order, order_of_matrix);
+        for (int m = 0; m < number_of_matrix; m++)
+            flops += 2.0 / 3.0 * pow(work_list[m].order_of_matrix, 3);
+    } else {
+        if (!streaming)
+            memcpy(header, mapping, sizeof(header));
+        else if (fread(header, sizeof(header), 1, input) != 1) {
+            fprintf(stderr, "%s: the file has no header\n", fName);
+            exit(EXIT_FAILURE);
+        }
+
+        number_of_matrix = header[0];
+        order_of_matrix = smallest_order = header[1];
+        printf("Number of matrices to be read = %i \n", number_of_matrix);
+        printf("Matrices order = %i \n", order_of_matrix);
+
+        if (number_of_matrix < 0 || order_of_matrix <= 0) {
+            fprintf(stderr, "%s: invalid header\n", fName);
+            exit(EXIT_FAILURE);
+        }
+
+        // The size of the file must match its header
+        if (!streaming && (off_t) sizeof(header) + (off_t) number_of_matrix * order_of_matrix * order_of_matrix * (off_t) sizeof(double) != file_status.st_size) {
+            fprintf(stderr, "%s: the size of the file (%lld bytes) does not match its header\n", fName, (long long) file_status.st_size);
+            exit(EXIT_FAILURE);
+        }
+        flops = number_of_matrix * 2.0 / 3.0 * pow(order_of_matrix, 3);
+    }
 
     // Allocate memory to store each determinant
-    matrixDeterminants = malloc( number_of_matrix * sizeof(double));        
+    if (!streaming) {
+        matrixDeterminants = malloc( number_of_matrix * sizeof(double));        
+        matrixExponents = calloc( number_of_matrix, sizeof(int));
+    }
+
+    /* exact mode: the determinant of each matrix modulo each prime is a task, so the tasks are spread over all the threads */
+
+    struct MatrixInfo * legacy_list = NULL;    // work list of a legacy file, in the exact mode
+    if (exact) {
+        if (work_list == NULL) {
+            legacy_list = malloc(number_of_matrix * sizeof(struct MatrixInfo));
+            for (int m = 0; m < number_of_matrix; m++) {
+                legacy_list[m].matrix_id = m + 1;
+                legacy_list[m].order_of_matrix = order_of_matrix;
+                legacy_list[m].matrix_pointer = (double *) (mapping + sizeof(header)) + (size_t) m * order_of_matrix * order_of_matrix;
+                legacy_list[m].number_of_matrices = 1;
+                legacy_list[m].row_length = order_of_matrix;
+                legacy_list[m].list = NULL;
+            }
+        }
+        exactList = (work_list != NULL) ? work_list : legacy_list;
+
+        // The number of primes of each matrix is given by its Hadamard bound
+        int number_of_primes = 0, number_of_tasks = 0;
+        primesPerMatrix = malloc(number_of_matrix * sizeof(int));
+        matrixResidues = malloc(number_of_matrix * sizeof(uint64_t *));
+        for (int m = 0; m < number_of_matrix; m++) {
+            primesPerMatrix[m] = primesNeeded(exactList[m].matrix_pointer, exactList[m].order_of_matrix, exactList[m].row_length);
+            if (primesPerMatrix[m] < 0) {
+                fprintf(stderr, "%s: matrix %d is not a matrix of integers of less than 63 bits, required by the exact mode\n",
+                        fName, exactList[m].matrix_id);
+                exit(EXIT_FAILURE);
+            }
+            matrixResidues[m] = malloc(primesPerMatrix[m] * sizeof(uint64_t));
+            number_of_primes = (primesPerMatrix[m] > number_of_primes) ? primesPerMatrix[m] : number_of_primes;
+            number_of_tasks += primesPerMatrix[m];
+        }
+        initPrimes(number_of_primes);
+        printf("Exact mode = %d tasks, up to %d primes of 62 bits per matrix \n", number_of_tasks, number_of_primes);
+    }
 
-    // Read Order of Matrix from File
-    if(fread(&order_of_matrix, sizeof(int), 1, fpointer) != 1)
-        strerror(1);
-    printf("Matrices order = %i \n", order_of_matrix);
+    /* out of core: the matrices whose copy does not fit in the memory budget are decomposed one at a time, by all the threads */
 
-    // Store matrices in fifo
-    for (int m = 1; m<=number_of_matrix; m++) {
+    int out_of_core = 0;    // the largest matrices of a container file, or every matrix of a legacy file
+    if (memory_budget > 0) {
+        const char * directory = (getenv("TMPDIR") != NULL) ? getenv("TMPDIR") : ".";
 
-        // Create buffer for the matrix
-        double* buffer = malloc(order_of_matrix * order_of_matrix * sizeof(double));
-        int s = fread(buffer, order_of_matrix * order_of_matrix * sizeof(double), 1, fpointer);
-        if (s != 1)
-            printf("Error creating matrix buffer.");
+        for (; out_of_core < number_of_matrix; out_of_core++) {
+            int order = (work_list != NULL) ? work_list[out_of_core].order_of_matrix : order_of_matrix;
+            int row_length = (order + ROW_PADDING - 1) / ROW_PADDING * ROW_PADDING;
+            if ((size_t) order * row_length * sizeof(double) <= memory_budget)
+                break;
+            if (slabColumns(order, memory_budget) == 0) {
+                fprintf(stderr, "%s: the memory budget is too small for a matrix of order %d (at least %zu MiB)\n", basename(argv[0]),
+                        order, ((size_t) 4 * row_length * ROW_PADDING * sizeof(double) >> 20) + 1);
+                exit(EXIT_FAILURE);
+            }
 
-        // Save matrix in FIFO
-        putMatrix(buffer, order_of_matrix, m);
+            struct MatrixInfo matrixinfo;
+            if (work_list != NULL)
+                matrixinfo = work_list[out_of_core];
+            else {
+                matrixinfo.matrix_id = out_of_core + 1;
+                matrixinfo.matrix_pointer = (double *) (mapping + sizeof(header)) + (size_t) out_of_core * order * order;
+                matrixinfo.row_length = order;
+            }
+            determinantOutOfCore(matrixinfo.matrix_pointer, order, matrixinfo.row_length, memory_budget, num_of_threads, directory,
+                                 &matrixDeterminants[matrixinfo.matrix_id - 1], &matrixExponents[matrixinfo.matrix_id - 1]);
+            printf("Matrix %d processada out of core\n", matrixinfo.matrix_id);
+        }
     }
-    
-    /* close the text file */
 
-    fclose(fpointer);
+    /* share the threads by the matrices */
+
+    // With fewer matrices than threads, the threads are split in groups that decompose a matrix together, split in tasks
+    number_of_groups = num_of_threads;
+    if (!exact && !incremental && number_of_matrix < num_of_threads && order_of_matrix > LU_PANEL)
+        number_of_groups = (number_of_matrix > 0) ? number_of_matrix : 1;
 
-    /* save a struct in fifo for each thread to know that there are no more chunks to process */
+    if (number_of_groups == num_of_threads)
+        printf("Parallelism = inter-matrix \n");
+    else if (number_of_groups == 1)
+        printf("Parallelism = intra-matrix \n");
+    else
+        printf("Parallelism = mixed (%d groups of threads) \n", number_of_groups);
 
-    for (int i = 0; i < num_of_threads; i++) {
-        endMatrix();
+    initTaskGroups(number_of_groups);
+
+    // Small matrices are handed out in batches, and processed several at a time in the lanes of a vector
+    bool batched = !exact && (smallest_order <= BATCH_MAX_ORDER);
+    if (batched)
+        printf("Batched kernel = %s \n", kernelNames[tuningFor(smallest_order).batch_kernel]);
+
+    // Incremental mode: runs of consecutive matrices are handed out to the same worker, which keeps the last L U factors
+    int matrices_per_get = batched ? MATRICES_PER_BATCH : (incremental ? INCREMENTAL_RUN : 1);
+
+    if (exact)
+        initResidueTasks(primesPerMatrix, number_of_matrix);
+    else if (work_list != NULL)
+        initMatrixList(work_list + out_of_core, number_of_matrix - out_of_core, MATRICES_PER_BATCH);
+    else if (streaming)
+        initStream(input, output, number_of_matrix, order_of_matrix, matrices_per_get, num_of_threads, log_mode);
+    else if (batch)     // the small matrices of each file are batched, whatever the order of the other files
+        initFiles(number_of_inputs, files_open_at_once, incremental ? INCREMENTAL_RUN : 1, num_of_threads);
+    else    // out_of_core is 0, or every matrix of the file
+        initMatrices((double *) (mapping + sizeof(header)), number_of_matrix - out_of_core, order_of_matrix, matrices_per_get);
+
+    /* generate worker threads */
+
+    statusWorkers = malloc((num_of_threads + 1) * sizeof(int));   // Allocate memory to save the status of each worker (and of the reader)
+    structureCounts = calloc(num_of_threads, sizeof(*structureCounts));
+    pthread_t tIdWorkers[num_of_threads];
+    unsigned int workers[num_of_threads];
+    for (int i = 0; i < num_of_threads; i++)
+        workers[i] = i;
+
+    // The matrices are decomposed on the heap, so the stack of a worker does not grow with the order of the matrices
+    pthread_attr_t attr;
+    pthread_attr_init (&attr);
+    if (stack_size > 0 && (errno = pthread_attr_setstacksize (&attr, (size_t) stack_size * 1024)) != 0)
+    { perror ("error on setting the stack size of the worker threads");
+        exit (EXIT_FAILURE);
+    }
+
+    for (int i = 0; i < num_of_threads; i++)
+    if (pthread_create (&tIdWorkers[i], &attr, worker, &workers[i]) != 0)                             /* thread worker */
+    { perror ("error on creating thread worker");
+        exit (EXIT_FAILURE);
+    }
+
+    pthread_attr_destroy (&attr);
+
+    // Batch mode: the reader maps the next files while the workers decompose the matrices of the ones before
+    pthread_t tIdReader;
+    unsigned int readerId = num_of_threads;
+    if (batch && pthread_create (&tIdReader, NULL, reader, &readerId) != 0)                            /* thread reader */
+    { perror ("error on creating thread reader");
+        exit (EXIT_FAILURE);
     }
 
     /* waiting for the termination of the intervening worker threads */
@@ -175,6 +612,36 @@ int main(int argc, char *argv[])
         printf ("its status was %d\n", *status_p);
     }
 
+    if (batch)
+    { if (pthread_join (tIdReader, (void *) &status_p) != 0)                                          /* thread reader */
+        { perror ("error on waiting for thread reader");
+            exit (EXIT_FAILURE);
+        }
+        printf ("thread reader has terminated: ");
+        printf ("its status was %d\n", *status_p);
+    }
+
+    // Exact mode: the residues of each matrix are combined into its determinant, in decimal, before the file is unmapped
+    char ** exactDeterminants = NULL;
+    if (exact) {
+        exactDeterminants = malloc(number_of_matrix * sizeof(char *));
+        for (int m = 0; m < number_of_matrix; m++) {
+            exactDeterminants[exactList[m].matrix_id - 1] = combineResidues(matrixResidues[m], primesPerMatrix[m]);
+            free(matrixResidues[m]);
+        }
+        free(matrixResidues);
+        free(primesPerMatrix);
+        free(legacy_list);
+    }
+
+    if (streaming) {
+        fclose(output);
+        if (input != stdin)
+            fclose(input);
+    } else if (!batch)
+        munmap(mapping, file_status.st_size);
+    free(work_list);
+
     /* measure time */
     
     clock_gettime(CLOCK_MONOTONIC_RAW, &finish);
@@ -183,12 +650,62 @@ int main(int argc, char *argv[])
 
     /* print final results */
 
-    for (int matrix_id = 0; matrix_id < number_of_matrix; matrix_id++) {
-        printf("Processing matrix %d \n", matrix_id + 1);
-        printf("Determinant: %.3e \n\n", matrixDeterminants[matrix_id]);
+    int structures[NUMBER_OF_STRUCTURES] = {0};
+    for (int i = 0; i < num_of_threads; i++)
+        for (int s = 0; s < NUMBER_OF_STRUCTURES; s++)
+            structures[s] += structureCounts[i][s];
+    if (!exact)
+        printf("Matrices by structure = dense %d, triangular %d, banded %d, SPD %d, batched %d, incremental %d, cached %d \n", structures[STRUCTURE_DENSE],
+           structures[STRUCTURE_TRIANGULAR], structures[STRUCTURE_BANDED], structures[STRUCTURE_SPD], structures[STRUCTURE_BATCHED],
+           structures[STRUCTURE_INCREMENTAL], structures[STRUCTURE_CACHED]);
+    if (incremental)
+        printf("Incremental mode = %d of %d matrices updated from the last one factored (%.1f%%) \n", structures[STRUCTURE_INCREMENTAL],
+               number_of_matrix, (number_of_matrix > 0) ? 100.0 * structures[STRUCTURE_INCREMENTAL] / number_of_matrix : 0.0);
+
+    if (dedup) {
+        long lookups, hits;
+        double seconds_saved;
+        long entries = cacheStatistics(&lookups, &hits, &seconds_saved);
+        printf("Deduplication cache = %ld of %ld lookups hit (%.1f%%), %.3f s of decompositions saved, %ld entries \n", hits,
+               lookups, (lookups > 0) ? 100.0 * hits / lookups : 0.0, seconds_saved, entries);
+        if (kName != NULL && !saveCache(kName))
+            perror("error on saving the deduplication cache");
+    }
+
+    if (streaming)
+        printf("Determinants written to %s \n", oName);
+
+    for (int matrix_id = 0, file = 0; !streaming && matrix_id < number_of_matrix; matrix_id++) {
+        double mantissa = matrixDeterminants[matrix_id];
+
+        // Batch mode: the determinants are tagged with their file, and numbered from 1 in each file
+        if (batch) {
+            while (matrix_id + 1 >= inputFiles[file].first_id + inputFiles[file].number_of_matrices)
+                file += 1;
+            printf("Processing matrix %d of %s \n", matrix_id + 2 - inputFiles[file].first_id, inputFiles[file].name);
+            if (inputFiles[file].skipped) {
+                printf("Determinant: skipped \n\n");
+                continue;
+            }
+        } else
+            printf("Processing matrix %d \n", matrix_id + 1);
+        if (exact) {
+            printf("Determinant: %s \n\n", exactDeterminants[matrix_id]);
+            free(exactDeterminants[matrix_id]);
+        } else if (log_mode)
+            printf("Determinant: sign %d, log10|det| %.6f \n\n", (mantissa > 0) - (mantissa < 0),
+                   log10(fabs(mantissa)) + matrixExponents[matrix_id] * log10(2.0));
+        else
+            printf("Determinant: %.3e \n\n", ldexp(mantissa, matrixExponents[matrix_id]));
     }
 
+    free(exactDeterminants);
+
     printf ("\nElapsed time = %.6f s\n", elapsed);
+    printf ("Throughput = %.1f matrices/s, %.3f GFLOP/s \n", number_of_matrix / elapsed, flops / elapsed / 1e9);
+
+    if (aName != NULL)
+        checkDeterminants(aName, matrixDeterminants, matrixExponents, number_of_matrix);
 }
 
 
@@ -197,12 +714,23 @@ int main(int argc, char *argv[])
  */
 static void printUsage(char *cmdName)
 {
-    fprintf(stderr, "\nSynopsis: %s OPTIONS [filename / positive number]\n"
+    fprintf(stderr, "\nSynopsis: %s OPTIONS [filenames, directories or patterns]\n"
                     "  OPTIONS:\n"
                     "  -h      --- print this help\n"
-                    "  -f      --- filename\n"
-                    "  -t      --- number of threads\n",
-            cmdName);
+                    "  -f      --- filename (- is stdin, in the streaming mode); with several files, a directory or a pattern, batch mode\n"
+                    "  -b      --- number of files mapped in memory at once in the batch mode (%d by default)\n"
+                    "  -o      --- output file: streaming mode, the determinants are written to it as they are computed\n"
+                    "  -t      --- number of threads\n"
+                    "  -s      --- stack size of each thread, in KiB (default of the system)\n"
+                    "  -l      --- print the sign and log10 of the absolute value of each determinant\n"
+                    "  -e      --- exact mode: the determinants of matrices of integers are computed exactly\n"
+                    "  -u      --- deduplication mode: the determinant of a matrix seen before is taken from a cache\n"
+                    "  -k      --- persistent cache file of the deduplication mode, loaded at startup and saved at the end (implies -u)\n"
+                    "  -i      --- incremental mode: a matrix that differs from the last one factored in a few rows or columns is updated from it\n"
+                    "  -c      --- file with the known determinants, to check the ones computed (written by generate)\n"
+                    "  -m      --- memory budget, in MiB: larger matrices are decomposed out of core, in a scratch file in $TMPDIR (or .)\n"
+                    "  -p      --- tuning profile, written by autotune (" DEFAULT_PROFILE " by default, built-in heuristics if it does not exist)\n",
+            cmdName, BATCH_OPEN_FILES);
 }
 
 
@@ -210,12 +738,41 @@ static void printUsage(char *cmdName)
  *  \brief Function worker.
  *
  *  Its role is to get matrices of data and compute the determinant.
+ *  Worker i belongs to the group i % number_of_groups. A worker alone in its group computes the determinant of each
+ *  matrix by itself; otherwise the leader of the group (the worker with the lowest id) gets the matrices and the
+ *  workers of the group run the tasks of their decomposition together.
+ *  The structure of each matrix is probed first: triangular, band and symmetric positive definite matrices are
+ *  decomposed by the leader alone, by the cheaper functions of structure.c.
+ *  In the exact mode, the worker runs the tasks of the multi-modular determinants instead; in the incremental mode, it
+ *  gets runs of consecutive matrices, each one updated from the last one factored when it can be (runIncremental).
  *
  *  \param par pointer to application defined worker identification
  */
 static void *worker(void *par) {
     unsigned int id = *((unsigned int *) par);      // worker id
+    unsigned int group = id % number_of_groups;     // group of the worker
+    bool leader = (id < number_of_groups);          // the leader gets the matrices of the group
     
+    if (exact) {
+        runResidueTasks(id);
+
+        statusWorkers[id] = EXIT_SUCCESS;
+        pthread_exit (&statusWorkers[id]);
+    }
+
+    // Workers of the group that do not get matrices only run tasks
+    if (!leader) {
+        runTasks(id, group, false);
+
+        statusWorkers[id] = EXIT_SUCCESS;
+        pthread_exit (&statusWorkers[id]);
+    }
+
+    double * scratch = NULL;    // private copy of the matrix being decomposed, with aligned and padded rows
+    int scratch_order = 0;
+    double * packed = NULL;     // small matrices of a work list, one after the other
+    int * pivots = NULL;        // pivot row of each column of the matrix in the scratch buffer, in the incremental mode
+
     while (true) {
         // Get matrix
         struct MatrixInfo matrixinfo = getMatrix(id);
@@ -223,86 +780,733 @@ static void *worker(void *par) {
         // Checks if it is the matrix struct that tells that there are no more matrices to process
         if (matrixinfo.matrix_id == -1) break;
 
+        // Process batch of small matrices
+        if (matrixinfo.order_of_matrix <= BATCH_MAX_ORDER) {
+            double batch_determinants[MATRICES_PER_BATCH];
+            double * determinants = (streaming || matrixinfo.list != NULL) ? batch_determinants : matrixDeterminants + matrixinfo.matrix_id - 1;
+            int order_of_matrix = matrixinfo.order_of_matrix;
+
+            // The matrices of a work list are packed one after the other first
+            if (matrixinfo.list != NULL) {
+                if (packed == NULL)
+                    packed = malloc(MATRICES_PER_BATCH * BATCH_MAX_ORDER * BATCH_MAX_ORDER * sizeof(double));
+                for (int m = 0; m < matrixinfo.number_of_matrices; m++)
+                    for (int l = 0; l < order_of_matrix; l++)
+                        memcpy(packed + (m * order_of_matrix + l) * order_of_matrix,
+                               matrixinfo.list[m].matrix_pointer + (size_t) l * matrixinfo.list[m].row_length, order_of_matrix * sizeof(double));
+                matrixinfo.matrix_pointer = packed;
+            }
+
+            det_batch(matrixinfo.matrix_pointer, order_of_matrix, matrixinfo.number_of_matrices, determinants, &(struct DetOptions) { DET_BATCHED, NULL });
+            structureCounts[id][STRUCTURE_BATCHED] += matrixinfo.number_of_matrices;
+
+            if (matrixinfo.list != NULL) {
+                for (int m = 0; m < matrixinfo.number_of_matrices; m++)
+                    matrixDeterminants[matrixinfo.list[m].matrix_id - 1] = determinants[m];
+                printf("%d matrices of order %d processadas pela thread %d\n", matrixinfo.number_of_matrices, order_of_matrix, id);
+                continue;
+            }
+
+            if (streaming)
+                putDeterminants(id, matrixinfo.matrix_id, matrixinfo.number_of_matrices, determinants, NULL);
+
+            printf("Matrices %d to %d processadas pela thread %d\n", matrixinfo.matrix_id,
+                   matrixinfo.matrix_id + matrixinfo.number_of_matrices - 1, id);
+            continue;
+        }
+
+        // Scratch buffer for the copy of the matrix, with aligned rows and the padding set to 0
+        int order_of_matrix = matrixinfo.order_of_matrix;
+        int row_length = (order_of_matrix + ROW_PADDING - 1) / ROW_PADDING * ROW_PADDING;
+        if (scratch_order != order_of_matrix) {
+            free(scratch);
+            scratch = aligned_alloc(ROW_PADDING * sizeof(double), (size_t) order_of_matrix * row_length * sizeof(double));
+            memset(scratch, 0, (size_t) order_of_matrix * row_length * sizeof(double));
+            pivots = realloc(pivots, order_of_matrix * sizeof(int));
+            scratch_order = order_of_matrix;
+        }
+
+        // Incremental mode: a run of consecutive matrices
+        if (incremental) {
+            runIncremental(id, matrixinfo, scratch, pivots);
+            continue;
+        }
+
         // Process matrix
         double determinant = 1;
-        computeDeterminant(&matrixinfo, &determinant);
+        int exponent = 0;
+        int structure = decomposeMatrix(id, group, matrixinfo, scratch, NULL, &determinant, &exponent);
+        structureCounts[id][structure] += 1;
 
-        // Free the memory of the buffer
-        free(matrixinfo.matrix_pointer);
-        
         // Save result
-        matrixDeterminants[matrixinfo.matrix_id - 1] = determinant;
+        if (streaming)
+            putDeterminants(id, matrixinfo.matrix_id, 1, &determinant, &exponent);
+        else {
+            matrixDeterminants[matrixinfo.matrix_id - 1] = determinant;
+            matrixExponents[matrixinfo.matrix_id - 1] = exponent;
+        }
 
         printf("Matrix %d processada pela thread %d\n", matrixinfo.matrix_id, id);
     }
 
+    free(scratch);
+    free(packed);
+    free(pivots);
+
+    // Let the other workers of the group know that there are no more matrices
+    endTasks(id, group);
+
     statusWorkers[id] = EXIT_SUCCESS;
     pthread_exit (&statusWorkers[id]);
 }
 
 
 /**
- *  \brief Function to compute the determinant of a matrix. 
+ *  \brief Function decomposeMatrix.
+ *
+ *  Its role is to copy a matrix from the file mapped in memory (or from the input buffer) to the scratch buffer, find
+ *  its structure and compute its determinant: triangular, band and symmetric positive definite matrices take a cheaper
+ *  path than the dense decomposition, which the worker runs alone or, with the workers of its group, split in tasks.
+ *  In the deduplication mode, the matrix is hashed as it is copied (cache.c): a matrix whose determinant is in the
+ *  cache is not decomposed, and the determinant of any other one is inserted, with the time its decomposition took.
  *
- *  \param matrixinfo pointer to the struct MatrixInfo containing the information about the matrix
- *  \param determinant pointer to a double to save the determinant value
+ *  \param id worker identification
+ *  \param group group of the worker
+ *  \param matrixinfo information of the matrix
+ *  \param scratch pointer to the scratch buffer, with aligned rows and the padding set to 0
+ *  \param pivots pointer to store the pivot row of each column of a dense decomposition (NULL if they are not needed)
+ *  \param determinant pointer to a double to multiply by the determinant of the matrix (its mantissa is left; 1 in the deduplication mode)
+ *  \param exponent pointer to an int to add the binary exponent of the determinant to (0 in the deduplication mode)
+ *
+ *  \return structure of the matrix, STRUCTURE_CACHED if its determinant is found in the deduplication cache (with pivots, the L U factors of a dense matrix are left in the scratch buffer)
  */
-static void computeDeterminant(struct MatrixInfo * matrixinfo, double * determinant) {
+static int decomposeMatrix(unsigned int id, unsigned int group, struct MatrixInfo matrixinfo, double * scratch, int * pivots,
+                           double * determinant, int * exponent) {
 
-    // Get information about the matrix
-    int order_of_matrix = (*matrixinfo).order_of_matrix;
-    double *matrix_pointer = (*matrixinfo).matrix_pointer;
+    int order_of_matrix = matrixinfo.order_of_matrix;
+    int row_length = (order_of_matrix + ROW_PADDING - 1) / ROW_PADDING * ROW_PADDING;
 
-    // Define matrix coeficients structure (2D Array)
-    double matrix_coeficients[order_of_matrix][order_of_matrix];
+    // Deduplication: the matrix is hashed while it is copied, and a matrix seen before is not decomposed again
+    struct CacheKey key;
+    struct timespec start, finish;
+    if (dedup) {
+        key = copyAndHash(scratch, row_length, matrixinfo.matrix_pointer, order_of_matrix, matrixinfo.row_length);
 
-    // Read Matrix Coefficients from buffer and save it to 2D array
-    for (int l = 0; l < order_of_matrix; l++) {
-        int line_offset = l * order_of_matrix;
-        for (int column = 0; column < order_of_matrix; column++) {
-            double coefficient = *(matrix_pointer + column + line_offset);
-            matrix_coeficients[l][column] = coefficient;
+        double cached_determinant;
+        int cached_exponent;
+        if (lookupDeterminant(id, &key, matrixinfo.matrix_pointer, matrixinfo.row_length, &cached_determinant, &cached_exponent)) {
+            int scale;
+            *determinant = frexp(*determinant * cached_determinant, &scale);
+            *exponent += cached_exponent + scale;
+            return STRUCTURE_CACHED;
         }
+        clock_gettime(CLOCK_MONOTONIC_RAW, &start);
+    } else
+        for (int l = 0; l < order_of_matrix; l++)
+            memcpy(scratch + (size_t) l * row_length, matrixinfo.matrix_pointer + (size_t) l * matrixinfo.row_length, order_of_matrix * sizeof(double));
+
+    const double * original = matrixinfo.matrix_pointer;
+
+    // Triangular, band and symmetric positive definite matrices take a cheaper path than the dense decomposition
+    int lower, upper;
+    int structure = probeStructure(scratch, order_of_matrix, row_length, &lower, &upper);
+
+    if (structure == STRUCTURE_SPD && !decomposeSymmetric(scratch, order_of_matrix, row_length)) {
+        // Not positive definite: the matrix is copied again for the dense decomposition
+        for (int l = 0; l < order_of_matrix; l++)
+            memcpy(scratch + (size_t) l * row_length, matrixinfo.matrix_pointer + (size_t) l * matrixinfo.row_length, order_of_matrix * sizeof(double));
+        structure = STRUCTURE_DENSE;
     }
+    matrixinfo.matrix_pointer = scratch;
 
-    // Transform Matrix in a upper triangular matrix
-    for (int l = 0; l < order_of_matrix-1; l++) {
-        if (matrix_coeficients[l][l] != 0.0) {
-            
-            for(int k=l+1; k<order_of_matrix; k++){
-                double  term=matrix_coeficients[k][l]/ matrix_coeficients[l][l];
-                for(int j=0; j< order_of_matrix; j++){
-                    matrix_coeficients[k][j]=matrix_coeficients[k][j]-term*matrix_coeficients[l][j];
-                }
+    if (structure != STRUCTURE_DENSE) {
+        if (structure == STRUCTURE_BANDED)
+            *determinant = decomposeBanded(scratch, order_of_matrix, row_length, lower, upper);
+        det_multiply_diagonal(scratch, order_of_matrix, row_length, determinant, exponent);
+    } else if (id + number_of_groups >= num_of_threads) {
+        det_factor(scratch, order_of_matrix, row_length, DET_SIMD, pivots, determinant, exponent);      // alone in the group
+    } else {
+        startMatrix(id, group, matrixinfo);
+        runTasks(id, group, true);
+        *determinant = finishMatrix(id, group);
+
+        // Determinant from the upper triangular matrix (its sign was given by the row swaps)
+        det_multiply_diagonal(matrixinfo.matrix_pointer, order_of_matrix, row_length, determinant, exponent);
+    }
+
+    if (dedup) {
+        clock_gettime(CLOCK_MONOTONIC_RAW, &finish);
+        insertDeterminant(id, &key, original, matrixinfo.row_length, *determinant, *exponent,
+                          (finish.tv_sec - start.tv_sec) + (finish.tv_nsec - start.tv_nsec) / 1000000000.0);
+    }
+
+    return structure;
+}
+
+
+/**
+ *  \brief Function runIncremental.
+ *
+ *  Its role is to compute the determinants of a run of consecutive matrices. Each matrix is compared with the last one
+ *  of the run decomposed by a dense decomposition, whose L U factors are kept in the scratch buffer: if they differ in
+ *  less than 1 / INCREMENTAL_RANK_FRACTION of the rows or columns, the determinant is updated from the one of the last
+ *  matrix by the matrix determinant lemma (incremental.c); otherwise, or if the update is unstable, the matrix is
+ *  decomposed in full, and its factors are kept in turn.
+ *
+ *  \param id worker identification
+ *  \param run information of the first matrix of the run, and the number of matrices
+ *  \param scratch pointer to the scratch buffer, with aligned rows and the padding set to 0
+ *  \param pivots pointer to a buffer for the pivot row of each column
+ */
+static void runIncremental(unsigned int id, struct MatrixInfo run, double * scratch, int * pivots) {
+
+    int order_of_matrix = run.order_of_matrix;
+    int row_length = (order_of_matrix + ROW_PADDING - 1) / ROW_PADDING * ROW_PADDING;
+    int max_rank = order_of_matrix / INCREMENTAL_RANK_FRACTION;
+    int * indices = malloc(max_rank * sizeof(int));
+    double * work = malloc(((size_t) order_of_matrix + max_rank) * max_rank * sizeof(double));
+    const double * base = NULL;         // last matrix factored, with its L U factors in the scratch buffer (NULL if there is none)
+    double base_determinant = 0, determinants[INCREMENTAL_RUN];
+    int base_exponent = 0, exponents[INCREMENTAL_RUN];
+
+    for (int m = 0; m < run.number_of_matrices; m++) {
+        struct MatrixInfo matrixinfo = run;
+        matrixinfo.matrix_id = run.matrix_id + m;
+        matrixinfo.matrix_pointer = run.matrix_pointer + (size_t) m * order_of_matrix * run.row_length;
+        matrixinfo.number_of_matrices = 1;
+
+        bool columns;
+        int rank = (base != NULL) ? lowRankDifference(base, matrixinfo.matrix_pointer, order_of_matrix, run.row_length,
+                                                       max_rank, indices, &columns) : -1;
+        determinants[m] = base_determinant;
+        exponents[m] = base_exponent;
+
+        if (rank >= 0 && updateDeterminant(scratch, pivots, order_of_matrix, row_length, base, matrixinfo.matrix_pointer,
+                                           run.row_length, indices, rank, columns, work, &determinants[m], &exponents[m])) {
+            structureCounts[id][STRUCTURE_INCREMENTAL] += 1;
+            continue;
+        }
+
+        determinants[m] = 1;
+        exponents[m] = 0;
+        int structure = decomposeMatrix(id, id % number_of_groups, matrixinfo, scratch, pivots, &determinants[m], &exponents[m]);
+        structureCounts[id][structure] += 1;
+
+        // Only the dense decomposition of a nonsingular matrix leaves L U factors to update from
+        base = (structure == STRUCTURE_DENSE && determinants[m] != 0) ? matrixinfo.matrix_pointer : NULL;
+        base_determinant = determinants[m];
+        base_exponent = exponents[m];
+    }
+
+    // Save results
+    if (streaming)
+        putDeterminants(id, run.matrix_id, run.number_of_matrices, determinants, exponents);
+    else
+        for (int m = 0; m < run.number_of_matrices; m++) {
+            matrixDeterminants[run.matrix_id - 1 + m] = determinants[m];
+            matrixExponents[run.matrix_id - 1 + m] = exponents[m];
+        }
+
+    printf("Matrices %d to %d processadas pela thread %d\n", run.matrix_id, run.matrix_id + run.number_of_matrices - 1, id);
+
+    free(indices);
+    free(work);
+}
+
+
+/**
+ *  \brief Function runResidueTasks.
+ *
+ *  Its role is to get the tasks of the exact mode and compute the determinant of their matrix modulo their prime,
+ *  until there are no more tasks.
+ *
+ *  \param id worker identification
+ */
+static void runResidueTasks(unsigned int id) {
+
+    uint64_t * scratch = NULL;      // matrix being decomposed, in the Montgomery form
+    int scratch_order = 0;
+
+    while (true) {
+        struct ResidueTask task = getResidueTask(id);
+        if (task.matrix == -1) break;
+
+        const struct MatrixInfo * matrixinfo = &exactList[task.matrix];
+        if (scratch_order < matrixinfo->order_of_matrix) {
+            free(scratch);
+            scratch_order = matrixinfo->order_of_matrix;
+            scratch = malloc((size_t) scratch_order * scratch_order * sizeof(uint64_t));
+        }
+
+        matrixResidues[task.matrix][task.prime] = determinantModulo(matrixinfo->matrix_pointer, matrixinfo->order_of_matrix,
+                                                                    matrixinfo->row_length, task.prime, scratch);
+
+        printf("Matrix %d, primo %d processada pela thread %d\n", matrixinfo->matrix_id, task.prime + 1, id);
+    }
+
+    free(scratch);
+}
+
+
+/**
+ *  \brief Function runTasks.
+ *
+ *  Its role is to get the tasks of the decomposition of the matrices of a group and run them, until there are no more
+ *  tasks for the worker: for the leader, when its matrix is decomposed; for the other workers, when there are no more matrices.
+ *
+ *  \param id worker identification
+ *  \param group group of the worker
+ *  \param leader true if the worker is the leader of the group
+ */
+static void runTasks(unsigned int id, unsigned int group, bool leader) {
+
+    while (true) {
+        struct Task task = getTask(id, group, leader);
+        if (task.type == TASK_NONE) break;
+
+        int row_swaps = 0;
+        if (task.type == TASK_PANEL)
+            row_swaps = factorPanel(&task);
+        else
+            updateBlock(&task);
+
+        taskDone(id, group, task, row_swaps);
+    }
+}
+
+
+/**
+ *  \brief Function to decompose a panel of a matrix.
+ *
+ *  Its role is to decompose the LU_PANEL columns of the panel column by column, with partial pivoting, like det_factor (det.c),
+ *  but the rows are only swapped in the columns of the panel: the row swaps are saved, so each block to the right
+ *  applies them when it is updated by the panel (updateBlock).
+ *
+ *  \param task pointer to the task (panel of the matrix)
+ *
+ *  \return number of row swaps, or -1 if the matrix is singular
+ */
+static int factorPanel(struct Task * task) {
+
+    int order_of_matrix = task->matrix.order_of_matrix;
+    int row_length = task->row_length;
+    double *matrix_coeficients = task->matrix.matrix_pointer;
+    int panel = task->panel * LU_PANEL;
+    int panel_end = (panel + LU_PANEL < order_of_matrix) ? panel + LU_PANEL : order_of_matrix;
+    int row_swaps = 0;
+
+    for (int l = panel; l < panel_end; l++) {
+
+        // The pivot is the coefficient of column l, on or below the diagonal, with the largest absolute value
+        int pivot = l;
+        for (int k = l+1; k < order_of_matrix; k++) {
+            if (fabs(matrix_coeficients[k*row_length + l]) > fabs(matrix_coeficients[pivot*row_length + l]))
+                pivot = k;
+        }
+
+        if (matrix_coeficients[pivot*row_length + l] == 0.0)
+            return -1;
+
+        // Swap rows in the columns of the panel
+        task->pivots[l] = pivot;
+        double * row_l = matrix_coeficients + l*row_length;
+        if (pivot != l) {
+            double * row_pivot = matrix_coeficients + pivot*row_length;
+            for (int j = panel; j < panel_end; j++) {
+                double temp = row_l[j];
+                row_l[j] = row_pivot[j];
+                row_pivot[j] = temp;
             }
+            row_swaps += 1;
+        }
+
+        // Save the multipliers in column l and update the rest of the panel
+        for (int k = l+1; k < order_of_matrix; k++) {
+            double * row_k = matrix_coeficients + k*row_length;
+            double term = row_k[l] / row_l[l];
+            row_k[l] = term;
+            for (int j = l+1; j < panel_end; j++)
+                row_k[j] -= term * row_l[j];
+        }
+    }
+
+    return row_swaps;
+}
 
+
+/**
+ *  \brief Function to update a block of columns of a matrix with a panel.
+ *
+ *  Its role is to apply the row swaps of the panel to the LU_PANEL columns of the block, compute the rows of the upper
+ *  triangular matrix in the block and update the rest of the block with the kernel chosen for the order (tuning.c).
+ *
+ *  \param task pointer to the task (panel and block of the matrix)
+ */
+static void updateBlock(struct Task * task) {
+
+    int order_of_matrix = task->matrix.order_of_matrix;
+    int row_length = task->row_length;
+    double *matrix_coeficients = task->matrix.matrix_pointer;
+    int panel = task->panel * LU_PANEL;
+    int panel_end = (panel + LU_PANEL < order_of_matrix) ? panel + LU_PANEL : order_of_matrix;
+    int block = task->block * LU_PANEL;
+    int block_end = (block + LU_PANEL < order_of_matrix) ? block + LU_PANEL : order_of_matrix;
+
+    /* Swap rows, in the order of the panel */
+    for (int l = panel; l < panel_end; l++) {
+        int pivot = task->pivots[l];
+        if (pivot != l) {
+            double * row_l = matrix_coeficients + l*row_length;
+            double * row_pivot = matrix_coeficients + pivot*row_length;
+            for (int j = block; j < block_end; j++) {
+                double temp = row_l[j];
+                row_l[j] = row_pivot[j];
+                row_pivot[j] = temp;
+            }
+        }
+    }
+
+    /* Compute the rows of the upper triangular matrix in the block */
+    for (int l = panel; l < panel_end; l++) {
+        double * row_l = matrix_coeficients + l*row_length;
+        for (int k = l+1; k < panel_end; k++) {
+            double * row_k = matrix_coeficients + k*row_length;
+            double term = row_k[l];
+            for (int j = block; j < block_end; j++)
+                row_k[j] -= term * row_l[j];
+        }
+    }
+
+    /* Update the rest of the block */
+    if (panel_end < order_of_matrix)
+        updateKernels[tuningFor(order_of_matrix).update_kernel](matrix_coeficients, row_length, panel_end, order_of_matrix,
+                                                                panel, panel_end, block, block_end);
+}
+
+
+/**
+ *  \brief Function to expand the directories and patterns given into the input files of the batch mode.
+ *
+ *  Its role is to build the list of the input files from the names given: a directory stands for its regular files,
+ *  in alphabetical order (hidden files excluded), and a name that does not exist but has wildcards (*, ? or [) for the
+ *  files matching it, as the shell would expand it (the pattern may be quoted, to keep the command line short).
+ *
+ *  \param names file names, directories and patterns
+ *  \param number_of_names number of names
+ *  \param files pointer to store the list of the input files
+ *  \param expanded pointer to a bool to store whether a directory or a pattern was expanded
+ *
+ *  \return number of input files
+ */
+static int expandInputs(char ** names, int number_of_names, char *** files, bool * expanded) {
+
+    int number_of_files = 0;
+
+    *files = NULL;
+    *expanded = false;
+    for (int n = 0; n < number_of_names; n++) {
+        struct stat name_status;
+        bool exists = (stat(names[n], &name_status) == 0);
+
+        if (exists && S_ISDIR(name_status.st_mode)) {
+            struct dirent ** entries;
+            int number_of_entries = scandir(names[n], &entries, NULL, alphasort);
+            if (number_of_entries < 0) {
+                perror(names[n]);
+                exit(EXIT_FAILURE);
+            }
+            // The trailing slashes of the directory are left out, so the paths are "dir/file" (but "/file" for the root)
+            int dir_length = strlen(names[n]);
+            while (dir_length > 1 && names[n][dir_length - 1] == '/')
+                dir_length -= 1;
+            if (names[n][dir_length - 1] == '/')
+                dir_length = 0;
+            for (int e = 0; e < number_of_entries; e++) {
+                size_t path_size = dir_length + strlen(entries[e]->d_name) + 2;
+                char * path = malloc(path_size);
+                snprintf(path, path_size, "%.*s/%s", dir_length, names[n], entries[e]->d_name);
+                if (entries[e]->d_name[0] != '.' && stat(path, &name_status) == 0 && S_ISREG(name_status.st_mode)) {
+                    *files = realloc(*files, (number_of_files + 1) * sizeof(char *));
+                    (*files)[number_of_files++] = path;
+                } else
+                    free(path);
+                free(entries[e]);
+            }
+            free(entries);
+            *expanded = true;
+        } else if (!exists && strpbrk(names[n], "*?[") != NULL) {
+            glob_t matches;
+            if (glob(names[n], 0, NULL, &matches) == 0) {
+                for (size_t m = 0; m < matches.gl_pathc; m++)
+                    if (stat(matches.gl_pathv[m], &name_status) == 0 && S_ISREG(name_status.st_mode)) {
+                        *files = realloc(*files, (number_of_files + 1) * sizeof(char *));
+                        (*files)[number_of_files++] = strdup(matches.gl_pathv[m]);
+                    }
+                globfree(&matches);
+            }
+            *expanded = true;
         } else {
-            // Find column != 0.0 to be changed
-            int columnToChange = -1;
-            for (int j=l+1; j<order_of_matrix; j++) {
-                if (matrix_coeficients[l][j] != 0.0) {
-                    columnToChange = j;
+            *files = realloc(*files, (number_of_files + 1) * sizeof(char *));
+            (*files)[number_of_files++] = names[n];
+        }
+    }
+
+    return number_of_files;
+}
+
+
+/**
+ *  \brief Function to read the headers of the input files of the batch mode.
+ *
+ *  Its role is to read the header of each file (and the index of a container file) and number the matrices of all the
+ *  files together, in the order of the files, so their determinants are stored as the ones of a single file. A file
+ *  that can not be read, or whose size does not match its header, is skipped with a message, and so is a container
+ *  file in the incremental mode; the files are not mapped in memory here, but by the reader, a few at a time.
+ *
+ *  \param files names of the input files
+ *  \param number_of_files number of input files
+ *  \param largest_order pointer to an int to store the largest order of the matrices
+ *  \param smallest_order pointer to an int to store the smallest order of the matrices
+ *  \param flops pointer to a double to store the floating point operations of the decompositions
+ *
+ *  \return number of matrices of the files
+ */
+static int scanInputs(char ** files, int number_of_files, int * largest_order, int * smallest_order, double * flops) {
+
+    int number_of_matrices = 0;
+
+    inputFiles = malloc(number_of_files * sizeof(struct InputFile));
+    *largest_order = 0;
+    *smallest_order = INT32_MAX;
+    *flops = 0;
+
+    for (int f = 0; f < number_of_files; f++) {
+        struct InputFile input = { files[f], false, 0, 0, number_of_matrices + 1, 0, NULL, NULL, false };
+        struct ContainerHeader header;
+        struct stat file_status;
+        const char * problem = NULL;
+        int largest = 0, smallest = INT32_MAX;
+        double file_flops = 0;
+
+        int fd = open(files[f], O_RDONLY);
+        ssize_t length = (fd == -1 || fstat(fd, &file_status) == -1) ? -1 : pread(fd, &header, sizeof(header), 0);
+
+        if (length < 0)
+            problem = strerror(errno);
+        else if (length >= (ssize_t) sizeof(header) && memcmp(header.magic, CONTAINER_MAGIC, sizeof(CONTAINER_MAGIC) - 1) == 0) {
+            // Container file: the orders are taken from its index, which the reader checks when it maps the file
+            size_t index_length = (size_t) header.number_of_matrices * sizeof(struct ContainerEntry);
+            struct ContainerEntry * index = malloc(index_length + 1);
+
+            input.container = true;
+            input.number_of_matrices = header.number_of_matrices;
+            if (incremental)
+                problem = "the incremental mode (-i) needs legacy files";
+            else if (header.number_of_matrices > INT32_MAX - number_of_matrices ||
+                     pread(fd, index, index_length, header.index_offset) != (ssize_t) index_length)
+                problem = "the index does not fit in the file";
+            else
+                for (uint32_t m = 0; m < header.number_of_matrices; m++) {
+                    int order = (index[m].order <= INT32_MAX) ? index[m].order : INT32_MAX;
+                    largest = (order > largest) ? order : largest;
+                    smallest = (order < smallest) ? order : smallest;
+                    file_flops += 2.0 / 3.0 * pow(order, 3);
                 }
+            free(index);
+        } else if (length >= (ssize_t) (2 * sizeof(int))) {
+            // Legacy file: number and order of the matrices
+            int legacy[2];
+            memcpy(legacy, &header, sizeof(legacy));
+            input.number_of_matrices = legacy[0];
+            input.order_of_matrix = largest = smallest = legacy[1];
+            if (legacy[0] < 0 || legacy[1] <= 0 || legacy[0] > INT32_MAX - number_of_matrices)
+                problem = "invalid header";
+            else if ((off_t) sizeof(legacy) + (off_t) legacy[0] * legacy[1] * legacy[1] * (off_t) sizeof(double) != file_status.st_size)
+                problem = "the size of the file does not match its header";
+            file_flops = legacy[0] * 2.0 / 3.0 * pow(legacy[1], 3);
+        } else
+            problem = "the file has no header";
+
+        if (fd != -1)
+            close(fd);
+        if (problem != NULL) {
+            fprintf(stderr, "%s: skipped, %s\n", files[f], problem);
+            continue;
+        }
+
+        input.size = file_status.st_size;
+        inputFiles[number_of_inputs++] = input;
+        number_of_matrices += input.number_of_matrices;
+        if (input.number_of_matrices > 0) {
+            *largest_order = (largest > *largest_order) ? largest : *largest_order;
+            *smallest_order = (smallest < *smallest_order) ? smallest : *smallest_order;
+        }
+        *flops += file_flops;
+    }
+
+    if (number_of_matrices == 0)
+        *largest_order = *smallest_order = 1;
+
+    return number_of_matrices;
+}
+
+
+/**
+ *  \brief Function reader.
+ *
+ *  Its role is to map the input files of the batch mode in memory, in order, while the workers decompose the matrices
+ *  of the files before: up to files_open_at_once files are mapped at a time, and each one is read in full as it is
+ *  mapped (MAP_POPULATE), so the workers do not wait for the disk. When the window is full, the reader takes back a
+ *  file whose matrices are all done, unmaps it and maps the next one. The matrices of a file that is unmapped are
+ *  forgotten by the deduplication cache, which keeps their determinants. A file that can not be mapped, or whose
+ *  index is invalid, is skipped with a message and the other files go on; its determinants are reported as skipped.
+ *
+ *  \param par pointer to application defined reader identification
+ */
+static void *reader(void *par) {
+
+    unsigned int id = *((unsigned int *) par);      // reader id (after the ids of the workers)
+    int opened = 0, retired = 0;
+
+    while (retired < number_of_inputs) {
+        if (opened < number_of_inputs && opened - retired < files_open_at_once) {
+            // Map the next file
+            struct InputFile * input = &inputFiles[opened];
+            int fd = open(input->name, O_RDONLY);
+            input->mapping = (fd == -1) ? MAP_FAILED : mmap(NULL, input->size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+            if (input->mapping == MAP_FAILED) {
+                fprintf(stderr, "%s: skipped, %s\n", input->name, strerror(errno));
+                input->mapping = NULL;
+                input->skipped = true;
             }
+            if (fd != -1)
+                close(fd);
 
-            if (columnToChange == -1) {
-                *determinant = 0;
-                break;
-            } else {
-                int temp;
-                for (int i = 0; i < order_of_matrix; ++i) {
-                    temp = matrix_coeficients[i][l - 1];
-                    matrix_coeficients[i][l - 1] = matrix_coeficients[i][columnToChange - 1];
-                    matrix_coeficients[i][columnToChange - 1] = temp;
+            struct MatrixFile file = { opened, input->first_id, input->number_of_matrices, input->order_of_matrix, NULL, NULL, 0, 0 };
+            if (input->container && !input->skipped) {
+                int number_of_matrices;
+                input->work_list = loadContainer(input->mapping, input->size, input->name, &number_of_matrices);
+                if (input->work_list == NULL) {
+                    fprintf(stderr, "%s: skipped\n", input->name);
+                    munmap(input->mapping, input->size);
+                    input->mapping = NULL;
+                    input->skipped = true;
+                } else {
+                    for (int m = 0; m < number_of_matrices; m++)
+                        input->work_list[m].matrix_id += input->first_id - 1;
+                    file.list = input->work_list;
                 }
-            }
+            } else if (!input->skipped)
+                file.matrices = (double *) (input->mapping + 2 * sizeof(int));
 
+            // A file skipped is handed to the workers with no matrices, so it is retired at once
+            if (input->skipped)
+                file.number_of_matrices = 0;
+
+            putFile(id, &file);
+            opened += 1;
+        } else {
+            // Unmap a file whose matrices are all done
+            struct MatrixFile file = retireFile(id);
+            struct InputFile * input = &inputFiles[file.file_id];
+
+            if (input->mapping != NULL) {
+                if (dedup)
+                    forgetMatrices(id, input->mapping, input->size);
+                munmap(input->mapping, input->size);
+            }
+            free(input->work_list);
+            input->mapping = NULL;
+            input->work_list = NULL;
+            retired += 1;
         }
     }
 
-    // Calculate Determinant from upper triangular matrix  (Multiply Diagonal Values)
-    for(int l = 0; l < order_of_matrix; l++){
-        *determinant = *determinant*matrix_coeficients[l][l];
+    statusWorkers[id] = EXIT_SUCCESS;
+    pthread_exit (&statusWorkers[id]);
+}
+
+
+/**
+ *  \brief Function to validate a container file and build its work list.
+ *
+ *  Its role is to check the header and the index of a container file (container.h) against the size of the file
+ *  and to build the work list of its matrices, sorted by the cost of their decomposition (order^3), the largest first,
+ *  so the last matrices to be handed out are the smallest ones. An error is reported, and no work list is built.
+ *
+ *  \param mapping pointer to the container file mapped in memory
+ *  \param size size of the file
+ *  \param fName name of the file
+ *  \param number_of_matrices pointer to an int to store the number of matrices
+ *
+ *  \return work list, with the information of each matrix (NULL if the file is invalid)
+ */
+static struct MatrixInfo * loadContainer(char * mapping, off_t size, char * fName, int * number_of_matrices) {
+
+    struct ContainerHeader * header = (struct ContainerHeader *) mapping;
+
+    if (header->version != CONTAINER_VERSION) {
+        fprintf(stderr, "%s: container version %u is not supported\n", fName, header->version);
+        return NULL;
+    }
+    if (header->index_offset % sizeof(uint64_t) != 0 || header->index_offset > (uint64_t) size ||
+        header->number_of_matrices > ((uint64_t) size - header->index_offset) / sizeof(struct ContainerEntry)) {
+        fprintf(stderr, "%s: the index does not fit in the file\n", fName);
+        return NULL;
+    }
+    if (header->number_of_matrices > INT32_MAX) {
+        fprintf(stderr, "%s: the number of matrices (%u) is too large\n", fName, header->number_of_matrices);
+        return NULL;
     }
 
+    struct ContainerEntry * index = (struct ContainerEntry *) (mapping + header->index_offset);
+    struct MatrixInfo * work_list = malloc((header->number_of_matrices + 1) * sizeof(struct MatrixInfo));
+
+    for (uint32_t m = 0; m < header->number_of_matrices; m++) {
+        struct ContainerEntry * entry = &index[m];
+
+        if (entry->dtype != DTYPE_FLOAT64) {
+            fprintf(stderr, "%s: matrix %u has an unsupported type of coefficients (%u)\n", fName, m + 1, entry->dtype);
+            free(work_list);
+            return NULL;
+        }
+        if (entry->order == 0 || entry->order > INT32_MAX || entry->row_length < entry->order ||
+            entry->offset % CONTAINER_ALIGNMENT != 0 || entry->offset > (uint64_t) size ||
+            (uint64_t) entry->order * entry->row_length > ((uint64_t) size - entry->offset) / sizeof(double)) {
+            fprintf(stderr, "%s: matrix %u does not fit in the file\n", fName, m + 1);
+            free(work_list);
+            return NULL;
+        }
+
+        work_list[m].matrix_id = m + 1;
+        work_list[m].order_of_matrix = entry->order;
+        work_list[m].matrix_pointer = (double *) (mapping + entry->offset);
+        work_list[m].number_of_matrices = 1;
+        work_list[m].row_length = entry->row_length;
+        work_list[m].list = NULL;
+    }
+
+    // The largest first (the order of the file among matrices of the same order)
+    qsort(work_list, header->number_of_matrices, sizeof(struct MatrixInfo), compareCost);
+
+    *number_of_matrices = header->number_of_matrices;
+    return work_list;
+}
+
+
+/**
+ *  \brief Function to compare the cost of the decomposition of two matrices, for qsort.
+ *
+ *  \param a pointer to the information of a matrix
+ *  \param b pointer to the information of another matrix
+ *
+ *  \return negative if the first matrix goes first in the work list (larger order, or same order and smaller id)
+ */
+static int compareCost(const void * a, const void * b) {
+
+    const struct MatrixInfo * first = a, * second = b;
+
+    if (first->order_of_matrix != second->order_of_matrix)
+        return (first->order_of_matrix > second->order_of_matrix) ? -1 : 1;
+    return first->matrix_id - second->matrix_id;
 }
@@ -0,0 +1,57 @@
+/**
+ *  \file container.h (interface file)
+ *
+ *  \brief Problem name: Compute Matrix Determinant.
+ *
+ *  Layout of the matrix container files.
+ *
+ *  A container file is made of a header, an index with an entry for each matrix (offset of its payload, order,
+ *  length of its rows and type of its coefficients) and the payloads. Each payload starts at a multiple of
+ *  CONTAINER_ALIGNMENT bytes and its rows are padded with zeros to a multiple of CONTAINER_ALIGNMENT bytes, so the rows
+ *  are aligned for the vector instructions. The matrices may have different orders and can be read in any order.
+ *  All the fields are little endian.
+ *
+ *  The legacy files (number of matrices, order and the coefficients of the matrices, row by row) are converted to
+ *  containers by the convert program.
+ *
+ *  \author Diogo Filipe Amaral Carvalho - 92969 - April 2022
+ *  \author Rafael Ferreira Baptista - 93367 - April 2022
+ */
+
+#ifndef CONTAINER_H
+#define CONTAINER_H
+
+#include <stdint.h>
+
+/** \brief first bytes of a container file */
+#define  CONTAINER_MAGIC      "DETMATRX"
+
+/** \brief version of the layout of the container files */
+#define  CONTAINER_VERSION    1
+
+/** \brief alignment of the payloads and of their rows, in bytes */
+#define  CONTAINER_ALIGNMENT  64
+
+/** \brief type of the coefficients of a matrix: double precision */
+#define  DTYPE_FLOAT64        1
+
+/** \brief header of a container file (CONTAINER_ALIGNMENT bytes) */
+struct ContainerHeader {
+   char magic[8];                   /* CONTAINER_MAGIC, without the terminating 0 */
+   uint32_t version;                /* CONTAINER_VERSION */
+   uint32_t number_of_matrices;     /* number of matrices (and of entries of the index) */
+   uint64_t index_offset;           /* offset of the index from the start of the file */
+   uint8_t reserved[40];            /* set to 0 */
+};
+
+/** \brief entry of the index of a container file */
+struct ContainerEntry {
+   uint64_t offset;                 /* offset of the payload from the start of the file (multiple of CONTAINER_ALIGNMENT) */
+   uint32_t order;                  /* order of the matrix */
+   uint32_t row_length;             /* number of coefficients of a row of the payload, padding included */
+   uint32_t dtype;                  /* type of the coefficients (DTYPE_FLOAT64) */
+   uint32_t reserved;               /* set to 0 */
+};
+
+
+#endif /* CONTAINER_H */
@@ -0,0 +1,141 @@
+/**
+ *  \file convert.c (implementation file)
+ *
+ *  \brief Problem name: Compute Matrix Determinant.
+ *
+ *  Conversion of a legacy matrix file (number of matrices, order and the coefficients of the matrices, row by row)
+ *  to a container file (container.h), which computeDet reads too.
+ *
+ *  How to compile: gcc -Wall -O3 -o convert convert.c
+ *  How to run: ./convert -f mat128_32.bin -o mat128_32.detc
+ *
+ *  \author Diogo Filipe Amaral Carvalho - 92969 - April 2022
+ *  \author Rafael Ferreira Baptista - 93367 - April 2022
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <libgen.h>
+#include <unistd.h>
+
+#include "container.h"
+
+/** \brief function responsible to present the program usage */
+static void printUsage(char *cmdName);
+
+int main(int argc, char *argv[])
+{
+    /* process command line arguments */
+
+    int opt;            /* selected option */
+    char *fName = NULL; /* legacy file name */
+    char *oName = NULL; /* container file name */
+
+    opterr = 0;
+    do
+    {
+        switch ((opt = getopt(argc, argv, "f:o:h")))
+        {
+        case 'f': /* legacy file name */
+            fName = optarg;
+            break;
+        case 'o': /* container file name */
+            oName = optarg;
+            break;
+        case 'h': /* help mode */
+            printUsage(basename(argv[0]));
+            return EXIT_SUCCESS;
+        case '?': /* invalid option */
+            fprintf(stderr, "%s: invalid option\n", basename(argv[0]));
+            printUsage(basename(argv[0]));
+            return EXIT_FAILURE;
+        case -1:
+            break;
+        }
+    } while (opt != -1);
+    if (fName == NULL || oName == NULL)
+    {
+        fprintf(stderr, "%s: invalid format\n", basename(argv[0]));
+        printUsage(basename(argv[0]));
+        return EXIT_FAILURE;
+    }
+
+    /* open the files */
+
+    FILE * input = fopen(fName, "rb");
+    FILE * output = fopen(oName, "wb");
+    if (input == NULL || output == NULL) {
+        fprintf(stderr, "It occoured an error while openning file. \n");
+        exit(EXIT_FAILURE);
+    }
+
+    /* read the legacy header */
+
+    int number_of_matrix, order_of_matrix;
+    if (fread(&number_of_matrix, sizeof(int), 1, input) != 1 || fread(&order_of_matrix, sizeof(int), 1, input) != 1 ||
+        number_of_matrix < 0 || order_of_matrix <= 0) {
+        fprintf(stderr, "%s: invalid header\n", fName);
+        exit(EXIT_FAILURE);
+    }
+
+    /* write the header and the index: the payloads follow the index, each one aligned */
+
+    int row_length = (order_of_matrix * sizeof(double) + CONTAINER_ALIGNMENT - 1) / CONTAINER_ALIGNMENT * CONTAINER_ALIGNMENT / sizeof(double);
+    uint64_t payload_size = (uint64_t) order_of_matrix * row_length * sizeof(double);
+    uint64_t index_size = (uint64_t) number_of_matrix * sizeof(struct ContainerEntry);
+
+    struct ContainerHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CONTAINER_MAGIC, sizeof(header.magic));
+    header.version = CONTAINER_VERSION;
+    header.number_of_matrices = number_of_matrix;
+    header.index_offset = sizeof(header);
+    fwrite(&header, sizeof(header), 1, output);
+
+    uint64_t first_payload = (sizeof(header) + index_size + CONTAINER_ALIGNMENT - 1) / CONTAINER_ALIGNMENT * CONTAINER_ALIGNMENT;
+    for (int m = 0; m < number_of_matrix; m++) {
+        struct ContainerEntry entry = { first_payload + m * payload_size, order_of_matrix, row_length, DTYPE_FLOAT64, 0 };
+        fwrite(&entry, sizeof(entry), 1, output);
+    }
+
+    /* write the payloads, row by row, with the padding set to 0 */
+
+    double * row = calloc(row_length, sizeof(double));
+    static const char zeros[CONTAINER_ALIGNMENT];
+    fwrite(zeros, first_payload - sizeof(header) - index_size, 1, output);
+
+    for (int m = 0; m < number_of_matrix; m++)
+        for (int l = 0; l < order_of_matrix; l++) {
+            if (fread(row, order_of_matrix * sizeof(double), 1, input) != 1) {
+                fprintf(stderr, "%s: the file ended at matrix %d\n", fName, m + 1);
+                exit(EXIT_FAILURE);
+            }
+            fwrite(row, row_length * sizeof(double), 1, output);
+        }
+
+    free(row);
+    fclose(input);
+    if (fclose(output) != 0) {
+        perror("error on writing the container file");
+        exit(EXIT_FAILURE);
+    }
+
+    printf("%d matrices of order %d converted to %s \n", number_of_matrix, order_of_matrix, oName);
+
+    return EXIT_SUCCESS;
+}
+
+
+/**
+ *  \brief print usage.
+ */
+static void printUsage(char *cmdName)
+{
+    fprintf(stderr, "\nSynopsis: %s OPTIONS\n"
+                    "  OPTIONS:\n"
+                    "  -h      --- print this help\n"
+                    "  -f      --- legacy file name\n"
+                    "  -o      --- container file name\n",
+            cmdName);
+}
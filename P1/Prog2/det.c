@@ -0,0 +1,309 @@
+/**
+ *  \file det.c (implementation file)
+ *
+ *  \brief Problem name: Compute Matrix Determinant.
+ *
+ *  In this file the functions of libdet, the library of the determinants shared by all the programs, are implemented.
+ *
+ *  The scalar, blocked and SIMD backends share the same right-looking LU decomposition with partial pivoting: the
+ *  scalar backend takes the whole matrix as a single panel, so it is plain Gaussian elimination; the blocked and SIMD
+ *  backends decompose LU_PANEL columns at a time and update the trailing matrix by the scalar kernel and by the
+ *  kernel of the tuning of the order, respectively (kernels.c). The batched backend is the batched kernel of the tuning.
+ *
+ *  Definition of the operations carried out by the main thread:
+ *     \li det_init.
+ *  Definition of the operations carried out by the worker threads:
+ *     \li det_backend
+ *     \li det_scratch
+ *     \li det_batch
+ *     \li det_batch_r
+ *     \li det_factor
+ *     \li det_multiply_diagonal.
+ *
+ *  \author Diogo Filipe Amaral Carvalho - 92969 - April 2022
+ *  \author Rafael Ferreira Baptista - 93367 - April 2022
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "det.h"
+#include "kernels.h"
+#include "tuning.h"
+#include "probConst.h"
+
+/** \brief names of the backends */
+const char * det_backend_names[NUMBER_OF_BACKENDS] = { "auto", "scalar", "blocked", "SIMD", "batched" };
+
+/**
+ *  \brief Load the tuning profile written by autotune, or fall back to the built-in heuristics if it does not exist.
+ *
+ *  Operation carried out by the main thread, before the workers are created. A profile that can not be read ends the program.
+ *
+ *  \param profile name of the profile (NULL for DEFAULT_PROFILE)
+ *
+ *  \return number of orders of the profile (0 if it does not exist)
+ */
+int det_init (const char * profile)
+{
+  return loadProfile ((profile != NULL) ? profile : DEFAULT_PROFILE);
+}
+
+/**
+ *  \brief Find the backend det_batch uses for a batch of matrices.
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param order_of_matrix order of the matrices
+ *  \param number_of_matrices number of matrices of the batch
+ *  \param opts pointer to the options (NULL for the defaults: DET_AUTO, no exponents)
+ *
+ *  \return backend (enum DetBackend), or -1 if it can not compute the batch
+ */
+int det_backend (int order_of_matrix, int number_of_matrices, const struct DetOptions * opts)
+{
+  int backend = (opts != NULL) ? opts->backend : DET_AUTO;
+
+  if ((order_of_matrix <= 0) || (number_of_matrices < 0) || (backend < DET_AUTO) || (backend >= NUMBER_OF_BACKENDS))
+     return -1;
+  if (backend == DET_AUTO)
+     return ((number_of_matrices > 1) && (order_of_matrix <= BATCH_MAX_ORDER)) ? DET_BATCHED : DET_SIMD;
+  if ((backend == DET_BATCHED) && (order_of_matrix > BATCH_MAX_ORDER))
+     return -1;
+
+  return backend;
+}
+
+/**
+ *  \brief Allocate a scratch buffer for det_batch_r.
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param order_of_matrix order of the matrices
+ *
+ *  \return pointer to the buffer (to be freed by free), or NULL with errno set
+ */
+double * det_scratch (int order_of_matrix)
+{
+  int row_length = (order_of_matrix + ROW_PADDING - 1) / ROW_PADDING * ROW_PADDING;
+  size_t length = (size_t) order_of_matrix * row_length * sizeof (double);
+  double * scratch = aligned_alloc (ROW_PADDING * sizeof (double), length);
+
+  if (scratch == NULL)
+     { errno = ENOMEM;
+       return NULL;
+     }
+  memset (scratch, 0, length);                                   /* the padding is left as 0 by the decompositions */
+
+  return scratch;
+}
+
+/**
+ *  \brief Compute the determinants of a batch of matrices.
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param matrices pointer to the first matrix of the batch (the matrices are stored one after the other, row by row)
+ *  \param order_of_matrix order of the matrices
+ *  \param number_of_matrices number of matrices of the batch
+ *  \param out pointer to store the determinant of each matrix (its mantissa, with opts->exponents)
+ *  \param opts pointer to the options (NULL for the defaults: DET_AUTO, no exponents)
+ *
+ *  \return 0 on success, -1 with errno set (EINVAL for a backend that can not compute the batch, ENOMEM)
+ */
+int det_batch (const double * matrices, int order_of_matrix, int number_of_matrices, double * out,
+               const struct DetOptions * opts)
+{
+  double * scratch = NULL;
+
+  /* the batched kernels need no scratch buffer */
+
+  if (det_backend (order_of_matrix, number_of_matrices, opts) != DET_BATCHED)
+     { scratch = det_scratch ((order_of_matrix > 0) ? order_of_matrix : 1);
+       if (scratch == NULL)
+          return -1;
+     }
+
+  int status = det_batch_r (matrices, order_of_matrix, number_of_matrices, out, opts, scratch);
+  free (scratch);
+
+  return status;
+}
+
+/**
+ *  \brief Compute the determinants of a batch of matrices, in a scratch buffer of the caller.
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param matrices pointer to the first matrix of the batch (the matrices are stored one after the other, row by row)
+ *  \param order_of_matrix order of the matrices
+ *  \param number_of_matrices number of matrices of the batch
+ *  \param out pointer to store the determinant of each matrix (its mantissa, with opts->exponents)
+ *  \param opts pointer to the options (NULL for the defaults: DET_AUTO, no exponents)
+ *  \param scratch pointer to a scratch buffer allocated by det_scratch for the order (unused by the batched backend)
+ *
+ *  \return 0 on success, -1 with errno set (EINVAL for a backend that can not compute the batch)
+ */
+int det_batch_r (const double * matrices, int order_of_matrix, int number_of_matrices, double * out,
+                 const struct DetOptions * opts, double * scratch)
+{
+  int backend = det_backend (order_of_matrix, number_of_matrices, opts);
+  int * exponents = (opts != NULL) ? opts->exponents : NULL;
+  size_t size = (size_t) order_of_matrix * order_of_matrix;
+
+  if ((backend < 0) || ((backend != DET_BATCHED) && (scratch == NULL)))
+     { errno = EINVAL;
+       return -1;
+     }
+
+  /* the batched kernels read the matrices in place and leave the plain products of the pivots */
+
+  if (backend == DET_BATCHED)
+     { determinantBatch (tuningFor (order_of_matrix).batch_kernel, matrices, order_of_matrix, number_of_matrices, out);
+       if (exponents != NULL)
+          for (int m = 0; m < number_of_matrices; m++)
+            out[m] = frexp (out[m], &exponents[m]);
+       return 0;
+     }
+
+  /* the other backends decompose an aligned copy of each matrix, with its rows padded with zeros */
+
+  int row_length = (order_of_matrix + ROW_PADDING - 1) / ROW_PADDING * ROW_PADDING;
+
+  for (int m = 0; m < number_of_matrices; m++)
+  { for (int l = 0; l < order_of_matrix; l++)
+      memcpy (scratch + (size_t) l * row_length, matrices + m * size + (size_t) l * order_of_matrix,
+              order_of_matrix * sizeof (double));
+
+    double determinant = 1;
+    int exponent = 0;
+    det_factor (scratch, order_of_matrix, row_length, backend, NULL, &determinant, &exponent);
+
+    if (exponents != NULL)
+       { out[m] = determinant;
+         exponents[m] = exponent;
+       }
+       else out[m] = ldexp (determinant, exponent);
+  }
+
+  return 0;
+}
+
+/**
+ *  \brief Decompose a matrix in place and multiply a determinant by its determinant.
+ *
+ *  The matrix is decomposed a panel at a time: the panel is decomposed column by column, then the rows of the upper
+ *  triangular matrix to its right are computed and the trailing matrix is updated a tile of columns at a time.
+ *  The determinant is the product of the diagonal, with its sign changed by each row swap.
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param matrix pointer to the matrix (its coefficients are overwritten)
+ *  \param order_of_matrix order of the matrix
+ *  \param row_length number of coefficients of a row of the matrix, padding included
+ *  \param backend DET_SCALAR, DET_BLOCKED or DET_SIMD
+ *  \param pivots pointer to store the pivot row of each column, or NULL: if given, the rows are swapped in full, so
+ *         the matrix is left with the L U factors of the matrix with its rows swapped
+ *  \param determinant pointer to a double to multiply by the determinant of the matrix (its mantissa is left)
+ *  \param exponent pointer to an int to add the binary exponent of the determinant to
+ */
+void det_factor (double * matrix, int order_of_matrix, int row_length, int backend, int * pivots,
+                 double * determinant, int * exponent)
+{
+  double sign = 1.0;
+  struct Tuning tuning = tuningFor (order_of_matrix);
+  int panel_width = (backend == DET_SCALAR) ? order_of_matrix : LU_PANEL;
+  UpdateKernel update = updateKernels[(backend == DET_SIMD) ? tuning.update_kernel : KERNEL_SCALAR];
+
+  for (int panel = 0; panel < order_of_matrix; panel += panel_width) {
+
+      int panel_end = (panel + panel_width < order_of_matrix) ? panel + panel_width : order_of_matrix;
+
+      /* Decompose the panel, column by column */
+      for (int l = panel; l < panel_end; l++) {
+
+          // The pivot is the coefficient of column l, on or below the diagonal, with the largest absolute value
+          int pivot = l;
+          for (int k = l+1; k < order_of_matrix; k++) {
+              if (fabs (matrix[k*row_length + l]) > fabs (matrix[pivot*row_length + l]))
+                 pivot = k;
+          }
+
+          if (matrix[pivot*row_length + l] == 0.0)
+             { *determinant = 0;
+               return;
+             }
+
+          // Swap rows (the columns before the panel are only needed for the factors), which changes the sign of the determinant
+          double * row_l = matrix + l*row_length;
+          if (pivots != NULL)
+             pivots[l] = pivot;
+          if (pivot != l)
+             { double * row_pivot = matrix + pivot*row_length;
+               for (int j = (pivots != NULL) ? 0 : panel; j < order_of_matrix; j++) {
+                   double temp = row_l[j];
+                   row_l[j] = row_pivot[j];
+                   row_pivot[j] = temp;
+               }
+               sign = -sign;
+             }
+
+          // Save the multipliers in column l and update the rest of the panel
+          for (int k = l+1; k < order_of_matrix; k++) {
+              double * row_k = matrix + k*row_length;
+              double term = row_k[l] / row_l[l];
+              row_k[l] = term;
+              for (int j = l+1; j < panel_end; j++)
+                  row_k[j] -= term * row_l[j];
+          }
+      }
+
+      /* Compute the rows of the upper triangular matrix to the right of the panel */
+      for (int l = panel; l < panel_end; l++) {
+          double * row_l = matrix + l*row_length;
+          for (int k = l+1; k < panel_end; k++) {
+              double * row_k = matrix + k*row_length;
+              double term = row_k[l];
+              for (int j = panel_end; j < order_of_matrix; j++)
+                  row_k[j] -= term * row_l[j];
+          }
+      }
+
+      /* Update the trailing matrix, a tile of columns at a time */
+      for (int tile = panel_end; tile < order_of_matrix; tile += tuning.tile) {
+          int tile_end = (tile + tuning.tile < order_of_matrix) ? tile + tuning.tile : order_of_matrix;
+
+          update (matrix, row_length, panel_end, order_of_matrix, panel, panel_end, tile, tile_end);
+      }
+  }
+
+  // Determinant from the upper triangular matrix
+  *determinant = *determinant * sign;
+  det_multiply_diagonal (matrix, order_of_matrix, row_length, determinant, exponent);
+}
+
+/**
+ *  \brief Multiply a determinant by the diagonal of an upper triangular matrix.
+ *
+ *  Its role is to keep the product from overflowing or underflowing at large orders: after each multiplication the
+ *  determinant is scaled back to a mantissa in [0.5, 1[ and the power of 2 taken out of it is added to its exponent.
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param matrix pointer to the upper triangular matrix
+ *  \param order_of_matrix order of the matrix
+ *  \param row_length number of coefficients of a row of the matrix, padding included
+ *  \param determinant pointer to a double to multiply by the diagonal (its mantissa is left)
+ *  \param exponent pointer to an int to add the binary exponent of the product to
+ */
+void det_multiply_diagonal (const double * matrix, int order_of_matrix, int row_length, double * determinant, int * exponent)
+{
+  for (int l = 0; l < order_of_matrix && *determinant != 0; l++) {
+      int scale;
+      *determinant = frexp (*determinant * matrix[l*row_length + l], &scale);
+      *exponent += scale;
+  }
+}
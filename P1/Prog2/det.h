@@ -0,0 +1,172 @@
+/**
+ *  \file det.h (interface file)
+ *
+ *  \brief Problem name: Compute Matrix Determinant.
+ *
+ *  In this file the functions of libdet, the library of the determinants shared by all the programs (P1/Prog2,
+ *  P2/Prog2 and the cpu workers of P3), are defined.
+ *
+ *  det_batch computes the determinants of a batch of matrices of the same order, stored one after the other, by one of
+ *  the backends below, chosen at run time; the kernels of each backend and the tile width are the ones chosen for the
+ *  order of the matrices (tuning.c), among the ones the processor supports, so a faster kernel reaches all the programs.
+ *  det_batch_r does the same in a scratch buffer of the caller (det_scratch), so a worker that computes the determinants
+ *  of many batches allocates it once. det_factor and det_multiply_diagonal are the steps of the dense decomposition,
+ *  for the programs that decompose the matrices in buffers of their own.
+ *
+ *  Definition of the operations carried out by the main thread:
+ *     \li det_init.
+ *  Definition of the operations carried out by the worker threads:
+ *     \li det_backend
+ *     \li det_scratch
+ *     \li det_batch
+ *     \li det_batch_r
+ *     \li det_factor
+ *     \li det_multiply_diagonal.
+ *
+ *  How to build the library: gcc -Wall -O3 -c det.c kernels.c tuning.c && ar rcs libdet.a det.o kernels.o tuning.o
+ *
+ *  \author Diogo Filipe Amaral Carvalho - 92969 - April 2022
+ *  \author Rafael Ferreira Baptista - 93367 - April 2022
+ */
+
+#ifndef DET_H
+#define DET_H
+
+/** \brief backends of the determinants */
+enum DetBackend { DET_AUTO,          /* chosen by det_backend */
+                  DET_SCALAR,        /* Gaussian elimination with partial pivoting, a column at a time */
+                  DET_BLOCKED,       /* blocked LU decomposition, with the scalar kernel of the trailing matrix update */
+                  DET_SIMD,          /* blocked LU decomposition, with the update kernel and the tile width of the tuning */
+                  DET_BATCHED,       /* batched kernel of the tuning, a matrix per lane of a vector (order up to BATCH_MAX_ORDER) */
+                  NUMBER_OF_BACKENDS };
+
+/** \brief names of the backends */
+extern const char * det_backend_names[NUMBER_OF_BACKENDS];
+
+/** \brief struct with the options of det_batch */
+struct DetOptions {
+   int backend;               /* backend (enum DetBackend) */
+   int * exponents;           /* binary exponent of each determinant, out is left with the mantissas (NULL: out holds the determinants) */
+};
+
+/**
+ *  \brief Load the tuning profile written by autotune, or fall back to the built-in heuristics if it does not exist.
+ *
+ *  Operation carried out by the main thread, before the workers are created. A profile that can not be read ends the program.
+ *
+ *  \param profile name of the profile (NULL for DEFAULT_PROFILE)
+ *
+ *  \return number of orders of the profile (0 if it does not exist)
+ */
+extern int det_init (const char * profile);
+
+
+/**
+ *  \brief Find the backend det_batch uses for a batch of matrices.
+ *
+ *  DET_AUTO is the batched backend for batches of more than one matrix up to BATCH_MAX_ORDER, and the SIMD one otherwise.
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param order_of_matrix order of the matrices
+ *  \param number_of_matrices number of matrices of the batch
+ *  \param opts pointer to the options (NULL for the defaults: DET_AUTO, no exponents)
+ *
+ *  \return backend (enum DetBackend), or -1 if it can not compute the batch
+ */
+extern int det_backend (int order_of_matrix, int number_of_matrices, const struct DetOptions * opts);
+
+
+/**
+ *  \brief Allocate a scratch buffer for det_batch_r: the rows of a matrix of the order, aligned and padded with zeros.
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param order_of_matrix order of the matrices
+ *
+ *  \return pointer to the buffer (to be freed by free), or NULL with errno set
+ */
+extern double * det_scratch (int order_of_matrix);
+
+
+/**
+ *  \brief Compute the determinants of a batch of matrices.
+ *
+ *  The matrices are not modified: the decompositions are done in an aligned and padded copy of each matrix.
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param matrices pointer to the first matrix of the batch (the matrices are stored one after the other, row by row)
+ *  \param order_of_matrix order of the matrices
+ *  \param number_of_matrices number of matrices of the batch
+ *  \param out pointer to store the determinant of each matrix (its mantissa, with opts->exponents)
+ *  \param opts pointer to the options (NULL for the defaults: DET_AUTO, no exponents)
+ *
+ *  \return 0 on success, -1 with errno set (EINVAL for a backend that can not compute the batch, ENOMEM)
+ */
+extern int det_batch (const double * matrices, int order_of_matrix, int number_of_matrices, double * out,
+                      const struct DetOptions * opts);
+
+
+/**
+ *  \brief Compute the determinants of a batch of matrices, in a scratch buffer of the caller.
+ *
+ *  Like det_batch, but nothing is allocated: each matrix is copied to the scratch buffer and decomposed there.
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param matrices pointer to the first matrix of the batch (the matrices are stored one after the other, row by row)
+ *  \param order_of_matrix order of the matrices
+ *  \param number_of_matrices number of matrices of the batch
+ *  \param out pointer to store the determinant of each matrix (its mantissa, with opts->exponents)
+ *  \param opts pointer to the options (NULL for the defaults: DET_AUTO, no exponents)
+ *  \param scratch pointer to a scratch buffer allocated by det_scratch for the order (unused by the batched backend)
+ *
+ *  \return 0 on success, -1 with errno set (EINVAL for a backend that can not compute the batch, or no scratch buffer)
+ */
+extern int det_batch_r (const double * matrices, int order_of_matrix, int number_of_matrices, double * out,
+                        const struct DetOptions * opts, double * scratch);
+
+
+/**
+ *  \brief Decompose a matrix in place and multiply a determinant by its determinant.
+ *
+ *  Right-looking LU decomposition with partial pivoting: by the scalar backend, a column at a time; by the blocked
+ *  and SIMD backends, LU_PANEL columns at a time, the trailing matrix updated a tile of columns at a time. The rows
+ *  of the matrix must be aligned and padded to ROW_PADDING coefficients, since the update kernels work up to the
+ *  padded end of a tile.
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param matrix pointer to the matrix (its coefficients are overwritten)
+ *  \param order_of_matrix order of the matrix
+ *  \param row_length number of coefficients of a row of the matrix, padding included
+ *  \param backend DET_SCALAR, DET_BLOCKED or DET_SIMD
+ *  \param pivots pointer to store the pivot row of each column, or NULL: if given, the rows are swapped in full, so
+ *         the matrix is left with the L U factors of the matrix with its rows swapped
+ *  \param determinant pointer to a double to multiply by the determinant of the matrix (its mantissa is left)
+ *  \param exponent pointer to an int to add the binary exponent of the determinant to
+ */
+extern void det_factor (double * matrix, int order_of_matrix, int row_length, int backend, int * pivots,
+                        double * determinant, int * exponent);
+
+
+/**
+ *  \brief Multiply a determinant by the diagonal of an upper triangular matrix.
+ *
+ *  After each multiplication the determinant is scaled back to a mantissa in [0.5, 1[ and the power of 2 taken out of
+ *  it is added to its exponent, so it does not overflow or underflow at large orders. The scaling is exact, so
+ *  ldexp(determinant, exponent) is the product of the diagonal whenever it fits in a double.
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param matrix pointer to the upper triangular matrix
+ *  \param order_of_matrix order of the matrix
+ *  \param row_length number of coefficients of a row of the matrix, padding included
+ *  \param determinant pointer to a double to multiply by the diagonal (its mantissa is left)
+ *  \param exponent pointer to an int to add the binary exponent of the product to
+ */
+extern void det_multiply_diagonal (const double * matrix, int order_of_matrix, int row_length, double * determinant, int * exponent);
+
+
+#endif /* DET_H */
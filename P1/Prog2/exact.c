@@ -0,0 +1,376 @@
+/**
+ *  \file exact.c (implementation file)
+ *
+ *  \brief Problem name: Compute Matrix Determinant.
+ *
+ *  In this file the functions to compute the exact determinant of a matrix of integers are implemented.
+ *
+ *  The determinant is computed modulo several primes of 62 bits, each one independently of the others, and the
+ *  residues are combined by the Chinese remainder theorem. The number of primes is given by the Hadamard bound of the
+ *  matrix, |det| <= product of the norms of its rows, so their product is larger than twice the absolute value of the
+ *  determinant and the determinant is the residue of the combination closest to 0.
+ *
+ *  The elimination modulo a prime keeps the coefficients in Montgomery form, so a modular multiplication takes two
+ *  128-bit products instead of a 128-bit division. The combination (Garner's algorithm) gives the mixed radix digits
+ *  of the determinant, from which it is built as an integer of 64-bit limbs and written in decimal.
+ *
+ *  Definition of the operations carried out by the main thread:
+ *     \li primesNeeded
+ *     \li primesForOrder
+ *     \li initPrimes
+ *     \li combineResidues.
+ *  Definition of the operations carried out by the worker threads:
+ *     \li determinantModulo.
+ *
+ *  \author Diogo Filipe Amaral Carvalho - 92969 - April 2022
+ *  \author Rafael Ferreira Baptista - 93367 - April 2022
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#include "exact.h"
+
+/** \brief bits of the determinant each prime accounts for (every prime is larger than 2^61) */
+#define  BITS_PER_PRIME  61
+
+/** \brief struct with a prime and the constants of the Montgomery multiplication modulo it */
+struct Modulus {
+   uint64_t p;                      /* prime */
+   uint64_t inverse;                /* -p^-1 modulo 2^64 */
+   uint64_t r2;                     /* 2^128 modulo p */
+};
+
+/** \brief primes, the largest ones below 2^62 */
+static struct Modulus * primes;
+
+/**
+ *  \brief Multiply two integers modulo another one (128-bit product).
+ */
+static inline uint64_t mulMod (uint64_t a, uint64_t b, uint64_t p)
+{
+  return (unsigned __int128) a * b % p;
+}
+
+/**
+ *  \brief Raise an integer to a power modulo another one.
+ */
+static uint64_t powMod (uint64_t a, uint64_t e, uint64_t p)
+{
+  uint64_t r = 1;
+
+  for (a %= p; e > 0; e >>= 1, a = mulMod (a, a, p))
+    if (e & 1)
+       r = mulMod (r, a, p);
+  return r;
+}
+
+/**
+ *  \brief Inverse of an integer modulo a prime (extended Euclid's algorithm).
+ */
+static uint64_t inverseMod (uint64_t a, uint64_t p)
+{
+  int64_t t = 0, new_t = 1;
+  int64_t r = p, new_r = a;
+
+  while (new_r != 0)
+  { int64_t q = r / new_r, temp;
+    temp = t - q * new_t; t = new_t; new_t = temp;
+    temp = r - q * new_r; r = new_r; new_r = temp;
+  }
+  return (t < 0) ? t + (int64_t) p : t;
+}
+
+/**
+ *  \brief Miller-Rabin test, deterministic for 64-bit integers with the first 12 primes as bases.
+ */
+static bool isPrime (uint64_t n)
+{
+  static const uint64_t bases[] = {2, 3, 5, 7, 11, 13, 17, 19, 23, 29, 31, 37};
+  uint64_t d = n - 1;
+  int s = 0;
+
+  for (int i = 0; i < 12; i++)
+    if (n % bases[i] == 0)
+       return n == bases[i];
+  while ((d & 1) == 0)
+  { d >>= 1;
+    s += 1;
+  }
+
+  for (int i = 0; i < 12; i++)
+  { uint64_t x = powMod (bases[i], d, n);
+    if (x == 1 || x == n - 1)
+       continue;
+    for (int j = 1; j < s && x != n - 1; j++)
+      x = mulMod (x, x, n);
+    if (x != n - 1)
+       return false;
+  }
+  return true;
+}
+
+/**
+ *  \brief Montgomery reduction: t 2^-64 modulo the prime, for t < p 2^64.
+ */
+static inline uint64_t reduce (unsigned __int128 t, const struct Modulus * m)
+{
+  uint64_t q = (uint64_t) t * m->inverse;
+  uint64_t u = (t + (unsigned __int128) q * m->p) >> 64;
+
+  return (u >= m->p) ? u - m->p : u;
+}
+
+/**
+ *  \brief Montgomery multiplication: a b 2^-64 modulo the prime.
+ */
+static inline uint64_t montMul (uint64_t a, uint64_t b, const struct Modulus * m)
+{
+  return reduce ((unsigned __int128) a * b, m);
+}
+
+/**
+ *  \brief Find the number of primes needed for the exact determinant of a matrix (Hadamard bound).
+ *
+ *  \param matrix pointer to the matrix
+ *  \param order_of_matrix order of the matrix
+ *  \param row_length number of coefficients of a row of the matrix, padding included
+ *
+ *  \return number of primes, or -1 if a coefficient is not an integer of less than 63 bits
+ */
+int primesNeeded (const double * matrix, int order_of_matrix, int row_length)
+{
+  double log2_bound = 0;                                            /* log2 of the Hadamard bound of the determinant */
+
+  for (int i = 0; i < order_of_matrix; i++)
+  { const double * row = matrix + (size_t) i * row_length;
+    double norm = 0;
+    for (int j = 0; j < order_of_matrix; j++)
+    { if (row[j] != trunc (row[j]) || fabs (row[j]) >= 0x1p62)
+         return -1;
+      norm += row[j] * row[j];
+    }
+    if (norm == 0)
+       return 1;                                                         /* a row of zeros: the determinant is 0 */
+    log2_bound += 0.5 * log2 (norm);
+  }
+
+  /* the product of the primes must be larger than twice the bound (with a bit to spare for the rounding) */
+  return (int) ceil ((log2_bound + 2) / BITS_PER_PRIME);
+}
+
+/**
+ *  \brief Find the largest number of primes a matrix of integers of less than 63 bits of a given order may need.
+ *
+ *  Each row has a norm below sqrt(n) 2^62, so the Hadamard bound is below 2^(n (62 + log2(n) / 2)).
+ *
+ *  \param order_of_matrix order of the matrix
+ *
+ *  \return number of primes
+ */
+int primesForOrder (int order_of_matrix)
+{
+  double log2_bound = order_of_matrix * (62 + 0.5 * log2 (order_of_matrix));
+
+  return (int) ceil ((log2_bound + 2) / BITS_PER_PRIME);
+}
+
+/**
+ *  \brief Find the primes, the largest ones below 2^62.
+ *
+ *  Operation carried out by the main thread, before the workers are created.
+ *
+ *  \param number_of_primes number of primes
+ */
+void initPrimes (int number_of_primes)
+{
+  uint64_t n = (UINT64_C (1) << 62) - 1;
+
+  primes = malloc ((number_of_primes + 1) * sizeof (struct Modulus));
+  for (int i = 0; i < number_of_primes; i++, n -= 2)
+  { while (!isPrime (n))
+      n -= 2;
+
+    uint64_t inverse = n;                             /* Newton's iteration: n^-1 modulo 2^64, 6 bits at the start */
+    for (int k = 0; k < 5; k++)
+      inverse *= 2 - n * inverse;
+
+    primes[i].p = n;
+    primes[i].inverse = -inverse;
+    primes[i].r2 = mulMod ((-n) % n, (-n) % n, n);                                    /* (2^64 mod n)^2 mod n */
+  }
+}
+
+/**
+ *  \brief Compute the determinant of a matrix of integers modulo one of the primes.
+ *
+ *  The matrix is reduced modulo the prime, in Montgomery form, and eliminated by Gauss's method: any nonzero pivot
+ *  will do, as the arithmetic is exact.
+ *
+ *  \param matrix pointer to the matrix (read only)
+ *  \param order_of_matrix order of the matrix
+ *  \param row_length number of coefficients of a row of the matrix, padding included
+ *  \param prime index of the prime
+ *  \param scratch pointer to a buffer of order_of_matrix x order_of_matrix integers
+ *
+ *  \return determinant modulo the prime
+ */
+uint64_t determinantModulo (const double * matrix, int order_of_matrix, int row_length, int prime, uint64_t * scratch)
+{
+  const struct Modulus * m = &primes[prime];
+  uint64_t p = m->p;
+  int n = order_of_matrix;
+
+  for (int i = 0; i < n; i++)                                       /* reduce the coefficients, in Montgomery form */
+    for (int j = 0; j < n; j++)
+    { int64_t a = (int64_t) matrix[(size_t) i * row_length + j];
+      uint64_t r = (a < 0) ? (p - (uint64_t) (-a) % p) % p : (uint64_t) a % p;
+      scratch[(size_t) i * n + j] = montMul (r, m->r2, m);
+    }
+
+  uint64_t determinant = montMul (1, m->r2, m);                                     /* 1, in Montgomery form */
+
+  for (int l = 0; l < n; l++)
+  { uint64_t * row_l = scratch + (size_t) l * n;
+
+    int pivot = l;
+    while (pivot < n && scratch[(size_t) pivot * n + l] == 0)
+      pivot += 1;
+    if (pivot == n)
+       return 0;
+
+    if (pivot != l)                                                  /* swap rows, which changes the sign */
+    { uint64_t * row_pivot = scratch + (size_t) pivot * n;
+      for (int j = l; j < n; j++)
+      { uint64_t temp = row_l[j];
+        row_l[j] = row_pivot[j];
+        row_pivot[j] = temp;
+      }
+      determinant = p - determinant;
+    }
+    determinant = montMul (determinant, row_l[l], m);
+
+    /* inverse of the pivot, in Montgomery form: (a R)^-1 R^2 R^2 R^-2 = a^-1 R */
+    uint64_t inverse = montMul (montMul (inverseMod (row_l[l], p), m->r2, m), m->r2, m);
+
+    for (int k = l + 1; k < n; k++)
+    { uint64_t * row_k = scratch + (size_t) k * n;
+      if (row_k[l] == 0)
+         continue;
+      uint64_t term = p - montMul (row_k[l], inverse, m);
+      for (int j = l + 1; j < n; j++)
+      { uint64_t r = row_k[j] + montMul (term, row_l[j], m);
+        row_k[j] = (r >= p) ? r - p : r;
+      }
+    }
+  }
+
+  return reduce (determinant, m);
+}
+
+/**
+ *  \brief Combine the residues of a determinant modulo the first primes (Chinese remainder theorem).
+ *
+ *  \param residues determinant modulo each prime
+ *  \param number_of_primes number of primes
+ *
+ *  \return determinant, in decimal (allocated with malloc)
+ */
+char * combineResidues (const uint64_t * residues, int number_of_primes)
+{
+  int k = number_of_primes;
+  uint64_t * digits = malloc (k * sizeof (uint64_t));                                       /* mixed radix digits */
+
+  /* Garner's algorithm: x = d0 + d1 p0 + d2 p0 p1 + ... */
+  for (int i = 0; i < k; i++)
+  { uint64_t p = primes[i].p;
+    uint64_t value = 0, product = 1;                              /* digits so far and p0 ... p(i-1), modulo p */
+    for (int j = i - 1; j >= 0; j--)
+      value = (mulMod (value, primes[j].p, p) + digits[j]) % p;
+    for (int j = 0; j < i; j++)
+      product = mulMod (product, primes[j].p, p);
+    digits[i] = mulMod ((residues[i] + p - value) % p, inverseMod (product, p), p);
+  }
+
+  /* x and the product of the primes, as integers of 64-bit limbs (least significant first) */
+  uint64_t * x = calloc (k + 1, sizeof (uint64_t));
+  uint64_t * modulus = calloc (k + 1, sizeof (uint64_t));
+  int length = 0, modulus_length = 1;
+  modulus[0] = 1;
+
+  for (int i = k - 1; i >= 0; i--)                                                    /* x = x p(i) + d(i) */
+  { unsigned __int128 carry = digits[i];
+    for (int j = 0; j < length; j++)
+    { carry += (unsigned __int128) x[j] * primes[i].p;
+      x[j] = (uint64_t) carry;
+      carry >>= 64;
+    }
+    if (carry != 0)
+       x[length++] = (uint64_t) carry;
+  }
+  for (int i = 0; i < k; i++)                                                      /* modulus = modulus p(i) */
+  { unsigned __int128 carry = 0;
+    for (int j = 0; j < modulus_length; j++)
+    { carry += (unsigned __int128) modulus[j] * primes[i].p;
+      modulus[j] = (uint64_t) carry;
+      carry >>= 64;
+    }
+    if (carry != 0)
+       modulus[modulus_length++] = (uint64_t) carry;
+  }
+
+  /* the determinant is x, or x - modulus if modulus - x is smaller (negative determinant) */
+  uint64_t * complement = calloc (k + 1, sizeof (uint64_t));
+  uint64_t borrow = 0;
+  for (int j = 0; j < modulus_length; j++)
+  { uint64_t a = modulus[j], b = (j < length) ? x[j] : 0;
+    complement[j] = a - b - borrow;
+    borrow = (a < b) || (a == b && borrow);
+  }
+  int complement_length = modulus_length;
+  while (complement_length > 0 && complement[complement_length - 1] == 0)
+    complement_length -= 1;
+
+  bool negative = (complement_length < length);
+  for (int j = length - 1; j >= 0 && complement_length == length; j--)
+    if (complement[j] != x[j])
+    { negative = (complement[j] < x[j]);
+      break;
+    }
+  if (negative)
+  { memcpy (x, complement, complement_length * sizeof (uint64_t));
+    length = complement_length;
+  }
+
+  /* decimal: groups of 18 digits, from the remainders of the divisions by 10^18 */
+  char * text = malloc (20 * (length + 1) + 2);
+  uint64_t * groups = malloc ((2 * length + 1) * sizeof (uint64_t));
+  int number_of_groups = 0;
+  while (length > 0)
+  { unsigned __int128 remainder = 0;
+    for (int j = length - 1; j >= 0; j--)
+    { remainder = (remainder << 64) | x[j];
+      x[j] = (uint64_t) (remainder / UINT64_C (1000000000000000000));
+      remainder %= UINT64_C (1000000000000000000);
+    }
+    groups[number_of_groups++] = (uint64_t) remainder;
+    while (length > 0 && x[length - 1] == 0)
+      length -= 1;
+  }
+
+  int size = sprintf (text, "%s%llu", negative ? "-" : "", (unsigned long long) ((number_of_groups > 0) ? groups[number_of_groups - 1] : 0));
+  for (int g = number_of_groups - 2; g >= 0; g--)
+    size += sprintf (text + size, "%018llu", (unsigned long long) groups[g]);
+
+  free (digits);
+  free (x);
+  free (modulus);
+  free (complement);
+  free (groups);
+
+  return text;
+}
@@ -0,0 +1,86 @@
+/**
+ *  \file exact.h (interface file)
+ *
+ *  \brief Problem name: Compute Matrix Determinant.
+ *
+ *  In this file the functions to compute the exact determinant of a matrix of integers are defined.
+ *
+ *  The determinant is computed modulo several primes of 62 bits, each one independently of the others, and the
+ *  residues are combined by the Chinese remainder theorem. The number of primes is given by the Hadamard bound of the
+ *  matrix, so their product is larger than twice the absolute value of the determinant.
+ *
+ *  Definition of the operations carried out by the main thread:
+ *     \li primesNeeded
+ *     \li primesForOrder
+ *     \li initPrimes
+ *     \li combineResidues.
+ *  Definition of the operations carried out by the worker threads:
+ *     \li determinantModulo.
+ *
+ *  \author Diogo Filipe Amaral Carvalho - 92969 - April 2022
+ *  \author Rafael Ferreira Baptista - 93367 - April 2022
+ */
+
+#ifndef EXACT_H
+#define EXACT_H
+
+#include <stdint.h>
+
+/**
+ *  \brief Find the number of primes needed for the exact determinant of a matrix (Hadamard bound).
+ *
+ *  \param matrix pointer to the matrix
+ *  \param order_of_matrix order of the matrix
+ *  \param row_length number of coefficients of a row of the matrix, padding included
+ *
+ *  \return number of primes, or -1 if a coefficient is not an integer of less than 63 bits
+ */
+extern int primesNeeded (const double * matrix, int order_of_matrix, int row_length);
+
+
+/**
+ *  \brief Find the largest number of primes a matrix of integers of less than 63 bits of a given order may need.
+ *
+ *  \param order_of_matrix order of the matrix
+ *
+ *  \return number of primes
+ */
+extern int primesForOrder (int order_of_matrix);
+
+
+/**
+ *  \brief Find the primes, the largest ones below 2^62.
+ *
+ *  Operation carried out by the main thread, before the workers are created.
+ *
+ *  \param number_of_primes number of primes
+ */
+extern void initPrimes (int number_of_primes);
+
+
+/**
+ *  \brief Compute the determinant of a matrix of integers modulo one of the primes.
+ *
+ *  \param matrix pointer to the matrix (read only)
+ *  \param order_of_matrix order of the matrix
+ *  \param row_length number of coefficients of a row of the matrix, padding included
+ *  \param prime index of the prime
+ *  \param scratch pointer to a buffer of order_of_matrix x order_of_matrix integers
+ *
+ *  \return determinant modulo the prime
+ */
+extern uint64_t determinantModulo (const double * matrix, int order_of_matrix, int row_length, int prime, uint64_t * scratch);
+
+
+/**
+ *  \brief Combine the residues of a determinant modulo the first primes (Chinese remainder theorem).
+ *
+ *  \param residues determinant modulo each prime
+ *  \param number_of_primes number of primes
+ *
+ *  \return determinant, in decimal (allocated with malloc)
+ */
+extern char * combineResidues (const uint64_t * residues, int number_of_primes);
+
+
+#endif /* EXACT_H */
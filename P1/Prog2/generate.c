@@ -0,0 +1,236 @@
+/**
+ *  \file generate.c (implementation file)
+ *
+ *  \brief Problem name: Compute Matrix Determinant.
+ *
+ *  Generation of a legacy matrix file (number of matrices, order and the coefficients of the matrices, row by row)
+ *  whose determinants are known, to check the determinants computed by computeDet (option -c).
+ *
+ *  Each matrix is the product P L U H of a random permutation P, a random unit lower triangular matrix L, a random
+ *  upper triangular matrix U and a random Householder reflection H, so its determinant is minus the sign of the
+ *  permutation times the product of the diagonal of U. The absolute values of the diagonal of U are spread over the
+ *  number of decades given by the conditioning, around 1, which sets the condition number of the matrix.
+ *  The determinants are written to the answers file as "id sign log10|det|" lines, like the log mode of computeDet.
+ *
+ *  How to compile: gcc -Wall -O3 -o generate generate.c -lm
+ *  How to run: ./generate -n 128 -m 32 -c 4 -f mat128_32.bin -a mat128_32.txt
+ *
+ *  \author Diogo Filipe Amaral Carvalho - 92969 - April 2022
+ *  \author Rafael Ferreira Baptista - 93367 - April 2022
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <libgen.h>
+#include <unistd.h>
+
+/** \brief function responsible to present the program usage */
+static void printUsage(char *cmdName);
+
+/** \brief function to generate a matrix with a known determinant */
+static void generateMatrix(double * matrix, double * lower, double * upper, int * rows, int order_of_matrix,
+                           double conditioning, int * sign, double * log_determinant);
+
+int main(int argc, char *argv[])
+{
+    /* process command line arguments */
+
+    int opt;                    /* selected option */
+    char *fName = NULL;         /* matrix file name */
+    char *aName = NULL;         /* answers file name */
+    int number_of_matrix = 1;   /* number of matrices */
+    int order_of_matrix = 0;    /* order of the matrices */
+    double conditioning = 0;    /* decades spanned by the absolute values of the diagonal of U */
+    long seed = 1;              /* seed of the random numbers */
+
+    opterr = 0;
+    do
+    {
+        switch ((opt = getopt(argc, argv, "f:a:n:m:c:s:h")))
+        {
+        case 'f': /* matrix file name */
+            fName = optarg;
+            break;
+        case 'a': /* answers file name */
+            aName = optarg;
+            break;
+        case 'n': /* number of matrices */
+            number_of_matrix = atoi(optarg);
+            break;
+        case 'm': /* order of the matrices */
+            order_of_matrix = atoi(optarg);
+            break;
+        case 'c': /* conditioning */
+            conditioning = atof(optarg);
+            break;
+        case 's': /* seed */
+            seed = atol(optarg);
+            break;
+        case 'h': /* help mode */
+            printUsage(basename(argv[0]));
+            return EXIT_SUCCESS;
+        case '?': /* invalid option */
+            fprintf(stderr, "%s: invalid option\n", basename(argv[0]));
+            printUsage(basename(argv[0]));
+            return EXIT_FAILURE;
+        case -1:
+            break;
+        }
+    } while (opt != -1);
+    if (fName == NULL || aName == NULL || number_of_matrix < 0 || order_of_matrix <= 0 || conditioning < 0)
+    {
+        fprintf(stderr, "%s: invalid format\n", basename(argv[0]));
+        printUsage(basename(argv[0]));
+        return EXIT_FAILURE;
+    }
+
+    /* open the files */
+
+    FILE * output = fopen(fName, "wb");
+    FILE * answers = fopen(aName, "w");
+    if (output == NULL || answers == NULL) {
+        fprintf(stderr, "It occoured an error while openning file. \n");
+        exit(EXIT_FAILURE);
+    }
+
+    /* generate the matrices, one at a time */
+
+    size_t size = (size_t) order_of_matrix * order_of_matrix;
+    double * matrix = malloc(size * sizeof(double));
+    double * lower = malloc(size * sizeof(double));
+    double * upper = malloc(size * sizeof(double));
+    int * rows = malloc(order_of_matrix * sizeof(int));
+
+    srand48(seed);
+    fwrite(&number_of_matrix, sizeof(int), 1, output);
+    fwrite(&order_of_matrix, sizeof(int), 1, output);
+
+    for (int m = 0; m < number_of_matrix; m++) {
+        int sign;
+        double log_determinant;
+
+        generateMatrix(matrix, lower, upper, rows, order_of_matrix, conditioning, &sign, &log_determinant);
+        fwrite(matrix, size * sizeof(double), 1, output);
+        fprintf(answers, "%d %d %.17e\n", m + 1, sign, log_determinant);
+    }
+
+    free(matrix);
+    free(lower);
+    free(upper);
+    free(rows);
+    if (fclose(output) != 0 || fclose(answers) != 0) {
+        perror("error on writing the files");
+        exit(EXIT_FAILURE);
+    }
+
+    printf("%d matrices of order %d generated to %s, determinants written to %s \n", number_of_matrix, order_of_matrix, fName, aName);
+
+    return EXIT_SUCCESS;
+}
+
+
+/**
+ *  \brief print usage.
+ */
+static void printUsage(char *cmdName)
+{
+    fprintf(stderr, "\nSynopsis: %s OPTIONS\n"
+                    "  OPTIONS:\n"
+                    "  -h      --- print this help\n"
+                    "  -f      --- matrix file name\n"
+                    "  -a      --- answers file name (\"id sign log10|det|\" lines)\n"
+                    "  -n      --- number of matrices (1 by default)\n"
+                    "  -m      --- order of the matrices\n"
+                    "  -c      --- conditioning: decades spanned by the diagonal of U (0 by default)\n"
+                    "  -s      --- seed of the random numbers (1 by default)\n",
+            cmdName);
+}
+
+
+/**
+ *  \brief Function to generate a matrix with a known determinant.
+ *
+ *  Its role is to build the matrix P L U H, row by row. The coefficients of L below the diagonal are uniform in
+ *  [-1/n, 1/n[ and the ones of U above the diagonal are uniform in [-1/n, 1/n[ times the diagonal coefficient of their
+ *  row, so L and U are well conditioned apart from the diagonal of U: it has random signs and absolute values from
+ *  10^(conditioning/2) down to 10^(-conditioning/2), each one multiplied by a random factor in [1, 2[. The rows are
+ *  shuffled by P and H is a random Householder reflection (determinant -1), which mixes the columns, so the matrix
+ *  is dense and its decomposition has to find the pivots.
+ *
+ *  \param matrix pointer to store the matrix
+ *  \param lower pointer to a buffer for L
+ *  \param upper pointer to a buffer for U
+ *  \param rows pointer to a buffer for P (row of L U stored in each row of the matrix)
+ *  \param order_of_matrix order of the matrix
+ *  \param conditioning decades spanned by the absolute values of the diagonal of U
+ *  \param sign pointer to an int to store the sign of the determinant
+ *  \param log_determinant pointer to a double to store log10 of the absolute value of the determinant
+ */
+static void generateMatrix(double * matrix, double * lower, double * upper, int * rows, int order_of_matrix,
+                           double conditioning, int * sign, double * log_determinant) {
+
+    int n = order_of_matrix;
+
+    *sign = -1;     // determinant of H
+    *log_determinant = 0;
+
+    for (int i = 0; i < n; i++) {
+        double decades = (n > 1) ? conditioning * (0.5 - (double) i / (n - 1)) : 0;
+        double pivot = pow(10, decades) * (1 + drand48());
+        if (drand48() < 0.5) {
+            pivot = -pivot;
+            *sign = -*sign;
+        }
+        *log_determinant += log10(fabs(pivot));
+
+        for (int j = 0; j < n; j++) {
+            lower[i*n + j] = (j < i) ? (2 * drand48() - 1) / n : (j == i);
+            upper[i*n + j] = (j > i) ? (2 * drand48() - 1) / n * pivot : (j == i) * pivot;
+        }
+    }
+
+    // Random permutation, each swap changes the sign of the determinant
+    for (int i = 0; i < n; i++)
+        rows[i] = i;
+    for (int i = n - 1; i > 0; i--) {
+        int j = lrand48() % (i + 1);
+        if (j != i) {
+            int temp = rows[i];
+            rows[i] = rows[j];
+            rows[j] = temp;
+            *sign = -*sign;
+        }
+    }
+
+    // Row rows[i] of L U is the row i of the matrix
+    for (int i = 0; i < n; i++) {
+        double * row = matrix + (size_t) i * n;
+        double * row_lower = lower + (size_t) rows[i] * n;
+        for (int j = 0; j < n; j++)
+            row[j] = 0;
+        for (int k = 0; k <= rows[i]; k++) {
+            double term = row_lower[k];
+            double * row_upper = upper + (size_t) k * n;
+            for (int j = k; j < n; j++)
+                row[j] += term * row_upper[j];
+        }
+    }
+
+    // Reflection H = I - 2 v v^T / (v^T v), applied to each row: row -= 2 (row . v) / (v . v) v (v is kept in the buffer of L)
+    double * v = lower;
+    double norm = 0;
+    for (int j = 0; j < n; j++) {
+        v[j] = 2 * drand48() - 1;
+        norm += v[j] * v[j];
+    }
+    for (int i = 0; i < n; i++) {
+        double * row = matrix + (size_t) i * n;
+        double dot = 0;
+        for (int j = 0; j < n; j++)
+            dot += row[j] * v[j];
+        dot = 2 * dot / norm;
+        for (int j = 0; j < n; j++)
+            row[j] -= dot * v[j];
+    }
+}
@@ -0,0 +1,235 @@
+/**
+ *  \file incremental.c (implementation file)
+ *
+ *  \brief Problem name: Compute Matrix Determinant.
+ *
+ *  In this file the functions to compute the determinant of a matrix from the LU decomposition of another one that
+ *  differs from it in a few rows or columns are implemented.
+ *
+ *  If the matrices differ in the rows r_1..r_k, U = [e_r1 .. e_rk] and V^T holds the differences of the rows, so
+ *  V^T A^-1 U is made of the rows of differences times the solutions of A x = e_ri; if they differ in the columns
+ *  c_1..c_k, U holds the differences of the columns and V = [e_c1 .. e_ck], so V^T A^-1 U is made of the rows c_1..c_k
+ *  of the solutions of A x = u_j. The k right-hand sides are solved together, a row of the factors at a time, and the
+ *  determinant of the k x k matrix I + V^T A^-1 U is found by Gaussian elimination with partial pivoting.
+ *
+ *  Definition of the operations carried out by the worker threads:
+ *     \li lowRankDifference
+ *     \li updateDeterminant.
+ *
+ *  \author Diogo Filipe Amaral Carvalho - 92969 - April 2022
+ *  \author Rafael Ferreira Baptista - 93367 - April 2022
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#include "incremental.h"
+#include "probConst.h"
+
+/**
+ *  \brief Find the rows, or else the columns, in which a matrix differs from another one.
+ *
+ *  The rows are compared first, a row at a time, and the columns only if there are too many rows.
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param base pointer to the other matrix
+ *  \param matrix pointer to the matrix
+ *  \param order_of_matrix order of the matrices
+ *  \param row_length number of coefficients of a row of the matrices, padding included
+ *  \param max_rank largest number of rows or columns to look for
+ *  \param indices pointer to store the rows or columns (max_rank of them at most)
+ *  \param columns pointer to a bool to store whether the indices are of columns (otherwise they are of rows)
+ *
+ *  \return number of rows or columns, or -1 if the matrices differ in more than max_rank rows and columns
+ */
+int lowRankDifference(const double * base, const double * matrix, int order_of_matrix, int row_length,
+                      int max_rank, int * indices, bool * columns) {
+
+    int rank = 0;
+
+    *columns = false;
+    for (int i = 0; i < order_of_matrix; i++)
+        if (memcmp(base + (size_t) i * row_length, matrix + (size_t) i * row_length, order_of_matrix * sizeof(double)) != 0) {
+            if (rank == max_rank) {
+                rank = -1;
+                break;
+            }
+            indices[rank++] = i;
+        }
+    if (rank >= 0)
+        return rank;
+
+    // Columns, marked as they are found in each row
+    bool * changed = calloc(order_of_matrix, sizeof(bool));
+
+    *columns = true;
+    rank = 0;
+    for (int i = 0; i < order_of_matrix && rank >= 0; i++) {
+        const double * base_row = base + (size_t) i * row_length;
+        const double * row = matrix + (size_t) i * row_length;
+        for (int j = 0; j < order_of_matrix; j++)
+            if (row[j] != base_row[j] && !changed[j]) {
+                if (rank == max_rank) {
+                    rank = -1;
+                    break;
+                }
+                changed[j] = true;
+                indices[rank++] = j;
+            }
+    }
+
+    free(changed);
+
+    return rank;
+}
+
+
+/**
+ *  \brief Multiply a determinant by the ratio of the determinants of a matrix and another one, from the L U factors of the other.
+ *
+ *  The update is unstable, and the determinant is left as it was, when the other matrix is ill conditioned (the ratio
+ *  of its smallest to its largest pivot is below INCREMENTAL_MIN_RATIO) or when I + V^T A^-1 U is nearly singular (the
+ *  ratio of its determinant to the product of the norms of its columns is below INCREMENTAL_MIN_RATIO).
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param factors pointer to the L U factors of the other matrix, with partial pivoting (the multipliers below the diagonal)
+ *  \param pivots pivot row of each column of the factors
+ *  \param order_of_matrix order of the matrices
+ *  \param factors_length number of coefficients of a row of the factors, padding included
+ *  \param base pointer to the other matrix
+ *  \param matrix pointer to the matrix
+ *  \param row_length number of coefficients of a row of the matrices, padding included
+ *  \param indices rows or columns in which the matrices differ (found by lowRankDifference)
+ *  \param rank number of rows or columns
+ *  \param columns true if the indices are of columns
+ *  \param work pointer to a buffer of (order_of_matrix + rank) x rank doubles
+ *  \param determinant pointer to a double to multiply by the ratio (its mantissa is left)
+ *  \param exponent pointer to an int to add the binary exponent of the ratio to
+ *
+ *  \return true if the update is stable
+ */
+bool updateDeterminant(const double * factors, const int * pivots, int order_of_matrix, int factors_length,
+                       const double * base, const double * matrix, int row_length, const int * indices, int rank,
+                       bool columns, double * work, double * determinant, int * exponent) {
+
+    int n = order_of_matrix, k = rank;
+    double * x = work;                  // the k right-hand sides, then the solutions, n x k, row by row
+    double * c = work + (size_t) n * k; // I + V^T A^-1 U, k x k
+
+    // Conditioning of the other matrix, from the pivots
+    double smallest = INFINITY, largest = 0;
+    for (int l = 0; l < n; l++) {
+        double pivot = fabs(factors[(size_t) l * factors_length + l]);
+        smallest = (pivot < smallest) ? pivot : smallest;
+        largest = (pivot > largest) ? pivot : largest;
+    }
+    if (!(smallest >= INCREMENTAL_MIN_RATIO * largest))
+        return false;
+
+    /* Right-hand sides: the columns of U */
+    for (int l = 0; l < n; l++)
+        for (int j = 0; j < k; j++)
+            x[l*k + j] = columns ? matrix[(size_t) l * row_length + indices[j]] - base[(size_t) l * row_length + indices[j]]
+                                 : (l == indices[j]);
+
+    /* Solve A X = U: row swaps, then L (unit diagonal) and U, a row of the factors at a time */
+    for (int l = 0; l < n; l++)
+        if (pivots[l] != l)
+            for (int j = 0; j < k; j++) {
+                double temp = x[l*k + j];
+                x[l*k + j] = x[pivots[l]*k + j];
+                x[pivots[l]*k + j] = temp;
+            }
+
+    for (int r = 1; r < n; r++) {
+        const double * row = factors + (size_t) r * factors_length;
+        for (int j = 0; j < k; j++) {
+            double sum = x[r*k + j];
+            for (int l = 0; l < r; l++)
+                sum -= row[l] * x[l*k + j];
+            x[r*k + j] = sum;
+        }
+    }
+
+    for (int r = n - 1; r >= 0; r--) {
+        const double * row = factors + (size_t) r * factors_length;
+        for (int j = 0; j < k; j++) {
+            double sum = x[r*k + j];
+            for (int l = r + 1; l < n; l++)
+                sum -= row[l] * x[l*k + j];
+            x[r*k + j] = sum / row[r];
+        }
+    }
+
+    /* I + V^T X: the differences of the rows times X, or the rows of X of the columns */
+    for (int i = 0; i < k; i++)
+        for (int j = 0; j < k; j++) {
+            double term = (i == j);
+            if (columns)
+                term += x[indices[i]*k + j];
+            else {
+                const double * row = matrix + (size_t) indices[i] * row_length;
+                const double * base_row = base + (size_t) indices[i] * row_length;
+                for (int l = 0; l < n; l++)
+                    term += (row[l] - base_row[l]) * x[l*k + j];
+            }
+            c[i*k + j] = term;
+        }
+
+    // Product of the norms of the columns, as a mantissa and an exponent
+    double norms = 1;
+    int norms_exponent = 0;
+    for (int j = 0; j < k; j++) {
+        double norm = 0;
+        for (int i = 0; i < k; i++)
+            norm += c[i*k + j] * c[i*k + j];
+        int scale;
+        norms = frexp(norms * sqrt(norm), &scale);
+        norms_exponent += scale;
+    }
+
+    /* Determinant of I + V^T X, by Gaussian elimination with partial pivoting */
+    double ratio = 1;
+    int ratio_exponent = 0;
+    for (int l = 0; l < k; l++) {
+        int pivot = l;
+        for (int i = l+1; i < k; i++)
+            if (fabs(c[i*k + l]) > fabs(c[pivot*k + l]))
+                pivot = i;
+        if (!isfinite(c[pivot*k + l]) || c[pivot*k + l] == 0.0)
+            return false;
+
+        if (pivot != l) {
+            for (int j = l; j < k; j++) {
+                double temp = c[l*k + j];
+                c[l*k + j] = c[pivot*k + j];
+                c[pivot*k + j] = temp;
+            }
+            ratio = -ratio;
+        }
+        for (int i = l+1; i < k; i++) {
+            double term = c[i*k + l] / c[l*k + l];
+            for (int j = l+1; j < k; j++)
+                c[i*k + j] -= term * c[l*k + j];
+        }
+
+        int scale;
+        ratio = frexp(ratio * c[l*k + l], &scale);
+        ratio_exponent += scale;
+    }
+
+    // Nearly singular: the determinant is lost in the rounding errors of X
+    if (k > 0 && fabs(ldexp(ratio / norms, ratio_exponent - norms_exponent)) < INCREMENTAL_MIN_RATIO)
+        return false;
+
+    int scale;
+    *determinant = frexp(*determinant * ratio, &scale);
+    *exponent += ratio_exponent + scale;
+
+    return true;
+}
@@ -0,0 +1,75 @@
+/**
+ *  \file incremental.h (interface file)
+ *
+ *  \brief Problem name: Compute Matrix Determinant.
+ *
+ *  In this file the functions to compute the determinant of a matrix from the LU decomposition of another one that
+ *  differs from it in a few rows or columns are defined.
+ *
+ *  If the matrix A' differs from A in k rows (or columns), A' = A + U V^T, with U and V of k columns, and by the matrix
+ *  determinant lemma det(A') = det(A) det(I + V^T A^-1 U): A^-1 U is found by k solves with the L U factors of A, so
+ *  the determinant costs O(n^2 k) operations instead of O(n^3).
+ *
+ *  Definition of the operations carried out by the worker threads:
+ *     \li lowRankDifference
+ *     \li updateDeterminant.
+ *
+ *  \author Diogo Filipe Amaral Carvalho - 92969 - April 2022
+ *  \author Rafael Ferreira Baptista - 93367 - April 2022
+ */
+
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include <stdbool.h>
+
+/**
+ *  \brief Find the rows, or else the columns, in which a matrix differs from another one.
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param base pointer to the other matrix
+ *  \param matrix pointer to the matrix
+ *  \param order_of_matrix order of the matrices
+ *  \param row_length number of coefficients of a row of the matrices, padding included
+ *  \param max_rank largest number of rows or columns to look for
+ *  \param indices pointer to store the rows or columns (max_rank of them at most)
+ *  \param columns pointer to a bool to store whether the indices are of columns (otherwise they are of rows)
+ *
+ *  \return number of rows or columns, or -1 if the matrices differ in more than max_rank rows and columns
+ */
+extern int lowRankDifference (const double * base, const double * matrix, int order_of_matrix, int row_length,
+                              int max_rank, int * indices, bool * columns);
+
+
+/**
+ *  \brief Multiply a determinant by the ratio of the determinants of a matrix and another one, from the L U factors of the other.
+ *
+ *  The update is unstable, and the determinant is left as it was, when the other matrix is ill conditioned (the ratio
+ *  of its smallest to its largest pivot is below INCREMENTAL_MIN_RATIO) or when I + V^T A^-1 U is nearly singular (the
+ *  ratio of its determinant to the product of the norms of its columns is below INCREMENTAL_MIN_RATIO).
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param factors pointer to the L U factors of the other matrix, with partial pivoting (the multipliers below the diagonal)
+ *  \param pivots pivot row of each column of the factors
+ *  \param order_of_matrix order of the matrices
+ *  \param factors_length number of coefficients of a row of the factors, padding included
+ *  \param base pointer to the other matrix
+ *  \param matrix pointer to the matrix
+ *  \param row_length number of coefficients of a row of the matrices, padding included
+ *  \param indices rows or columns in which the matrices differ (found by lowRankDifference)
+ *  \param rank number of rows or columns
+ *  \param columns true if the indices are of columns
+ *  \param work pointer to a buffer of (order_of_matrix + rank) x rank doubles
+ *  \param determinant pointer to a double to multiply by the ratio (its mantissa is left)
+ *  \param exponent pointer to an int to add the binary exponent of the ratio to
+ *
+ *  \return true if the update is stable
+ */
+extern bool updateDeterminant (const double * factors, const int * pivots, int order_of_matrix, int factors_length,
+                               const double * base, const double * matrix, int row_length, const int * indices, int rank,
+                               bool columns, double * work, double * determinant, int * exponent);
+
+
+#endif /* INCREMENTAL_H */
@@ -0,0 +1,744 @@
+/**
+ *  \file kernels.c (implementation file)
+ *
+ *  \brief Problem name: Compute Matrix Determinant.
+ *
+ *  In this file the kernels of the trailing matrix update of the blocked LU decomposition are implemented.
+ *  The vector kernels are compiled for their instruction set with target attributes, so the program runs on any
+ *  x86-64 processor: the instruction set is only used after the processor reports (CPUID) that it supports it.
+ *
+ *  Each vector kernel is register blocked: it keeps a tile of UPDATE_ROWS rows by two vectors of columns in registers
+ *  while it goes through the columns of the panel, so each row of the panel is loaded once for UPDATE_ROWS rows.
+ *
+ *  The batched kernels compute the determinants of many small matrices: a group of matrices (one per lane of a vector)
+ *  is interleaved, so each coefficient of the matrices of the group is a vector, and the matrices are eliminated in
+ *  lockstep. Each lane chooses its own pivot; the rows are swapped and the singular lanes are handled with blend masks.
+ *  There is a batched kernel for each order up to SPECIALIZED_MAX_ORDER, with the order known at compile time, so its
+ *  loops are fully unrolled; up to order 4 the determinants are given by the cofactor expansion instead.
+ *
+ *  Definition of the operations carried out by the main thread:
+ *     \li kernelSupported
+ *     \li fastestKernel.
+ *  Definition of the operations carried out by the worker threads:
+ *     \li updateKernels
+ *     \li determinantBatch
+ *     \li determinantBatchGeneric.
+ *
+ *  \author Diogo Filipe Amaral Carvalho - 92969 - April 2022
+ *  \author Rafael Ferreira Baptista - 93367 - April 2022
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <math.h>
+#include <immintrin.h>
+
+#include "kernels.h"
+#include "probConst.h"
+
+/** \brief number of rows updated at once by the vector kernels */
+#define  UPDATE_ROWS  4
+
+/** \brief scalar kernel of the trailing matrix update */
+static void updateTileScalar (double * matrix, int row_length, int first_row, int last_row,
+                              int panel, int panel_end, int tile, int tile_end);
+
+/** \brief AVX2 kernel of the trailing matrix update */
+static void updateTileAVX2 (double * matrix, int row_length, int first_row, int last_row,
+                            int panel, int panel_end, int tile, int tile_end);
+
+/** \brief AVX-512 kernel of the trailing matrix update */
+static void updateTileAVX512 (double * matrix, int row_length, int first_row, int last_row,
+                              int panel, int panel_end, int tile, int tile_end);
+
+/** \brief type of the kernels of the determinants of a batch of matrices */
+typedef void (*BatchKernel) (const double * matrices, int order_of_matrix, int number_of_matrices,
+                             double * determinants);
+
+/** \brief scalar kernel of the determinants of a batch of matrices */
+static void determinantBatchScalar (const double * matrices, int order_of_matrix, int number_of_matrices,
+                                    double * determinants);
+
+/** \brief AVX2 kernel of the determinants of a batch of matrices (4 matrices at a time) */
+static void determinantBatchAVX2 (const double * matrices, int order_of_matrix, int number_of_matrices,
+                                  double * determinants);
+
+/** \brief AVX-512 kernel of the determinants of a batch of matrices (8 matrices at a time) */
+static void determinantBatchAVX512 (const double * matrices, int order_of_matrix, int number_of_matrices,
+                                    double * determinants);
+
+/** \brief names of the variants of the kernels */
+const char * kernelNames[NUMBER_OF_KERNELS] = { "scalar", "AVX2", "AVX-512" };
+
+/** \brief kernels of the trailing matrix update, by variant */
+const UpdateKernel updateKernels[NUMBER_OF_KERNELS] = { updateTileScalar, updateTileAVX2, updateTileAVX512 };
+
+/**
+ *  \brief Find whether the processor supports a variant of the kernels.
+ *
+ *  \param variant variant of the kernels (enum KernelVariant)
+ *
+ *  \return true if the variant can be used
+ */
+bool kernelSupported (int variant)
+{
+  __builtin_cpu_init ();
+
+  switch (variant)
+  { case KERNEL_SCALAR:
+      return true;
+    case KERNEL_AVX2:
+      return __builtin_cpu_supports ("avx2") && __builtin_cpu_supports ("fma");
+    case KERNEL_AVX512:
+      return __builtin_cpu_supports ("avx512f");
+  }
+
+  return false;
+}
+
+/**
+ *  \brief Find the variant of the kernels with the widest vectors supported by the processor (scalar, AVX2 or AVX-512).
+ *
+ *  \return variant of the kernels (enum KernelVariant)
+ */
+int fastestKernel ()
+{
+  int variant = NUMBER_OF_KERNELS - 1;
+
+  while (!kernelSupported (variant))
+    variant -= 1;
+
+  return variant;
+}
+
+/**
+ *  \brief Scalar kernel: update a tile of the trailing matrix with the rows of a panel.
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param matrix pointer to the start of the matrix
+ *  \param row_length number of coefficients of a row, padding included
+ *  \param first_row first row of the tile
+ *  \param last_row row after the last row of the tile
+ *  \param panel first column of the panel
+ *  \param panel_end column after the last column of the panel
+ *  \param tile first column of the tile
+ *  \param tile_end column after the last column of the tile
+ */
+static void updateTileScalar (double * matrix, int row_length, int first_row, int last_row,
+                              int panel, int panel_end, int tile, int tile_end)
+{
+  for (int k = first_row; k < last_row; k++) {
+      double * row_k = matrix + k*row_length;
+      for (int l = panel; l < panel_end; l++) {
+          double * row_l = matrix + l*row_length;
+          double term = row_k[l];
+          for (int j = tile; j < tile_end; j++)
+              row_k[j] -= term * row_l[j];
+      }
+  }
+}
+
+/**
+ *  \brief AVX2 kernel: update a tile of the trailing matrix with the rows of a panel.
+ *
+ *  UPDATE_ROWS rows by 8 columns (two vectors of 4 coefficients) are kept in registers.
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param matrix pointer to the start of the matrix
+ *  \param row_length number of coefficients of a row, padding included
+ *  \param first_row first row of the tile
+ *  \param last_row row after the last row of the tile
+ *  \param panel first column of the panel
+ *  \param panel_end column after the last column of the panel
+ *  \param tile first column of the tile
+ *  \param tile_end column after the last column of the tile
+ */
+__attribute__ ((target ("avx2,fma")))
+static void updateTileAVX2 (double * matrix, int row_length, int first_row, int last_row,
+                            int panel, int panel_end, int tile, int tile_end)
+{
+  int padded_end = (tile_end + 7) & ~7;        // the padding of the rows is updated too
+  int k = first_row;
+
+  // UPDATE_ROWS rows at once
+  for (; k + UPDATE_ROWS <= last_row; k += UPDATE_ROWS) {
+      double * row_0 = matrix + k*row_length;
+      double * row_1 = row_0 + row_length;
+      double * row_2 = row_1 + row_length;
+      double * row_3 = row_2 + row_length;
+
+      for (int j = tile; j < padded_end; j += 8) {
+          __m256d c00 = _mm256_load_pd (row_0 + j), c01 = _mm256_load_pd (row_0 + j + 4);
+          __m256d c10 = _mm256_load_pd (row_1 + j), c11 = _mm256_load_pd (row_1 + j + 4);
+          __m256d c20 = _mm256_load_pd (row_2 + j), c21 = _mm256_load_pd (row_2 + j + 4);
+          __m256d c30 = _mm256_load_pd (row_3 + j), c31 = _mm256_load_pd (row_3 + j + 4);
+
+          for (int l = panel; l < panel_end; l++) {
+              double * row_l = matrix + l*row_length;
+              __m256d u0 = _mm256_load_pd (row_l + j), u1 = _mm256_load_pd (row_l + j + 4);
+              __m256d term;
+
+              term = _mm256_broadcast_sd (row_0 + l);
+              c00 = _mm256_fnmadd_pd (term, u0, c00);
+              c01 = _mm256_fnmadd_pd (term, u1, c01);
+              term = _mm256_broadcast_sd (row_1 + l);
+              c10 = _mm256_fnmadd_pd (term, u0, c10);
+              c11 = _mm256_fnmadd_pd (term, u1, c11);
+              term = _mm256_broadcast_sd (row_2 + l);
+              c20 = _mm256_fnmadd_pd (term, u0, c20);
+              c21 = _mm256_fnmadd_pd (term, u1, c21);
+              term = _mm256_broadcast_sd (row_3 + l);
+              c30 = _mm256_fnmadd_pd (term, u0, c30);
+              c31 = _mm256_fnmadd_pd (term, u1, c31);
+          }
+
+          _mm256_store_pd (row_0 + j, c00); _mm256_store_pd (row_0 + j + 4, c01);
+          _mm256_store_pd (row_1 + j, c10); _mm256_store_pd (row_1 + j + 4, c11);
+          _mm256_store_pd (row_2 + j, c20); _mm256_store_pd (row_2 + j + 4, c21);
+          _mm256_store_pd (row_3 + j, c30); _mm256_store_pd (row_3 + j + 4, c31);
+      }
+  }
+
+  // Remaining rows, one at a time
+  for (; k < last_row; k++) {
+      double * row_k = matrix + k*row_length;
+
+      for (int j = tile; j < padded_end; j += 8) {
+          __m256d c0 = _mm256_load_pd (row_k + j), c1 = _mm256_load_pd (row_k + j + 4);
+
+          for (int l = panel; l < panel_end; l++) {
+              double * row_l = matrix + l*row_length;
+              __m256d term = _mm256_broadcast_sd (row_k + l);
+              c0 = _mm256_fnmadd_pd (term, _mm256_load_pd (row_l + j), c0);
+              c1 = _mm256_fnmadd_pd (term, _mm256_load_pd (row_l + j + 4), c1);
+          }
+
+          _mm256_store_pd (row_k + j, c0); _mm256_store_pd (row_k + j + 4, c1);
+      }
+  }
+}
+
+/**
+ *  \brief AVX-512 kernel: update a tile of the trailing matrix with the rows of a panel.
+ *
+ *  UPDATE_ROWS rows by 16 columns (two vectors of 8 coefficients) are kept in registers.
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param matrix pointer to the start of the matrix
+ *  \param row_length number of coefficients of a row, padding included
+ *  \param first_row first row of the tile
+ *  \param last_row row after the last row of the tile
+ *  \param panel first column of the panel
+ *  \param panel_end column after the last column of the panel
+ *  \param tile first column of the tile
+ *  \param tile_end column after the last column of the tile
+ */
+__attribute__ ((target ("avx512f")))
+static void updateTileAVX512 (double * matrix, int row_length, int first_row, int last_row,
+                              int panel, int panel_end, int tile, int tile_end)
+{
+  int padded_end = (tile_end + 15) & ~15;      // the padding of the rows is updated too
+  int k = first_row;
+
+  // UPDATE_ROWS rows at once
+  for (; k + UPDATE_ROWS <= last_row; k += UPDATE_ROWS) {
+      double * row_0 = matrix + k*row_length;
+      double * row_1 = row_0 + row_length;
+      double * row_2 = row_1 + row_length;
+      double * row_3 = row_2 + row_length;
+
+      for (int j = tile; j < padded_end; j += 16) {
+          __m512d c00 = _mm512_load_pd (row_0 + j), c01 = _mm512_load_pd (row_0 + j + 8);
+          __m512d c10 = _mm512_load_pd (row_1 + j), c11 = _mm512_load_pd (row_1 + j + 8);
+          __m512d c20 = _mm512_load_pd (row_2 + j), c21 = _mm512_load_pd (row_2 + j + 8);
+          __m512d c30 = _mm512_load_pd (row_3 + j), c31 = _mm512_load_pd (row_3 + j + 8);
+
+          for (int l = panel; l < panel_end; l++) {
+              double * row_l = matrix + l*row_length;
+              __m512d u0 = _mm512_load_pd (row_l + j), u1 = _mm512_load_pd (row_l + j + 8);
+              __m512d term;
+
+              term = _mm512_set1_pd (row_0[l]);
+              c00 = _mm512_fnmadd_pd (term, u0, c00);
+              c01 = _mm512_fnmadd_pd (term, u1, c01);
+              term = _mm512_set1_pd (row_1[l]);
+              c10 = _mm512_fnmadd_pd (term, u0, c10);
+              c11 = _mm512_fnmadd_pd (term, u1, c11);
+              term = _mm512_set1_pd (row_2[l]);
+              c20 = _mm512_fnmadd_pd (term, u0, c20);
+              c21 = _mm512_fnmadd_pd (term, u1, c21);
+              term = _mm512_set1_pd (row_3[l]);
+              c30 = _mm512_fnmadd_pd (term, u0, c30);
+              c31 = _mm512_fnmadd_pd (term, u1, c31);
+          }
+
+          _mm512_store_pd (row_0 + j, c00); _mm512_store_pd (row_0 + j + 8, c01);
+          _mm512_store_pd (row_1 + j, c10); _mm512_store_pd (row_1 + j + 8, c11);
+          _mm512_store_pd (row_2 + j, c20); _mm512_store_pd (row_2 + j + 8, c21);
+          _mm512_store_pd (row_3 + j, c30); _mm512_store_pd (row_3 + j + 8, c31);
+      }
+  }
+
+  // Remaining rows, one at a time
+  for (; k < last_row; k++) {
+      double * row_k = matrix + k*row_length;
+
+      for (int j = tile; j < padded_end; j += 16) {
+          __m512d c0 = _mm512_load_pd (row_k + j), c1 = _mm512_load_pd (row_k + j + 8);
+
+          for (int l = panel; l < panel_end; l++) {
+              double * row_l = matrix + l*row_length;
+              __m512d term = _mm512_set1_pd (row_k[l]);
+              c0 = _mm512_fnmadd_pd (term, _mm512_load_pd (row_l + j), c0);
+              c1 = _mm512_fnmadd_pd (term, _mm512_load_pd (row_l + j + 8), c1);
+          }
+
+          _mm512_store_pd (row_k + j, c0); _mm512_store_pd (row_k + j + 8, c1);
+      }
+  }
+}
+
+/**
+ *  \brief Interleave a group of matrices: coefficient c of the matrix in lane l is stored at lanes[c*number_of_lanes + l].
+ *
+ *  The lanes without a matrix get an identity matrix, whose determinant is 1.
+ *
+ *  \param matrices pointer to the first matrix of the group
+ *  \param order_of_matrix order of the matrices
+ *  \param number_of_matrices number of matrices of the group
+ *  \param lanes pointer to the interleaved matrices
+ *  \param number_of_lanes number of lanes of a vector
+ */
+static void interleave (const double * matrices, int order_of_matrix, int number_of_matrices,
+                        double * lanes, int number_of_lanes)
+{
+  int size = order_of_matrix * order_of_matrix;
+
+  for (int c = 0; c < size; c++)
+      for (int l = 0; l < number_of_lanes; l++)
+          if (l < number_of_matrices)
+             lanes[c*number_of_lanes + l] = matrices[l*size + c];
+          else lanes[c*number_of_lanes + l] = (c % (order_of_matrix + 1) == 0) ? 1.0 : 0.0;
+}
+
+/**
+ *  \brief Scalar kernel: compute the determinants of a batch of matrices, one at a time.
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param matrices pointer to the first matrix of the batch (the matrices are stored one after the other, row by row)
+ *  \param order_of_matrix order of the matrices
+ *  \param number_of_matrices number of matrices of the batch
+ *  \param determinants pointer to the determinant of the first matrix of the batch
+ */
+static void determinantBatchScalar (const double * matrices, int order_of_matrix, int number_of_matrices,
+                                    double * determinants)
+{
+  int n = order_of_matrix;
+  double * a = malloc (n * n * sizeof (double));
+
+  for (int m = 0; m < number_of_matrices; m++) {
+      double det = 1.0;
+
+      for (int c = 0; c < n*n; c++)
+          a[c] = matrices[m*n*n + c];
+
+      for (int k = 0; k < n; k++) {
+          int pivot = k;
+          for (int i = k+1; i < n; i++)
+              if (fabs (a[i*n + k]) > fabs (a[pivot*n + k]))
+                 pivot = i;
+          if (pivot != k)
+             { for (int j = k; j < n; j++) {
+                   double temp = a[k*n + j];
+                   a[k*n + j] = a[pivot*n + j];
+                   a[pivot*n + j] = temp;
+               }
+               det = -det;
+             }
+          det *= a[k*n + k];
+          if (det == 0.0)
+             break;
+          for (int i = k+1; i < n; i++) {
+              double term = a[i*n + k] / a[k*n + k];
+              for (int j = k+1; j < n; j++)
+                  a[i*n + j] -= term * a[k*n + j];
+          }
+      }
+      determinants[m] = det;
+  }
+
+  free (a);
+}
+
+/**
+ *  \brief Determinants of 4 interleaved matrices of order up to 4, by cofactor expansion.
+ *
+ *  \param a interleaved matrices (a[c] holds coefficient c of the 4 matrices)
+ *  \param n order of the matrices
+ *
+ *  \return determinants
+ */
+__attribute__ ((target ("avx2,fma"), always_inline))
+static inline __m256d cofactorsAVX2 (const __m256d * a, int n)
+{
+  if (n == 1)
+     return a[0];
+  if (n == 2)
+     return a[0]*a[3] - a[1]*a[2];
+  if (n == 3)
+     return a[0]*(a[4]*a[8] - a[5]*a[7]) - a[1]*(a[3]*a[8] - a[5]*a[6]) + a[2]*(a[3]*a[7] - a[4]*a[6]);
+
+  // Minors of order 2 of the last two rows, then cofactors of the first row
+  __m256d m01 = a[8]*a[13] - a[9]*a[12], m02 = a[8]*a[14] - a[10]*a[12], m03 = a[8]*a[15] - a[11]*a[12];
+  __m256d m12 = a[9]*a[14] - a[10]*a[13], m13 = a[9]*a[15] - a[11]*a[13], m23 = a[10]*a[15] - a[11]*a[14];
+
+  return a[0]*(a[5]*m23 - a[6]*m13 + a[7]*m12) - a[1]*(a[4]*m23 - a[6]*m03 + a[7]*m02)
+       + a[2]*(a[4]*m13 - a[5]*m03 + a[7]*m01) - a[3]*(a[4]*m12 - a[5]*m02 + a[6]*m01);
+}
+
+/**
+ *  \brief Determinants of 4 interleaved matrices, by Gaussian elimination with partial pivoting in each lane.
+ *
+ *  \param a interleaved matrices (a[c] holds coefficient c of the 4 matrices), overwritten
+ *  \param n order of the matrices
+ *
+ *  \return determinants
+ */
+__attribute__ ((target ("avx2,fma"), always_inline))
+static inline __m256d eliminateAVX2 (__m256d * a, int n)
+{
+  __m256d sign_bit = _mm256_set1_pd (-0.0), zeros = _mm256_setzero_pd (), ones = _mm256_set1_pd (1.0);
+  __m256d det = ones, singular = zeros;
+
+  #pragma GCC unroll 16
+  for (int k = 0; k < n; k++) {
+      __m256d * row_k = a + k*n;
+
+      // Pivot of each lane: the row with the largest absolute value in column k
+      __m256d best = _mm256_andnot_pd (sign_bit, row_k[k]);
+      __m256d pivot = _mm256_set1_pd (k);
+      #pragma GCC unroll 16
+      for (int i = k+1; i < n; i++) {
+          __m256d value = _mm256_andnot_pd (sign_bit, a[i*n + k]);
+          __m256d larger = _mm256_cmp_pd (value, best, _CMP_GT_OQ);
+          best = _mm256_blendv_pd (best, value, larger);
+          pivot = _mm256_blendv_pd (pivot, _mm256_set1_pd (i), larger);
+      }
+
+      // Swap row k with the pivot row, in the lanes where it is row i, which changes the sign of the determinant
+      #pragma GCC unroll 16
+      for (int i = k+1; i < n; i++) {
+          __m256d swap = _mm256_cmp_pd (pivot, _mm256_set1_pd (i), _CMP_EQ_OQ);
+          if (_mm256_movemask_pd (swap) == 0)
+             continue;
+          __m256d * row_i = a + i*n;
+          #pragma GCC unroll 16
+          for (int j = k; j < n; j++) {
+              __m256d a_kj = row_k[j], a_ij = row_i[j];
+              row_k[j] = _mm256_blendv_pd (a_kj, a_ij, swap);
+              row_i[j] = _mm256_blendv_pd (a_ij, a_kj, swap);
+          }
+          det = _mm256_blendv_pd (det, _mm256_xor_pd (det, sign_bit), swap);
+      }
+
+      // A lane without a pivot is singular: its pivot is replaced by 1 to keep the other lanes going
+      __m256d diag = row_k[k];
+      __m256d zero = _mm256_cmp_pd (diag, zeros, _CMP_EQ_OQ);
+      singular = _mm256_or_pd (singular, zero);
+      diag = _mm256_blendv_pd (diag, ones, zero);
+      det = _mm256_mul_pd (det, diag);
+
+      // Eliminate column k below the diagonal
+      __m256d inverse = _mm256_div_pd (ones, diag);
+      #pragma GCC unroll 16
+      for (int i = k+1; i < n; i++) {
+          __m256d * row_i = a + i*n;
+          __m256d term = _mm256_mul_pd (row_i[k], inverse);
+          #pragma GCC unroll 16
+          for (int j = k+1; j < n; j++)
+              row_i[j] = _mm256_fnmadd_pd (term, row_k[j], row_i[j]);
+      }
+  }
+
+  return _mm256_andnot_pd (singular, det);
+}
+
+/**
+ *  \brief Compute the determinants of a batch of matrices, 4 at a time, with the AVX2.
+ *
+ *  Inlined in each AVX2 kernel, so the order is a constant in the kernels specialized for an order.
+ *
+ *  \param matrices pointer to the first matrix of the batch (the matrices are stored one after the other, row by row)
+ *  \param n order of the matrices
+ *  \param number_of_matrices number of matrices of the batch
+ *  \param determinants pointer to the determinant of the first matrix of the batch
+ *  \param a storage for 4 interleaved matrices
+ */
+__attribute__ ((target ("avx2,fma"), always_inline))
+static inline void batchAVX2 (const double * matrices, int n, int number_of_matrices, double * determinants, __m256d * a)
+{
+  double result[4] __attribute__ ((aligned (32)));
+
+  for (int first = 0; first < number_of_matrices; first += 4) {
+      int count = (number_of_matrices - first < 4) ? number_of_matrices - first : 4;
+
+      interleave (matrices + first*n*n, n, count, (double *) a, 4);
+
+      _mm256_store_pd (result, (n <= 4) ? cofactorsAVX2 (a, n) : eliminateAVX2 (a, n));
+      for (int l = 0; l < count; l++)
+          determinants[first + l] = result[l];
+  }
+}
+
+/**
+ *  \brief AVX2 kernel: compute the determinants of a batch of matrices of any order, 4 at a time.
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param matrices pointer to the first matrix of the batch (the matrices are stored one after the other, row by row)
+ *  \param order_of_matrix order of the matrices
+ *  \param number_of_matrices number of matrices of the batch
+ *  \param determinants pointer to the determinant of the first matrix of the batch
+ */
+__attribute__ ((target ("avx2,fma")))
+static void determinantBatchAVX2 (const double * matrices, int order_of_matrix, int number_of_matrices,
+                                  double * determinants)
+{
+  __m256d * a = aligned_alloc (sizeof (__m256d), order_of_matrix * order_of_matrix * sizeof (__m256d));
+
+  batchAVX2 (matrices, order_of_matrix, number_of_matrices, determinants, a);
+
+  free (a);
+}
+
+/**
+ *  \brief Determinants of 8 interleaved matrices of order up to 4, by cofactor expansion.
+ *
+ *  \param a interleaved matrices (a[c] holds coefficient c of the 8 matrices)
+ *  \param n order of the matrices
+ *
+ *  \return determinants
+ */
+__attribute__ ((target ("avx512f"), always_inline))
+static inline __m512d cofactorsAVX512 (const __m512d * a, int n)
+{
+  if (n == 1)
+     return a[0];
+  if (n == 2)
+     return a[0]*a[3] - a[1]*a[2];
+  if (n == 3)
+     return a[0]*(a[4]*a[8] - a[5]*a[7]) - a[1]*(a[3]*a[8] - a[5]*a[6]) + a[2]*(a[3]*a[7] - a[4]*a[6]);
+
+  // Minors of order 2 of the last two rows, then cofactors of the first row
+  __m512d m01 = a[8]*a[13] - a[9]*a[12], m02 = a[8]*a[14] - a[10]*a[12], m03 = a[8]*a[15] - a[11]*a[12];
+  __m512d m12 = a[9]*a[14] - a[10]*a[13], m13 = a[9]*a[15] - a[11]*a[13], m23 = a[10]*a[15] - a[11]*a[14];
+
+  return a[0]*(a[5]*m23 - a[6]*m13 + a[7]*m12) - a[1]*(a[4]*m23 - a[6]*m03 + a[7]*m02)
+       + a[2]*(a[4]*m13 - a[5]*m03 + a[7]*m01) - a[3]*(a[4]*m12 - a[5]*m02 + a[6]*m01);
+}
+
+/**
+ *  \brief Determinants of 8 interleaved matrices, by Gaussian elimination with partial pivoting in each lane.
+ *
+ *  \param a interleaved matrices (a[c] holds coefficient c of the 8 matrices), overwritten
+ *  \param n order of the matrices
+ *
+ *  \return determinants
+ */
+__attribute__ ((target ("avx512f"), always_inline))
+static inline __m512d eliminateAVX512 (__m512d * a, int n)
+{
+  __m512d zeros = _mm512_setzero_pd (), ones = _mm512_set1_pd (1.0);
+  __m512d det = ones;
+  __mmask8 singular = 0;
+
+  #pragma GCC unroll 16
+  for (int k = 0; k < n; k++) {
+      __m512d * row_k = a + k*n;
+
+      // Pivot of each lane: the row with the largest absolute value in column k
+      __m512d best = _mm512_abs_pd (row_k[k]);
+      __m512d pivot = _mm512_set1_pd (k);
+      #pragma GCC unroll 16
+      for (int i = k+1; i < n; i++) {
+          __m512d value = _mm512_abs_pd (a[i*n + k]);
+          __mmask8 larger = _mm512_cmp_pd_mask (value, best, _CMP_GT_OQ);
+          best = _mm512_mask_blend_pd (larger, best, value);
+          pivot = _mm512_mask_blend_pd (larger, pivot, _mm512_set1_pd (i));
+      }
+
+      // Swap row k with the pivot row, in the lanes where it is row i, which changes the sign of the determinant
+      #pragma GCC unroll 16
+      for (int i = k+1; i < n; i++) {
+          __mmask8 swap = _mm512_cmp_pd_mask (pivot, _mm512_set1_pd (i), _CMP_EQ_OQ);
+          if (swap == 0)
+             continue;
+          __m512d * row_i = a + i*n;
+          #pragma GCC unroll 16
+          for (int j = k; j < n; j++) {
+              __m512d a_kj = row_k[j], a_ij = row_i[j];
+              row_k[j] = _mm512_mask_blend_pd (swap, a_kj, a_ij);
+              row_i[j] = _mm512_mask_blend_pd (swap, a_ij, a_kj);
+          }
+          det = _mm512_mask_sub_pd (det, swap, zeros, det);
+      }
+
+      // A lane without a pivot is singular: its pivot is replaced by 1 to keep the other lanes going
+      __m512d diag = row_k[k];
+      __mmask8 zero = _mm512_cmp_pd_mask (diag, zeros, _CMP_EQ_OQ);
+      singular |= zero;
+      diag = _mm512_mask_blend_pd (zero, diag, ones);
+      det = _mm512_mul_pd (det, diag);
+
+      // Eliminate column k below the diagonal
+      __m512d inverse = _mm512_div_pd (ones, diag);
+      #pragma GCC unroll 16
+      for (int i = k+1; i < n; i++) {
+          __m512d * row_i = a + i*n;
+          __m512d term = _mm512_mul_pd (row_i[k], inverse);
+          #pragma GCC unroll 16
+          for (int j = k+1; j < n; j++)
+              row_i[j] = _mm512_fnmadd_pd (term, row_k[j], row_i[j]);
+      }
+  }
+
+  return _mm512_maskz_mov_pd ((__mmask8) ~singular, det);
+}
+
+/**
+ *  \brief Compute the determinants of a batch of matrices, 8 at a time, with the AVX-512.
+ *
+ *  Inlined in each AVX-512 kernel, so the order is a constant in the kernels specialized for an order.
+ *
+ *  \param matrices pointer to the first matrix of the batch (the matrices are stored one after the other, row by row)
+ *  \param n order of the matrices
+ *  \param number_of_matrices number of matrices of the batch
+ *  \param determinants pointer to the determinant of the first matrix of the batch
+ *  \param a storage for 8 interleaved matrices
+ */
+__attribute__ ((target ("avx512f"), always_inline))
+static inline void batchAVX512 (const double * matrices, int n, int number_of_matrices, double * determinants, __m512d * a)
+{
+  double result[8] __attribute__ ((aligned (64)));
+
+  for (int first = 0; first < number_of_matrices; first += 8) {
+      int count = (number_of_matrices - first < 8) ? number_of_matrices - first : 8;
+
+      interleave (matrices + first*n*n, n, count, (double *) a, 8);
+
+      _mm512_store_pd (result, (n <= 4) ? cofactorsAVX512 (a, n) : eliminateAVX512 (a, n));
+      for (int l = 0; l < count; l++)
+          determinants[first + l] = result[l];
+  }
+}
+
+/**
+ *  \brief AVX-512 kernel: compute the determinants of a batch of matrices of any order, 8 at a time.
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param matrices pointer to the first matrix of the batch (the matrices are stored one after the other, row by row)
+ *  \param order_of_matrix order of the matrices
+ *  \param number_of_matrices number of matrices of the batch
+ *  \param determinants pointer to the determinant of the first matrix of the batch
+ */
+__attribute__ ((target ("avx512f")))
+static void determinantBatchAVX512 (const double * matrices, int order_of_matrix, int number_of_matrices,
+                                    double * determinants)
+{
+  __m512d * a = aligned_alloc (sizeof (__m512d), order_of_matrix * order_of_matrix * sizeof (__m512d));
+
+  batchAVX512 (matrices, order_of_matrix, number_of_matrices, determinants, a);
+
+  free (a);
+}
+
+/**
+ *  \brief Kernels specialized for the order N: the order is a constant, so the loops are fully unrolled
+ *  and the interleaved matrices are local to the kernel.
+ */
+#define  SPECIALIZED_KERNELS(N)                                                                                      \
+__attribute__ ((target ("avx2,fma")))                                                                               \
+static void determinantBatchAVX2_##N (const double * matrices, int order_of_matrix, int number_of_matrices,         \
+                                      double * determinants)                                                        \
+{                                                                                                                   \
+  __m256d a[N*N];                                                                                                   \
+  batchAVX2 (matrices, N, number_of_matrices, determinants, a);                                                     \
+}                                                                                                                   \
+__attribute__ ((target ("avx512f")))                                                                                \
+static void determinantBatchAVX512_##N (const double * matrices, int order_of_matrix, int number_of_matrices,       \
+                                        double * determinants)                                                      \
+{                                                                                                                   \
+  __m512d a[N*N];                                                                                                   \
+  batchAVX512 (matrices, N, number_of_matrices, determinants, a);                                                   \
+}
+
+SPECIALIZED_KERNELS(1)  SPECIALIZED_KERNELS(2)  SPECIALIZED_KERNELS(3)  SPECIALIZED_KERNELS(4)
+SPECIALIZED_KERNELS(5)  SPECIALIZED_KERNELS(6)  SPECIALIZED_KERNELS(7)  SPECIALIZED_KERNELS(8)
+SPECIALIZED_KERNELS(9)  SPECIALIZED_KERNELS(10) SPECIALIZED_KERNELS(11) SPECIALIZED_KERNELS(12)
+SPECIALIZED_KERNELS(13) SPECIALIZED_KERNELS(14) SPECIALIZED_KERNELS(15) SPECIALIZED_KERNELS(16)
+
+/** \brief AVX2 batched kernels, by order (the kernel of index 0 takes any order) */
+static const BatchKernel batchKernelsAVX2[SPECIALIZED_MAX_ORDER + 1] = {
+  determinantBatchAVX2,     determinantBatchAVX2_1,   determinantBatchAVX2_2,   determinantBatchAVX2_3,
+  determinantBatchAVX2_4,   determinantBatchAVX2_5,   determinantBatchAVX2_6,   determinantBatchAVX2_7,
+  determinantBatchAVX2_8,   determinantBatchAVX2_9,   determinantBatchAVX2_10,  determinantBatchAVX2_11,
+  determinantBatchAVX2_12,  determinantBatchAVX2_13,  determinantBatchAVX2_14,  determinantBatchAVX2_15,
+  determinantBatchAVX2_16
+};
+
+/** \brief AVX-512 batched kernels, by order (the kernel of index 0 takes any order) */
+static const BatchKernel batchKernelsAVX512[SPECIALIZED_MAX_ORDER + 1] = {
+  determinantBatchAVX512,     determinantBatchAVX512_1,   determinantBatchAVX512_2,   determinantBatchAVX512_3,
+  determinantBatchAVX512_4,   determinantBatchAVX512_5,   determinantBatchAVX512_6,   determinantBatchAVX512_7,
+  determinantBatchAVX512_8,   determinantBatchAVX512_9,   determinantBatchAVX512_10,  determinantBatchAVX512_11,
+  determinantBatchAVX512_12,  determinantBatchAVX512_13,  determinantBatchAVX512_14,  determinantBatchAVX512_15,
+  determinantBatchAVX512_16
+};
+
+/** \brief scalar batched kernels, by order (the same kernel takes every order) */
+static const BatchKernel batchKernelsScalar[SPECIALIZED_MAX_ORDER + 1] = { [0 ... SPECIALIZED_MAX_ORDER] = determinantBatchScalar };
+
+/** \brief batched kernels, by variant and order */
+static const BatchKernel * const batchKernels[NUMBER_OF_KERNELS] = { batchKernelsScalar, batchKernelsAVX2, batchKernelsAVX512 };
+
+/**
+ *  \brief Compute the determinants of a batch of small matrices, with the kernel of their order.
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param variant variant of the kernels (enum KernelVariant)
+ *  \param matrices pointer to the first matrix of the batch (the matrices are stored one after the other, row by row)
+ *  \param order_of_matrix order of the matrices
+ *  \param number_of_matrices number of matrices of the batch
+ *  \param determinants pointer to the determinant of the first matrix of the batch
+ */
+void determinantBatch (int variant, const double * matrices, int order_of_matrix, int number_of_matrices, double * determinants)
+{
+  int kernel = (order_of_matrix <= SPECIALIZED_MAX_ORDER) ? order_of_matrix : 0;
+
+  batchKernels[variant][kernel] (matrices, order_of_matrix, number_of_matrices, determinants);
+}
+
+
+/**
+ *  \brief Compute the determinants of a batch of small matrices, with the generic kernel of the variant.
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param variant variant of the kernels (enum KernelVariant)
+ *  \param matrices pointer to the first matrix of the batch (the matrices are stored one after the other, row by row)
+ *  \param order_of_matrix order of the matrices
+ *  \param number_of_matrices number of matrices of the batch
+ *  \param determinants pointer to the determinant of the first matrix of the batch
+ */
+void determinantBatchGeneric (int variant, const double * matrices, int order_of_matrix, int number_of_matrices,
+                              double * determinants)
+{
+  batchKernels[variant][0] (matrices, order_of_matrix, number_of_matrices, determinants);
+}
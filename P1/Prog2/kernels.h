@@ -0,0 +1,117 @@
+/**
+ *  \file kernels.h (interface file)
+ *
+ *  \brief Problem name: Compute Matrix Determinant.
+ *
+ *  In this file the kernels of the trailing matrix update of the blocked LU decomposition are defined.
+ *  There is a scalar kernel and, when the processor supports them, AVX2 and AVX-512 kernels with FMA instructions.
+ *  The same goes for the batched kernels, which compute the determinants of many small matrices in lockstep.
+ *  The variant of the kernels is chosen for each order of the matrices (tuning.c), among the ones the processor supports.
+ *
+ *  Definition of the operations carried out by the main thread:
+ *     \li kernelSupported
+ *     \li fastestKernel.
+ *  Definition of the operations carried out by the worker threads:
+ *     \li updateKernels
+ *     \li determinantBatch
+ *     \li determinantBatchGeneric.
+ *
+ *  \author Diogo Filipe Amaral Carvalho - 92969 - April 2022
+ *  \author Rafael Ferreira Baptista - 93367 - April 2022
+ */
+
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <stdbool.h>
+
+/** \brief highest order of the matrices with batched kernels specialized for their order */
+#define  SPECIALIZED_MAX_ORDER  16
+
+/** \brief variants of the kernels, by instruction set */
+enum KernelVariant { KERNEL_SCALAR, KERNEL_AVX2, KERNEL_AVX512, NUMBER_OF_KERNELS };
+
+/** \brief names of the variants of the kernels */
+extern const char * kernelNames[NUMBER_OF_KERNELS];
+
+/** \brief type of the kernels of the trailing matrix update */
+typedef void (*UpdateKernel) (double * matrix, int row_length, int first_row, int last_row,
+                              int panel, int panel_end, int tile, int tile_end);
+
+/**
+ *  \brief Find whether the processor supports a variant of the kernels.
+ *
+ *  \param variant variant of the kernels (enum KernelVariant)
+ *
+ *  \return true if the variant can be used
+ */
+extern bool kernelSupported(int variant);
+
+
+/**
+ *  \brief Find the variant of the kernels with the widest vectors supported by the processor (scalar, AVX2 or AVX-512).
+ *
+ *  \return variant of the kernels (enum KernelVariant)
+ */
+extern int fastestKernel();
+
+
+/**
+ *  \brief Update a tile of the trailing matrix with the rows of a panel.
+ *
+ *  For each row k of the tile, matrix[k][j] -= matrix[k][l] * matrix[l][j], for every column l of the panel.
+ *  The rows must be aligned and padded to ROW_PADDING coefficients, since the kernels work up to the padded end of the tile.
+ *
+ *  There is a kernel for each variant, indexed by enum KernelVariant.
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param matrix pointer to the start of the matrix
+ *  \param row_length number of coefficients of a row, padding included
+ *  \param first_row first row of the tile
+ *  \param last_row row after the last row of the tile
+ *  \param panel first column of the panel
+ *  \param panel_end column after the last column of the panel
+ *  \param tile first column of the tile
+ *  \param tile_end column after the last column of the tile
+ */
+extern const UpdateKernel updateKernels[NUMBER_OF_KERNELS];
+
+
+/**
+ *  \brief Compute the determinants of a batch of small matrices.
+ *
+ *  The vector kernels interleave a group of matrices, one per lane, and eliminate them in lockstep, with partial pivoting.
+ *  The kernel is looked up by the order of the matrices, in a table with a kernel specialized for each small order.
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param variant variant of the kernels (enum KernelVariant)
+ *  \param matrices pointer to the first matrix of the batch (the matrices are stored one after the other, row by row)
+ *  \param order_of_matrix order of the matrices
+ *  \param number_of_matrices number of matrices of the batch
+ *  \param determinants pointer to the determinant of the first matrix of the batch
+ */
+extern void determinantBatch (int variant, const double * matrices, int order_of_matrix, int number_of_matrices,
+                              double * determinants);
+
+
+/**
+ *  \brief Compute the determinants of a batch of small matrices, with the generic kernel of the variant.
+ *
+ *  The kernel that takes any order (the one of the orders above SPECIALIZED_MAX_ORDER) is used whatever the order of
+ *  the matrices, so the kernels specialized for each order can be benchmarked against it (autotune -b).
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param variant variant of the kernels (enum KernelVariant)
+ *  \param matrices pointer to the first matrix of the batch (the matrices are stored one after the other, row by row)
+ *  \param order_of_matrix order of the matrices
+ *  \param number_of_matrices number of matrices of the batch
+ *  \param determinants pointer to the determinant of the first matrix of the batch
+ */
+extern void determinantBatchGeneric (int variant, const double * matrices, int order_of_matrix, int number_of_matrices,
+                                     double * determinants);
+
+
+#endif /* KERNELS_H */
@@ -0,0 +1,701 @@
+/**
+ *  \file outofcore.c (implementation file)
+ *
+ *  \brief Problem name: Compute Matrix Determinant.
+ *
+ *  In this file the function to compute the determinant of a matrix larger than the memory budget is implemented.
+ *  Synchronization based on monitors.
+ *  Both threads and the monitor are implemented using the pthread library which enables the creation of a
+ *  monitor of the Lampson / Redell type.
+ *
+ *  The matrix is split in slabs of T columns, T given by the memory budget. The input file, mapped in memory, is read
+ *  a block of T rows at a time and each square tile of the block is written to its slab in a scratch file, so a slab
+ *  is stored row by row, T coefficients per row, and its rows from any row down are contiguous in the file.
+ *  Step k of the right-looking blocked LU decomposition with partial pivoting decomposes panel k (slab k) and updates
+ *  the slabs to its right, one at a time: the rows of the slab from the diagonal down are read, the row swaps of the
+ *  panel applied, the T rows of U solved and the rest updated, and the rows below the ones of U are written back.
+ *  The rows of U are not needed for the determinant, so they are never written back, and the columns to the left of
+ *  the panel are never read again. The next panel is the first slab to the right of the panel: it is updated last, so
+ *  it stays in memory, and the first slabs of the next step are read while it is decomposed.
+ *
+ *  Only the work buffer (the panel and the slab being updated, side by side, so the trailing update is done by the
+ *  kernels of kernels.c) and two slab buffers are in memory: 4 n T coefficients. One thread reads and writes the
+ *  slabs, in the order of its requests, so the slab after the next one is read while a slab is updated; the updates of
+ *  the slab (and of the panel, while it is decomposed) are split in blocks of LU_PANEL rows, shared by the threads.
+ *
+ *  Definition of the operations carried out by the main thread:
+ *     \li slabColumns
+ *     \li determinantOutOfCore.
+ *
+ *  \author Diogo Filipe Amaral Carvalho - 92969 - April 2022
+ *  \author Rafael Ferreira Baptista - 93367 - April 2022
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <limits.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+#include "kernels.h"
+#include "tuning.h"
+#include "outofcore.h"
+#include "probConst.h"
+
+/** \brief number of read and write requests that may be waiting for the thread of the scratch file */
+#define  IO_QUEUE  8
+
+/** \brief struct with a request to read or write a part of a slab */
+struct IORequest {
+   bool write;                      /* write the buffer to the scratch file (otherwise read it) */
+   double * buffer;                 /* coefficients */
+   size_t bytes;                    /* number of bytes */
+   off_t offset;                    /* offset in the scratch file */
+};
+
+/** \brief return status of the threads: the updaters, the thread of the scratch file and the main thread */
+static int * statusThreads;
+
+/** \brief number of threads that update the slabs */
+static int number_of_updaters;
+
+/** \brief scratch file */
+static int scratch;
+
+/** \brief work buffer: the panel, in the first T columns of each row, and the slab being updated, in the next T */
+static double * work;
+
+/** \brief number of coefficients of a row of the work buffer */
+static int work_length;
+
+/** \brief kernel and tile width of the updates, chosen for the order of the matrix */
+static struct Tuning tuning;
+
+/** \brief update being shared by the updaters: rows, columns of the panel and columns updated */
+static int next_row, last_row, panel_first, panel_end, tile_first, tile_end;
+
+/** \brief number of blocks of rows being updated */
+static int running;
+
+/** \brief requests to the thread of the scratch file (a circular queue) */
+static struct IORequest requests[IO_QUEUE];
+
+/** \brief number of requests made and done */
+static long requests_made, requests_done;
+
+/** \brief bytes read from and written to the scratch file */
+static double bytes_read, bytes_written;
+
+/** \brief the decomposition is over */
+static bool finished;
+
+/** \brief locking flag which warrants mutual exclusion inside the monitor */
+static pthread_mutex_t accessOC = PTHREAD_MUTEX_INITIALIZER;
+
+/** \brief threads synchronization point when the state of the decomposition changes */
+static pthread_cond_t changed = PTHREAD_COND_INITIALIZER;
+
+/**
+ *  \brief Enter the monitor.
+ *
+ *  Internal monitor operation.
+ *
+ *  \param threadId thread identification
+ */
+static void enterMonitor (int threadId)
+{
+  if ((statusThreads[threadId] = pthread_mutex_lock (&accessOC)) != 0)                            /* enter monitor */
+     { errno = statusThreads[threadId];                                                     /* save error in errno */
+       perror ("error on entering monitor(OC)");
+       statusThreads[threadId] = EXIT_FAILURE;
+       pthread_exit (&statusThreads[threadId]);
+     }
+}
+
+/**
+ *  \brief Wait for a change of the state of the decomposition.
+ *
+ *  Internal monitor operation.
+ *
+ *  \param threadId thread identification
+ */
+static void waitChange (int threadId)
+{
+  if ((statusThreads[threadId] = pthread_cond_wait (&changed, &accessOC)) != 0)          /* wait for a change */
+     { errno = statusThreads[threadId];                                                     /* save error in errno */
+       perror ("error on waiting in changed");
+       statusThreads[threadId] = EXIT_FAILURE;
+       pthread_exit (&statusThreads[threadId]);
+     }
+}
+
+/**
+ *  \brief Let the other threads know that the state of the decomposition changed.
+ *
+ *  Internal monitor operation.
+ *
+ *  \param threadId thread identification
+ */
+static void signalChange (int threadId)
+{
+  if ((statusThreads[threadId] = pthread_cond_broadcast (&changed)) != 0)        /* let the threads know the change */
+     { errno = statusThreads[threadId];                                                     /* save error in errno */
+       perror ("error on broadcasting in changed");
+       statusThreads[threadId] = EXIT_FAILURE;
+       pthread_exit (&statusThreads[threadId]);
+     }
+}
+
+/**
+ *  \brief Let the other threads know that the state of the decomposition changed and exit the monitor.
+ *
+ *  Internal monitor operation.
+ *
+ *  \param threadId thread identification
+ */
+static void exitMonitor (int threadId)
+{
+  signalChange (threadId);
+
+  if ((statusThreads[threadId] = pthread_mutex_unlock (&accessOC)) != 0)                          /* exit monitor */
+     { errno = statusThreads[threadId];                                                     /* save error in errno */
+       perror ("error on exiting monitor(OC)");
+       statusThreads[threadId] = EXIT_FAILURE;
+       pthread_exit (&statusThreads[threadId]);
+     }
+}
+
+/**
+ *  \brief Update rows of the work buffer with columns of the panel, shared by the updaters.
+ *
+ *  Operation carried out by the main thread, which waits for the update to be done.
+ *
+ *  \param first first row
+ *  \param last row after the last row
+ *  \param panel first column of the panel
+ *  \param panel_last column after the last column of the panel
+ *  \param tile first column to update
+ *  \param tile_last column after the last column to update
+ */
+static void runUpdate (int first, int last, int panel, int panel_last, int tile, int tile_last)
+{
+  int mainId = number_of_updaters + 1;
+
+  if (first >= last)
+     return;
+
+  enterMonitor (mainId);
+
+  next_row = first;
+  last_row = last;
+  panel_first = panel;
+  panel_end = panel_last;
+  tile_first = tile;
+  tile_end = tile_last;
+  signalChange (mainId);                                                                  /* let the updaters know */
+
+  while ((next_row < last_row) || (running > 0))                                    /* wait for the update */
+    waitChange (mainId);
+
+  exitMonitor (mainId);
+}
+
+/**
+ *  \brief Make a request to the thread of the scratch file.
+ *
+ *  Operation carried out by the main thread.
+ *
+ *  \param write write the buffer to the scratch file (otherwise read it)
+ *  \param buffer coefficients
+ *  \param bytes number of bytes
+ *  \param offset offset in the scratch file
+ *
+ *  \return ticket of the request
+ */
+static long makeRequest (bool write, double * buffer, size_t bytes, off_t offset)
+{
+  int mainId = number_of_updaters + 1;
+  long ticket;
+
+  enterMonitor (mainId);
+
+  while (requests_made - requests_done >= IO_QUEUE)                                  /* wait for room in the queue */
+    waitChange (mainId);
+
+  ticket = requests_made;
+  requests[ticket % IO_QUEUE] = (struct IORequest) { write, buffer, bytes, offset };
+  requests_made += 1;
+
+  exitMonitor (mainId);
+
+  return ticket;
+}
+
+/**
+ *  \brief Wait for a request to the thread of the scratch file to be done.
+ *
+ *  Operation carried out by the main thread.
+ *
+ *  \param ticket ticket of the request (nothing to wait for if negative)
+ *
+ *  \return time spent waiting, in seconds
+ */
+static double waitRequest (long ticket)
+{
+  int mainId = number_of_updaters + 1;
+  struct timespec start, finish;
+
+  clock_gettime (CLOCK_MONOTONIC_RAW, &start);
+  enterMonitor (mainId);
+
+  while (requests_done <= ticket)
+    waitChange (mainId);
+
+  exitMonitor (mainId);
+  clock_gettime (CLOCK_MONOTONIC_RAW, &finish);
+
+  return (finish.tv_sec - start.tv_sec) + (finish.tv_nsec - start.tv_nsec) / 1000000000.0;
+}
+
+/**
+ *  \brief Function updater.
+ *
+ *  Its role is to get blocks of LU_PANEL rows of the update being shared and update them with the kernel chosen for
+ *  the order of the matrix (tuning.c), LU_PANEL columns of the panel and a tile of columns to update at a time.
+ *
+ *  \param par pointer to application defined thread identification
+ */
+static void * updater (void * par)
+{
+  int id = *((int *) par);
+
+  enterMonitor (id);
+
+  while (true)
+  { while ((next_row >= last_row) && !finished)                                    /* wait for rows to update */
+      waitChange (id);
+    if (next_row >= last_row)
+       break;
+
+    int first = next_row, last = (next_row + LU_PANEL < last_row) ? next_row + LU_PANEL : last_row;
+    int panel = panel_first, panel_last = panel_end, tile = tile_first, tile_last = tile_end;
+    next_row = last;
+    running += 1;
+
+    exitMonitor (id);
+
+    for (int t = tile; t < tile_last; t += tuning.tile)
+      for (int p = panel; p < panel_last; p += LU_PANEL)
+        updateKernels[tuning.update_kernel] (work, work_length, first, last,
+                                             p, (p + LU_PANEL < panel_last) ? p + LU_PANEL : panel_last,
+                                             t, (t + tuning.tile < tile_last) ? t + tuning.tile : tile_last);
+
+    enterMonitor (id);
+    running -= 1;
+    signalChange (id);
+  }
+
+  exitMonitor (id);
+
+  statusThreads[id] = EXIT_SUCCESS;
+  pthread_exit (&statusThreads[id]);
+}
+
+/**
+ *  \brief Read or write a part of the scratch file, whatever the number of bytes pread and pwrite take at a time.
+ *
+ *  \param request request
+ */
+static void transfer (struct IORequest request)
+{
+  char * buffer = (char *) request.buffer;
+
+  while (request.bytes > 0)
+  { ssize_t done = request.write ? pwrite (scratch, buffer, request.bytes, request.offset)
+                                 : pread (scratch, buffer, request.bytes, request.offset);
+    if (done <= 0)
+       { perror (request.write ? "error on writing the scratch file" : "error on reading the scratch file");
+         exit (EXIT_FAILURE);
+       }
+    buffer += done;
+    request.bytes -= done;
+    request.offset += done;
+  }
+}
+
+/**
+ *  \brief Function of the thread of the scratch file.
+ *
+ *  Its role is to read and write the slabs, in the order of the requests.
+ *
+ *  \param par pointer to application defined thread identification
+ */
+static void * scratchIO (void * par)
+{
+  int id = *((int *) par);
+
+  enterMonitor (id);
+
+  while (true)
+  { while ((requests_done == requests_made) && !finished)                          /* wait for a request */
+      waitChange (id);
+    if (requests_done == requests_made)
+       break;
+
+    struct IORequest request = requests[requests_done % IO_QUEUE];
+
+    exitMonitor (id);
+
+    transfer (request);
+
+    enterMonitor (id);
+    if (request.write)
+       bytes_written += request.bytes;
+    else bytes_read += request.bytes;
+    requests_done += 1;
+    signalChange (id);
+  }
+
+  exitMonitor (id);
+
+  statusThreads[id] = EXIT_SUCCESS;
+  pthread_exit (&statusThreads[id]);
+}
+
+/**
+ *  \brief Find the number of columns of a slab for a matrix and a memory budget.
+ *
+ *  The work buffer and the two slab buffers take 4 T coefficients per row of the matrix.
+ *
+ *  \param order_of_matrix order of the matrix
+ *  \param budget memory budget, in bytes
+ *
+ *  \return number of columns of a slab (a multiple of ROW_PADDING), or 0 if the budget is too small
+ */
+int slabColumns (int order_of_matrix, size_t budget)
+{
+  size_t padded = (order_of_matrix + ROW_PADDING - 1) / ROW_PADDING * ROW_PADDING;
+  size_t columns = budget / (4 * padded * sizeof (double)) / ROW_PADDING * ROW_PADDING;
+
+  return (int) ((columns < padded) ? columns : padded);
+}
+
+/**
+ *  \brief Move to the next slab update of the decomposition.
+ *
+ *  The slabs to the right of panel k are updated from slab k+2 on, and slab k+1 (the next panel) last.
+ *
+ *  \param number_of_slabs number of slabs
+ *  \param k step (panel) of the update
+ *  \param p position of the update in its step
+ *
+ *  \return true if there is a next update
+ */
+static bool nextUpdate (int number_of_slabs, int * k, int * p)
+{
+  *p += 1;
+  if (*p >= number_of_slabs - 1 - *k) {
+      *k += 1;
+      *p = 0;
+  }
+  return (*k < number_of_slabs - 1);
+}
+
+/**
+ *  \brief Find the slab of an update of the decomposition.
+ */
+static int slabOf (int number_of_slabs, int k, int p)
+{
+  return (p < number_of_slabs - 2 - k) ? k + 2 + p : k + 1;
+}
+
+/**
+ *  \brief Compute the determinant of a matrix out of core.
+ *
+ *  Operation carried out by the main thread, which creates the threads that update the slabs and the thread that
+ *  reads and writes them, decomposes the panels and applies their row swaps and rows of U to the slabs.
+ *
+ *  \param matrix pointer to the matrix (read only, usually in the file mapped in memory)
+ *  \param order_of_matrix order of the matrix
+ *  \param row_length number of coefficients of a row of the matrix, padding included
+ *  \param budget memory budget, in bytes
+ *  \param number_of_threads number of threads that update the slabs
+ *  \param directory directory of the scratch file
+ *  \param determinant pointer to a double to store the mantissa of the determinant
+ *  \param exponent pointer to an int to store the binary exponent of the determinant
+ */
+void determinantOutOfCore (const double * matrix, int order_of_matrix, int row_length, size_t budget,
+                           int number_of_threads, const char * directory, double * determinant, int * exponent)
+{
+    int n = order_of_matrix;
+    int T = slabColumns(n, budget);
+    int number_of_slabs = (n + T - 1) / T;
+    size_t rows = (size_t) number_of_slabs * T;         // rows of a slab in the scratch file (n, padded to T)
+    double sign = 1.0, io_wait = 0.0;
+
+    /* create the scratch file, removed as soon as it is closed */
+
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/computeDet.XXXXXX", directory);
+    scratch = mkstemp(path);
+    if (scratch == -1) {
+        perror("error on creating the scratch file");
+        exit(EXIT_FAILURE);
+    }
+    unlink(path);
+
+    /* buffers: the work buffer (panel and slab side by side) and two slab buffers */
+
+    work_length = 2 * T;
+    work = aligned_alloc(ROW_PADDING * sizeof(double), rows * work_length * sizeof(double));
+    double * slabs[2];
+    for (int b = 0; b < 2; b++)
+        slabs[b] = aligned_alloc(ROW_PADDING * sizeof(double), rows * T * sizeof(double));
+    int * pivots = malloc(T * sizeof(int));
+    if (work == NULL || slabs[0] == NULL || slabs[1] == NULL) {
+        fprintf(stderr, "error on allocating the buffers of the out-of-core decomposition\n");
+        exit(EXIT_FAILURE);
+    }
+    memset(work, 0, rows * work_length * sizeof(double));
+    tuning = tuningFor(n);
+
+    /* generate the updaters and the thread of the scratch file */
+
+    number_of_updaters = number_of_threads;
+    statusThreads = malloc((number_of_updaters + 2) * sizeof(int));
+    pthread_t tIdThreads[number_of_updaters + 1];
+    int threads[number_of_updaters + 1];
+    next_row = last_row = 0;
+    running = 0;
+    requests_made = requests_done = 0;
+    bytes_read = bytes_written = 0;
+    finished = false;
+
+    for (int i = 0; i <= number_of_updaters; i++) {
+        threads[i] = i;
+        if (pthread_create(&tIdThreads[i], NULL, (i < number_of_updaters) ? updater : scratchIO, &threads[i]) != 0) {
+            perror("error on creating the threads of the out-of-core decomposition");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    /* copy the matrix to the scratch file, a block of T rows at a time, split in tiles (slab 0 goes to the panel) */
+
+    long tickets[2] = {-1, -1};     // last request on each slab buffer
+    int b = 0;
+    long page = sysconf(_SC_PAGESIZE);
+
+    for (int I = 0; I < number_of_slabs; I++) {
+        int first = I * T;
+        int height = (n - first < T) ? n - first : T;
+
+        // The next block of rows is read from the input while this one is copied
+        if (I + 1 < number_of_slabs) {
+            int next_height = (n - first - T < T) ? n - first - T : T;
+            uintptr_t next = (uintptr_t) (matrix + (size_t) (first + T) * row_length) & ~(uintptr_t) (page - 1);
+            madvise((void *) next, (size_t) next_height * row_length * sizeof(double) + page, MADV_WILLNEED);
+        }
+
+        for (int J = 0; J < number_of_slabs; J++) {
+            int width = (n - J * T < T) ? n - J * T : T;
+
+            if (J == 0) {
+                for (int r = 0; r < height; r++)
+                    memcpy(work + (size_t) (first + r) * work_length, matrix + (size_t) (first + r) * row_length, width * sizeof(double));
+                continue;
+            }
+
+            double * tile = slabs[b];
+            io_wait += waitRequest(tickets[b]);
+            for (int r = 0; r < height; r++) {
+                memcpy(tile + (size_t) r * T, matrix + (size_t) (first + r) * row_length + (size_t) J * T, width * sizeof(double));
+                memset(tile + (size_t) r * T + width, 0, (T - width) * sizeof(double));
+            }
+            tickets[b] = makeRequest(true, tile, (size_t) height * T * sizeof(double), (off_t) ((J * rows + first) * T * sizeof(double)));
+            b = 1 - b;
+        }
+
+        // The block is no longer needed in memory (the pages of the file are dropped, not written)
+        uintptr_t start = (uintptr_t) (matrix + (size_t) first * row_length) & ~(uintptr_t) (page - 1);
+        uintptr_t end = (uintptr_t) (matrix + (size_t) (first + height) * row_length) & ~(uintptr_t) (page - 1);
+        if (end > start)
+            madvise((void *) start, end - start, MADV_DONTNEED);
+    }
+
+    /* decompose the matrix, a panel at a time */
+
+    // The first two slab updates are read ahead (after the copy, as the requests are done in order)
+    int read_k = 0, read_p = 0;                 // next slab update to read
+    bool reading = (number_of_slabs > 1);
+    for (int u = 0; u < 2 && reading; u++) {
+        int J = slabOf(number_of_slabs, read_k, read_p);
+        tickets[u] = makeRequest(false, slabs[u], (n - (size_t) read_k * T) * T * sizeof(double),
+                                 (off_t) ((J * rows + (size_t) read_k * T) * T * sizeof(double)));
+        reading = nextUpdate(number_of_slabs, &read_k, &read_p);
+    }
+
+    *determinant = 1.0;
+    *exponent = 0;
+    long update = 0;                            // number of slab updates done
+
+    for (int k = 0; k < number_of_slabs && *determinant != 0; k++) {
+        int height = n - k * T;                 // rows from the diagonal down
+        int width = (height < T) ? height : T;  // columns of the panel
+
+        /* Decompose the panel, LU_PANEL columns at a time, in the first T columns of the work buffer */
+        for (int sp = 0; sp < width && *determinant != 0; sp += LU_PANEL) {
+            int sp_end = (sp + LU_PANEL < width) ? sp + LU_PANEL : width;
+
+            for (int l = sp; l < sp_end; l++) {
+                double * row_l = work + (size_t) l * work_length;
+
+                // The pivot is the coefficient of column l, on or below the diagonal, with the largest absolute value
+                int pivot = l;
+                for (int r = l+1; r < height; r++)
+                    if (fabs(work[(size_t) r * work_length + l]) > fabs(work[(size_t) pivot * work_length + l]))
+                        pivot = r;
+
+                if (work[(size_t) pivot * work_length + l] == 0.0) {
+                    *determinant = 0;
+                    break;
+                }
+
+                // Swap rows in the columns of the panel, which changes the sign of the determinant
+                pivots[l] = pivot;
+                if (pivot != l) {
+                    double * row_pivot = work + (size_t) pivot * work_length;
+                    for (int j = 0; j < T; j++) {
+                        double temp = row_l[j];
+                        row_l[j] = row_pivot[j];
+                        row_pivot[j] = temp;
+                    }
+                    sign = -sign;
+                }
+
+                int scale;
+                *determinant = frexp(*determinant * row_l[l], &scale);
+                *exponent += scale;
+
+                // Save the multipliers in column l and update the rest of the LU_PANEL columns
+                for (int r = l+1; r < height; r++) {
+                    double * row_r = work + (size_t) r * work_length;
+                    double term = row_r[l] / row_l[l];
+                    row_r[l] = term;
+                    for (int j = l+1; j < sp_end; j++)
+                        row_r[j] -= term * row_l[j];
+                }
+            }
+            if (*determinant == 0)
+                break;
+
+            // Rows of U to the right of the LU_PANEL columns, then the update of the rest of the panel by the updaters
+            for (int l = sp; l < sp_end; l++) {
+                double * row_l = work + (size_t) l * work_length;
+                for (int r = l+1; r < sp_end; r++) {
+                    double * row_r = work + (size_t) r * work_length;
+                    double term = row_r[l];
+                    for (int j = sp_end; j < T; j++)
+                        row_r[j] -= term * row_l[j];
+                }
+            }
+            runUpdate(sp_end, height, sp, sp_end, sp_end, T);
+        }
+        if (*determinant == 0)
+            break;
+
+        /* Update the slabs to the right of the panel: slab k+2 on, and the next panel last */
+        for (int p = 0; p < number_of_slabs - 1 - k; p++, update++) {
+            int J = slabOf(number_of_slabs, k, p);
+            double * slab = slabs[update % 2];
+
+            io_wait += waitRequest(tickets[update % 2]);
+            for (int r = 0; r < height; r++)
+                memcpy(work + (size_t) r * work_length + T, slab + (size_t) r * T, T * sizeof(double));
+
+            // Swap rows, in the order of the panel
+            for (int l = 0; l < T; l++) {
+                if (pivots[l] != l) {
+                    double * row_l = work + (size_t) l * work_length + T;
+                    double * row_pivot = work + (size_t) pivots[l] * work_length + T;
+                    for (int j = 0; j < T; j++) {
+                        double temp = row_l[j];
+                        row_l[j] = row_pivot[j];
+                        row_pivot[j] = temp;
+                    }
+                }
+            }
+
+            // Rows of U, LU_PANEL rows at a time, then the update of the rows below them by the updaters
+            for (int lb = 0; lb < T; lb += LU_PANEL) {
+                int lb_end = (lb + LU_PANEL < T) ? lb + LU_PANEL : T;
+                for (int l = lb; l < lb_end; l++) {
+                    double * row_l = work + (size_t) l * work_length;
+                    for (int r = l+1; r < lb_end; r++) {
+                        double * row_r = work + (size_t) r * work_length;
+                        double term = row_r[l];
+                        for (int j = T; j < work_length; j++)
+                            row_r[j] -= term * row_l[j];
+                    }
+                }
+                updateKernels[tuning.update_kernel](work, work_length, lb_end, T, lb, lb_end, T, work_length);
+            }
+            runUpdate(T, height, 0, T, T, work_length);
+
+            if (J != k + 1) {
+                // Write back the rows below the ones of U
+                for (int r = T; r < height; r++)
+                    memcpy(slab + (size_t) r * T, work + (size_t) r * work_length + T, T * sizeof(double));
+                tickets[update % 2] = makeRequest(true, slab + (size_t) T * T, (size_t) (height - T) * T * sizeof(double),
+                                                  (off_t) ((J * rows + (size_t) k * T + T) * T * sizeof(double)));
+            } else {
+                // The next panel stays in memory, moved to the first T columns
+                for (int r = T; r < height; r++)
+                    memcpy(work + (size_t) (r - T) * work_length, work + (size_t) r * work_length + T, T * sizeof(double));
+            }
+
+            // Read the slab update after the next one into the slab buffer, after its rows are written
+            if (reading) {
+                int read_J = slabOf(number_of_slabs, read_k, read_p);
+                tickets[update % 2] = makeRequest(false, slab, (n - (size_t) read_k * T) * T * sizeof(double),
+                                                  (off_t) ((read_J * rows + (size_t) read_k * T) * T * sizeof(double)));
+                reading = nextUpdate(number_of_slabs, &read_k, &read_p);
+            }
+        }
+    }
+    if (*determinant != 0)
+        *determinant *= sign;
+
+    /* wait for the last requests and the termination of the threads */
+
+    for (int u = 0; u < 2; u++)
+        io_wait += waitRequest(tickets[u]);
+
+    enterMonitor(number_of_updaters + 1);
+    finished = true;
+    exitMonitor(number_of_updaters + 1);
+
+    for (int i = 0; i <= number_of_updaters; i++) {
+        int * status_p;
+        if (pthread_join(tIdThreads[i], (void *) &status_p) != 0) {
+            perror("error on waiting for the threads of the out-of-core decomposition");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    printf("Out-of-core decomposition = %d slabs of %d columns, %.2f GiB written, %.2f GiB read, %.3f s waiting for the scratch file \n",
+           number_of_slabs, T, bytes_written / (1 << 30), bytes_read / (1 << 30), io_wait);
+
+    close(scratch);
+    free(work);
+    free(slabs[0]);
+    free(slabs[1]);
+    free(pivots);
+    free(statusThreads);
+}
@@ -0,0 +1,54 @@
+/**
+ *  \file outofcore.h (interface file)
+ *
+ *  \brief Problem name: Compute Matrix Determinant.
+ *
+ *  In this file the function to compute the determinant of a matrix larger than the memory budget is defined.
+ *
+ *  The matrix is copied from the input file, in slabs of columns, to a scratch file, and decomposed by a right-looking
+ *  blocked LU decomposition with partial pivoting that only keeps a panel and two slabs in memory.
+ *
+ *  Definition of the operations carried out by the main thread:
+ *     \li slabColumns
+ *     \li determinantOutOfCore.
+ *
+ *  \author Diogo Filipe Amaral Carvalho - 92969 - April 2022
+ *  \author Rafael Ferreira Baptista - 93367 - April 2022
+ */
+
+#ifndef OUTOFCORE_H
+#define OUTOFCORE_H
+
+#include <stddef.h>
+
+/**
+ *  \brief Find the number of columns of a slab for a matrix and a memory budget.
+ *
+ *  \param order_of_matrix order of the matrix
+ *  \param budget memory budget, in bytes
+ *
+ *  \return number of columns of a slab (a multiple of ROW_PADDING), or 0 if the budget is too small
+ */
+extern int slabColumns (int order_of_matrix, size_t budget);
+
+
+/**
+ *  \brief Compute the determinant of a matrix out of core.
+ *
+ *  Operation carried out by the main thread, which creates the threads that update the slabs and the thread that
+ *  reads and writes them.
+ *
+ *  \param matrix pointer to the matrix (read only, usually in the file mapped in memory)
+ *  \param order_of_matrix order of the matrix
+ *  \param row_length number of coefficients of a row of the matrix, padding included
+ *  \param budget memory budget, in bytes
+ *  \param number_of_threads number of threads that update the slabs
+ *  \param directory directory of the scratch file
+ *  \param determinant pointer to a double to store the mantissa of the determinant
+ *  \param exponent pointer to an int to store the binary exponent of the determinant
+ */
+extern void determinantOutOfCore (const double * matrix, int order_of_matrix, int row_length, size_t budget,
+                                  int number_of_threads, const char * directory, double * determinant, int * exponent);
+
+
+#endif /* OUTOFCORE_H */
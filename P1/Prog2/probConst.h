@@ -14,8 +14,41 @@
 
 /* Generic parameters */
 
-/** \brief data transfer region nominal capacity (in number of values that can be stored) in the FIFO */
-#define  K            10
+/** \brief number of columns of a panel of the blocked LU decomposition (a panel block of LU_PANEL x LU_PANEL coefficients fits in the L1 cache) */
+#define  LU_PANEL     64
+
+/** \brief number of columns of a tile of the trailing matrix update, without a tuning profile (LU_PANEL x LU_TILE coefficients of the upper triangular matrix fit in the L2 cache) */
+#define  LU_TILE      256
+
+/** \brief the rows of a matrix are aligned and padded to a multiple of this number of coefficients (two AVX-512 vectors) */
+#define  ROW_PADDING  16
+
+/** \brief a matrix is decomposed as a band matrix when its lower and upper bandwidths add up to less than its order divided by this */
+#define  BAND_FRACTION  8
+
+/** \brief matrices up to this order are processed in batches, by the batched kernels, instead of one at a time */
+#define  BATCH_MAX_ORDER     32
+
+/** \brief number of matrices of a batch (handed out to a worker at a time) */
+#define  MATRICES_PER_BATCH  256
+
+/** \brief number of matrices handed out and not written yet, in the streaming mode (at least MATRICES_PER_BATCH) */
+#define  STREAM_WINDOW       (16 * MATRICES_PER_BATCH)
+
+/** \brief number of consecutive matrices handed out at a time in the incremental mode (the first one is always factored) */
+#define  INCREMENTAL_RUN            32
+
+/** \brief a matrix is updated from the last one factored when they differ in less than its order divided by this rows or columns */
+#define  INCREMENTAL_RANK_FRACTION  16
+
+/** \brief the incremental update is taken as unstable below this ratio (of the pivots, or of a determinant to its Hadamard bound) */
+#define  INCREMENTAL_MIN_RATIO      1e-8
+
+/** \brief number of files mapped in memory at once in the batch mode, unless another one is given (option -b) */
+#define  BATCH_OPEN_FILES    4
+
+/** \brief tuning profile loaded by computeDet and written by autotune, unless another one is given (option -p) */
+#define  DEFAULT_PROFILE     "computeDet.profile"
 
 
 #endif /* PROBCONST_H_ */
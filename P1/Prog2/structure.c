@@ -0,0 +1,206 @@
+/**
+ *  \file structure.c (implementation file)
+ *
+ *  \brief Problem name: Compute Matrix Determinant.
+ *
+ *  In this file the functions to find the structure of a matrix and to decompose the matrices with a structure
+ *  cheaper than the dense blocked LU decomposition are implemented.
+ *
+ *  The probe finds the lower and upper bandwidths of the matrix, scanning each row from its ends up to the band found
+ *  so far, and whether the matrix is symmetric with a positive diagonal; it stops as soon as the band is too wide and
+ *  the matrix is not symmetric, so a dense matrix is usually given away by its first rows.
+ *  A symmetric positive definite matrix is decomposed without pivoting, like the blocked LU decomposition of
+ *  det_factor (det.c), but only the lower triangle of the trailing matrix is updated: as U = D L^T, the rows of U to
+ *  the right of a panel are the columns of the panel below it, scaled by the diagonal. That is half of the operations
+ *  of the LU decomposition, as with the Cholesky decomposition, and the determinant is the product of the diagonal.
+ *
+ *  Definition of the operations carried out by the worker threads:
+ *     \li probeStructure
+ *     \li decomposeBanded
+ *     \li decomposeSymmetric.
+ *
+ *  \author Diogo Filipe Amaral Carvalho - 92969 - April 2022
+ *  \author Rafael Ferreira Baptista - 93367 - April 2022
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "kernels.h"
+#include "tuning.h"
+#include "structure.h"
+#include "probConst.h"
+
+/**
+ *  \brief Find the structure of a matrix.
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param matrix pointer to the matrix
+ *  \param order_of_matrix order of the matrix
+ *  \param row_length number of coefficients of a row of the matrix, padding included
+ *  \param lower pointer to an int to store the lower bandwidth of the matrix (only set for triangular or band matrices)
+ *  \param upper pointer to an int to store the upper bandwidth of the matrix (only set for triangular or band matrices)
+ *
+ *  \return structure of the matrix (STRUCTURE_SPD if the matrix is symmetric with a positive diagonal: it may not be
+ *          positive definite)
+ */
+int probeStructure(const double * matrix, int order_of_matrix, int row_length, int * lower, int * upper) {
+
+    int band_limit = order_of_matrix / BAND_FRACTION;   // the bandwidths of a band matrix add up to less than this
+    bool symmetric = true;
+
+    *lower = *upper = 0;
+
+    for (int i = 0; i < order_of_matrix; i++) {
+        const double * row = matrix + (size_t) i * row_length;
+
+        // Coefficients out of the band found so far (the first one from each end widens it)
+        for (int j = 0; j < i - *lower; j++)
+            if (row[j] != 0) {
+                *lower = i - j;
+                break;
+            }
+        for (int j = order_of_matrix - 1; j > i + *upper; j--)
+            if (row[j] != 0) {
+                *upper = j - i;
+                break;
+            }
+
+        // Symmetry, against the rows above
+        for (int j = 0; j < i && symmetric; j++)
+            symmetric = (row[j] == matrix[(size_t) j * row_length + i]);
+        symmetric = symmetric && (row[i] > 0);
+
+        if (!symmetric && *lower > 0 && *upper > 0 && *lower + *upper >= band_limit)
+            return STRUCTURE_DENSE;
+    }
+
+    if (*lower == 0 || *upper == 0)
+        return STRUCTURE_TRIANGULAR;
+    if (*lower + *upper < band_limit)
+        return STRUCTURE_BANDED;
+    return symmetric ? STRUCTURE_SPD : STRUCTURE_DENSE;
+}
+
+
+/**
+ *  \brief Decompose a band matrix, with partial pivoting.
+ *
+ *  The elimination of each column only goes through the rows of the lower band and the columns of the upper band
+ *  widened by the lower one, where the row swaps may move coefficients, so it takes O(n lower (lower + upper)).
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param matrix pointer to the matrix (its coefficients are overwritten, the diagonal of U is left on its diagonal)
+ *  \param order_of_matrix order of the matrix
+ *  \param row_length number of coefficients of a row of the matrix, padding included
+ *  \param lower lower bandwidth of the matrix
+ *  \param upper upper bandwidth of the matrix
+ *
+ *  \return sign of the determinant given by the row swaps (0 if the matrix is singular)
+ */
+double decomposeBanded(double * matrix, int order_of_matrix, int row_length, int lower, int upper) {
+
+    double sign = 1.0;
+
+    for (int l = 0; l < order_of_matrix; l++) {
+
+        int row_end = (l + lower + 1 < order_of_matrix) ? l + lower + 1 : order_of_matrix;
+        int column_end = (l + lower + upper + 1 < order_of_matrix) ? l + lower + upper + 1 : order_of_matrix;
+
+        // The pivot is the coefficient of column l, in the lower band, with the largest absolute value
+        int pivot = l;
+        for (int k = l+1; k < row_end; k++) {
+            if (fabs(matrix[(size_t) k*row_length + l]) > fabs(matrix[(size_t) pivot*row_length + l]))
+                pivot = k;
+        }
+
+        if (matrix[(size_t) pivot*row_length + l] == 0.0)
+            return 0.0;
+
+        // Swap rows, which changes the sign of the determinant
+        double * row_l = matrix + (size_t) l*row_length;
+        if (pivot != l) {
+            double * row_pivot = matrix + (size_t) pivot*row_length;
+            for (int j = l; j < column_end; j++) {
+                double temp = row_l[j];
+                row_l[j] = row_pivot[j];
+                row_pivot[j] = temp;
+            }
+            sign = -sign;
+        }
+
+        // Eliminate column l from the rows of the lower band
+        for (int k = l+1; k < row_end; k++) {
+            double * row_k = matrix + (size_t) k*row_length;
+            double term = row_k[l] / row_l[l];
+            for (int j = l+1; j < column_end; j++)
+                row_k[j] -= term * row_l[j];
+        }
+    }
+
+    return sign;
+}
+
+
+/**
+ *  \brief Decompose a symmetric matrix that may be positive definite.
+ *
+ *  The matrix is decomposed LU_PANEL columns at a time, without pivoting: the panel is decomposed column by column,
+ *  the rows of U to its right are the columns of the panel below it times the diagonal, and only the tiles of the
+ *  lower triangle of the trailing matrix (and the rest of their diagonal blocks) are updated, by the kernel and with
+ *  the tile width chosen for the order of the matrix (tuning.c). A pivot that is not positive stops the decomposition.
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param matrix pointer to the matrix (its coefficients are overwritten, the diagonal of U is left on its diagonal)
+ *  \param order_of_matrix order of the matrix
+ *  \param row_length number of coefficients of a row of the matrix, padding included
+ *
+ *  \return true if the matrix is positive definite (otherwise the decomposition stops and the matrix is left unusable)
+ */
+bool decomposeSymmetric(double * matrix, int order_of_matrix, int row_length) {
+
+    struct Tuning tuning = tuningFor(order_of_matrix);
+
+    for (int panel = 0; panel < order_of_matrix; panel += LU_PANEL) {
+
+        int panel_end = (panel + LU_PANEL < order_of_matrix) ? panel + LU_PANEL : order_of_matrix;
+
+        /* Decompose the panel, column by column */
+        for (int l = panel; l < panel_end; l++) {
+            double * row_l = matrix + (size_t) l*row_length;
+
+            if (!(row_l[l] > 0))
+                return false;
+
+            // Save the multipliers in column l and update the rest of the panel
+            for (int k = l+1; k < order_of_matrix; k++) {
+                double * row_k = matrix + (size_t) k*row_length;
+                double term = row_k[l] / row_l[l];
+                row_k[l] = term;
+                for (int j = l+1; j < panel_end; j++)
+                    row_k[j] -= term * row_l[j];
+            }
+        }
+
+        /* Rows of U to the right of the panel: U[l][j] = L[j][l] U[l][l] */
+        for (int j = panel_end; j < order_of_matrix; j++) {
+            double * row_j = matrix + (size_t) j*row_length;
+            for (int l = panel; l < panel_end; l++)
+                matrix[(size_t) l*row_length + j] = row_j[l] * matrix[(size_t) l*row_length + l];
+        }
+
+        /* Update the lower triangle of the trailing matrix, a tile of columns at a time, from the row of its diagonal */
+        for (int tile = panel_end; tile < order_of_matrix; tile += tuning.tile) {
+            int tile_end = (tile + tuning.tile < order_of_matrix) ? tile + tuning.tile : order_of_matrix;
+
+            updateKernels[tuning.update_kernel](matrix, row_length, tile, order_of_matrix, panel, panel_end, tile, tile_end);
+        }
+    }
+
+    return true;
+}
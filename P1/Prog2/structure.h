@@ -0,0 +1,81 @@
+/**
+ *  \file structure.h (interface file)
+ *
+ *  \brief Problem name: Compute Matrix Determinant.
+ *
+ *  In this file the functions to find the structure of a matrix and to decompose the matrices with a structure
+ *  cheaper than the dense blocked LU decomposition are defined.
+ *
+ *  The structure of a matrix is found by a probe that looks at its coefficients once at most (O(n^2)) and stops as
+ *  soon as the matrix can only be dense. A triangular matrix needs no decomposition, a band matrix is decomposed in
+ *  O(n b^2) and a symmetric positive definite matrix with half of the operations of the LU decomposition.
+ *
+ *  Definition of the operations carried out by the worker threads:
+ *     \li probeStructure
+ *     \li decomposeBanded
+ *     \li decomposeSymmetric.
+ *
+ *  \author Diogo Filipe Amaral Carvalho - 92969 - April 2022
+ *  \author Rafael Ferreira Baptista - 93367 - April 2022
+ */
+
+#ifndef STRUCTURE_H
+#define STRUCTURE_H
+
+#include <stdbool.h>
+
+/** \brief structures of the matrices, by the way their determinant is computed */
+enum Structure { STRUCTURE_DENSE, STRUCTURE_TRIANGULAR, STRUCTURE_BANDED, STRUCTURE_SPD,
+                 STRUCTURE_BATCHED,         /* small matrices, computed by the batched kernels without a probe */
+                 STRUCTURE_INCREMENTAL,     /* updated from the last matrix factored, in the incremental mode */
+                 STRUCTURE_CACHED,          /* found in the deduplication cache */
+                 NUMBER_OF_STRUCTURES };
+
+/**
+ *  \brief Find the structure of a matrix.
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param matrix pointer to the matrix
+ *  \param order_of_matrix order of the matrix
+ *  \param row_length number of coefficients of a row of the matrix, padding included
+ *  \param lower pointer to an int to store the lower bandwidth of the matrix (only set for triangular or band matrices)
+ *  \param upper pointer to an int to store the upper bandwidth of the matrix (only set for triangular or band matrices)
+ *
+ *  \return structure of the matrix (STRUCTURE_SPD if the matrix is symmetric with a positive diagonal: it may not be
+ *          positive definite)
+ */
+extern int probeStructure (const double * matrix, int order_of_matrix, int row_length, int * lower, int * upper);
+
+
+/**
+ *  \brief Decompose a band matrix, with partial pivoting.
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param matrix pointer to the matrix (its coefficients are overwritten, the diagonal of U is left on its diagonal)
+ *  \param order_of_matrix order of the matrix
+ *  \param row_length number of coefficients of a row of the matrix, padding included
+ *  \param lower lower bandwidth of the matrix
+ *  \param upper upper bandwidth of the matrix
+ *
+ *  \return sign of the determinant given by the row swaps (0 if the matrix is singular)
+ */
+extern double decomposeBanded (double * matrix, int order_of_matrix, int row_length, int lower, int upper);
+
+
+/**
+ *  \brief Decompose a symmetric matrix that may be positive definite.
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param matrix pointer to the matrix (its coefficients are overwritten, the diagonal of U is left on its diagonal)
+ *  \param order_of_matrix order of the matrix
+ *  \param row_length number of coefficients of a row of the matrix, padding included
+ *
+ *  \return true if the matrix is positive definite (otherwise the decomposition stops and the matrix is left unusable)
+ */
+extern bool decomposeSymmetric (double * matrix, int order_of_matrix, int row_length);
+
+
+#endif /* STRUCTURE_H */
@@ -0,0 +1,89 @@
+#!/bin/sh
+#
+#  \file sweep.sh
+#
+#  \brief Problem name: Compute Matrix Determinant.
+#
+#  Check harness: runs P1/Prog2/computeDet over several numbers of threads and P2/Prog2/computeDet over several
+#  numbers of ranks on a file written by generate, checks the determinants against its known ones (-c), and prints a
+#  table with the matrices/s, the GFLOP/s, the median and the largest relative error of each run.
+#  It fails (exit status 1) if a run fails, if a determinant has the wrong sign or if an error is above the threshold.
+#
+#  How to run: ./generate -n 64 -m 1024 -c 4 -f known.bin -a known.txt && ./sweep.sh -f known.bin -c known.txt
+#              ./sweep.sh -f known.bin -c known.txt -t "1 2 4 8" -n "2 3 5 9" -e 1e-10
+#  The programs are ./computeDet and ../../P2/Prog2/computeDet, or $P1_DET and $P2_DET; mpiexec is $MPIEXEC.
+#
+#  \author Diogo Filipe Amaral Carvalho - 92969 - April 2022
+#  \author Rafael Ferreira Baptista - 93367 - April 2022
+#
+
+usage() {
+    echo "Synopsis: $(basename "$0") -f file -c answers [-t threads] [-n ranks] [-r threads per rank] [-e threshold]" >&2
+    echo "  -f      --- file of matrices (written by generate)" >&2
+    echo "  -c      --- file with the known determinants (written by generate)" >&2
+    echo "  -t      --- numbers of threads of P1/Prog2/computeDet (\"1 2 4 8\" by default, \"\" to skip it)" >&2
+    echo "  -n      --- numbers of ranks of P2/Prog2/computeDet (\"2 3 5\" by default, \"\" to skip it)" >&2
+    echo "  -r      --- number of threads of each rank of P2/Prog2/computeDet (1 by default)" >&2
+    echo "  -e      --- largest relative error accepted (1e-9 by default)" >&2
+    exit 2
+}
+
+file=""
+answers=""
+threads="1 2 4 8"
+ranks="2 3 5"
+rank_threads=1
+threshold=1e-9
+
+while getopts "f:c:t:n:r:e:h" opt; do
+    case $opt in
+        f) file=$OPTARG ;;
+        c) answers=$OPTARG ;;
+        t) threads=$OPTARG ;;
+        n) ranks=$OPTARG ;;
+        r) rank_threads=$OPTARG ;;
+        e) threshold=$OPTARG ;;
+        *) usage ;;
+    esac
+done
+[ -n "$file" ] && [ -n "$answers" ] || usage
+
+p1=${P1_DET:-./computeDet}
+p2=${P2_DET:-../../P2/Prog2/computeDet}
+mpiexec=${MPIEXEC:-mpiexec}
+output=$(mktemp) || exit 1
+trap 'rm -f "$output"' EXIT
+failed=0
+
+# run: run a program, then print its line of the table and check its results
+run() {
+    name=$1
+    shift
+    "$@" > "$output" 2>&1
+    status=$?
+    if ! awk -v name="$name" -v status="$status" -v threshold="$threshold" '
+        /^Throughput =/              { rate = $3; gflops = $5 }
+        /^Determinants checked/      { checked = 1; wrong = $(NF-4) }
+        /^Relative error:/           { median = $4; sub(",", "", median); largest = $6 }
+        END {
+            if (largest == "") largest = (wrong > 0) ? "inf" : "-"
+            printf "%-24s %12s %10s %10s %10s %6s", name, rate, gflops, median, largest, wrong
+            if (status != 0)             { printf "   FAILED (exit status %d)\n", status; exit 1 }
+            if (!checked)                { printf "   FAILED (no check)\n"; exit 1 }
+            if (wrong > 0)               { printf "   FAILED (wrong signs)\n"; exit 1 }
+            if (largest + 0 > threshold) { printf "   FAILED (error above %s)\n", threshold; exit 1 }
+            printf "\n"
+        }' "$output"; then
+        failed=1
+    fi
+}
+
+printf "%-24s %12s %10s %10s %10s %6s\n" "run" "matrices/s" "GFLOP/s" "median" "max" "signs"
+for t in $threads; do
+    run "P1 $t threads" "$p1" -t "$t" -f "$file" -c "$answers"
+done
+for n in $ranks; do
+    run "P2 $n ranks x $rank_threads" $mpiexec -n "$n" "$p2" -t "$rank_threads" -f "$file" -c "$answers"
+done
+
+exit $failed
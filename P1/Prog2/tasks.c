@@ -0,0 +1,313 @@
+/**
+ *  \file tasks.c (implementation file)
+ *
+ *  \brief Problem name: Compute Matrix Determinant.
+ *
+ *  In this file the functions to share the decomposition of a matrix by a group of threads are implemented.
+ *  Synchronization based on monitors.
+ *  Both threads and the monitor are implemented using the pthread library which enables the creation of a
+ *  monitor of the Lampson / Redell type.
+ *
+ *  Each group of workers has its own monitor, which keeps the state of the blocked LU decomposition of its matrix:
+ *  the number of panels already decomposed and, for each block of LU_PANEL columns, how many panels it was updated by.
+ *  The decomposition of the next panel is handed out first and the updates are handed out from the left, so the
+ *  block of the next panel is updated first and its decomposition overlaps the rest of the trailing matrix update.
+ *
+ *  Definition of the operations carried out by the main thread:
+ *     \li initTaskGroups.
+ *  Definition of the operations carried out by the leader of each group of workers:
+ *     \li startMatrix
+ *     \li finishMatrix
+ *     \li endTasks.
+ *  Definition of the operations carried out by the workers of each group:
+ *     \li getTask
+ *     \li taskDone.
+ *
+ *  \author Diogo Filipe Amaral Carvalho - 92969 - April 2022
+ *  \author Rafael Ferreira Baptista - 93367 - April 2022
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <errno.h>
+
+#include "probConst.h"
+#include "tasks.h"
+
+/** \brief struct with the state of the decomposition of the matrix of a group of workers */
+struct TaskGroup {
+   pthread_mutex_t access;          /* locking flag which warrants mutual exclusion inside the monitor */
+   pthread_cond_t changed;          /* workers synchronization point when there are no tasks ready */
+   bool active;                     /* a matrix is being decomposed */
+   bool end;                        /* there are no more matrices */
+   struct MatrixInfo matrix;        /* matrix being decomposed */
+   int row_length;                  /* number of coefficients of a row of the matrix, padding included */
+   int number_of_blocks;            /* number of blocks of LU_PANEL columns */
+   int * updates;                   /* number of panels each block was updated by */
+   bool * busy;                     /* a task on the block is running */
+   int * pivots;                    /* row swapped with each row of the matrix */
+   int panels_done;                 /* number of panels decomposed */
+   int running;                     /* number of tasks running */
+   int row_swaps;                   /* number of row swaps */
+   bool singular;                   /* a panel had no pivot */
+};
+
+/** \brief consumer threads return status array */
+extern int *statusWorkers;
+
+/** \brief state of each group of workers */
+static struct TaskGroup *groups;
+
+/**
+ *  \brief Create the groups of workers.
+ *
+ *  Operation carried out by the main thread, before the workers are created.
+ *
+ *  \param number_of_groups number of groups of workers
+ */
+void initTaskGroups (int number_of_groups)
+{
+  groups = calloc (number_of_groups, sizeof (struct TaskGroup));
+
+  for (int g = 0; g < number_of_groups; g++) {
+      pthread_mutex_init (&groups[g].access, NULL);
+      pthread_cond_init (&groups[g].changed, NULL);
+  }
+}
+
+/**
+ *  \brief Enter the monitor of a group.
+ *
+ *  Internal monitor operation.
+ *
+ *  \param workerId worker identification
+ *  \param tg group of the worker
+ */
+static void enterMonitor (unsigned int workerId, struct TaskGroup * tg)
+{
+  if ((statusWorkers[workerId] = pthread_mutex_lock (&tg->access)) != 0)                        /* enter monitor */
+     { errno = statusWorkers[workerId];                                                     /* save error in errno */
+       perror ("error on entering monitor(TG)");
+       statusWorkers[workerId] = EXIT_FAILURE;
+       pthread_exit (&statusWorkers[workerId]);
+     }
+}
+
+/**
+ *  \brief Let the workers of a group know that its state changed and exit its monitor.
+ *
+ *  Internal monitor operation.
+ *
+ *  \param workerId worker identification
+ *  \param tg group of the worker
+ */
+static void exitMonitor (unsigned int workerId, struct TaskGroup * tg)
+{
+  if ((statusWorkers[workerId] = pthread_cond_broadcast (&tg->changed)) != 0)  /* let the workers know the change */
+     { errno = statusWorkers[workerId];                                                     /* save error in errno */
+       perror ("error on broadcasting in changed");
+       statusWorkers[workerId] = EXIT_FAILURE;
+       pthread_exit (&statusWorkers[workerId]);
+     }
+
+  if ((statusWorkers[workerId] = pthread_mutex_unlock (&tg->access)) != 0)                       /* exit monitor */
+     { errno = statusWorkers[workerId];                                                     /* save error in errno */
+       perror ("error on exiting monitor(TG)");
+       statusWorkers[workerId] = EXIT_FAILURE;
+       pthread_exit (&statusWorkers[workerId]);
+     }
+}
+
+/**
+ *  \brief Start the decomposition of a matrix by a group.
+ *
+ *  Operation carried out by the leader of the group.
+ *
+ *  \param workerId worker identification
+ *  \param group group identification
+ *  \param matrixinfo matrix to decompose
+ */
+void startMatrix (unsigned int workerId, unsigned int group, struct MatrixInfo matrixinfo)
+{
+  struct TaskGroup * tg = &groups[group];
+  int order_of_matrix = matrixinfo.order_of_matrix;
+
+  enterMonitor (workerId, tg);
+
+  tg->matrix = matrixinfo;
+  tg->row_length = (order_of_matrix + ROW_PADDING - 1) / ROW_PADDING * ROW_PADDING;
+  tg->number_of_blocks = (order_of_matrix + LU_PANEL - 1) / LU_PANEL;
+  tg->updates = calloc (tg->number_of_blocks, sizeof (int));
+  tg->busy = calloc (tg->number_of_blocks, sizeof (bool));
+  tg->pivots = malloc (order_of_matrix * sizeof (int));
+  tg->panels_done = 0;
+  tg->running = 0;
+  tg->row_swaps = 0;
+  tg->singular = false;
+  tg->active = true;
+
+  exitMonitor (workerId, tg);
+}
+
+/**
+ *  \brief Find a task that is ready to run and mark its block as busy.
+ *
+ *  Internal monitor operation.
+ *
+ *  \param tg group of the worker
+ *  \param task task found (type TASK_NONE if there is none)
+ */
+static void findTask (struct TaskGroup * tg, struct Task * task)
+{
+  int next = tg->panels_done;                                                           /* next panel to decompose */
+
+  task->type = TASK_NONE;
+  if (!tg->active || tg->singular)
+     return;
+
+  if (next < tg->number_of_blocks && tg->updates[next] == next && !tg->busy[next])
+     { task->type = TASK_PANEL;                                 /* the block of the next panel is fully updated */
+       task->panel = task->block = next;
+     }
+  else
+     for (int j = next; j < tg->number_of_blocks; j++)              /* leftmost block updatable by a decomposed panel */
+       if (tg->updates[j] < next && !tg->busy[j])
+          { task->type = TASK_UPDATE;
+            task->panel = tg->updates[j];
+            task->block = j;
+            break;
+          }
+
+  if (task->type != TASK_NONE)
+     { tg->busy[task->block] = true;
+       tg->running += 1;
+       task->matrix = tg->matrix;
+       task->row_length = tg->row_length;
+       task->pivots = tg->pivots;
+     }
+}
+
+/**
+ *  \brief Get a task that is ready to run.
+ *
+ *  Operation carried out by the workers of a group.
+ *  The leader gets TASK_NONE when its matrix is decomposed; the other workers when there are no more matrices.
+ *
+ *  \param workerId worker identification
+ *  \param group group identification
+ *  \param leader true if the worker is the leader of the group
+ *
+ *  \return task
+ */
+struct Task getTask (unsigned int workerId, unsigned int group, bool leader)
+{
+  struct TaskGroup * tg = &groups[group];
+  struct Task task;                                                                                /* retrieved task */
+
+  enterMonitor (workerId, tg);
+
+  while (true)
+  { findTask (tg, &task);
+    if ((task.type != TASK_NONE) || (leader && !tg->active) || (!leader && tg->end))
+       break;
+    if ((statusWorkers[workerId] = pthread_cond_wait (&tg->changed, &tg->access)) != 0)  /* wait for a task ready */
+       { errno = statusWorkers[workerId];                                                   /* save error in errno */
+         perror ("error on waiting in changed");
+         statusWorkers[workerId] = EXIT_FAILURE;
+         pthread_exit (&statusWorkers[workerId]);
+       }
+  }
+
+  if ((statusWorkers[workerId] = pthread_mutex_unlock (&tg->access)) != 0)                       /* exit monitor */
+     { errno = statusWorkers[workerId];                                                     /* save error in errno */
+       perror ("error on exiting monitor(TG)");
+       statusWorkers[workerId] = EXIT_FAILURE;
+       pthread_exit (&statusWorkers[workerId]);
+     }
+
+  return task;
+}
+
+/**
+ *  \brief Signal that a task was done.
+ *
+ *  Operation carried out by the workers of a group.
+ *
+ *  \param workerId worker identification
+ *  \param group group identification
+ *  \param task task that was done
+ *  \param row_swaps number of row swaps of a panel task (-1 if the matrix is singular)
+ */
+void taskDone (unsigned int workerId, unsigned int group, struct Task task, int row_swaps)
+{
+  struct TaskGroup * tg = &groups[group];
+
+  enterMonitor (workerId, tg);
+
+  tg->busy[task.block] = false;
+  tg->running -= 1;
+  if (task.type == TASK_PANEL)
+     { if (row_swaps < 0)
+          tg->singular = true;
+       else tg->row_swaps += row_swaps;
+       tg->panels_done += 1;
+     }
+  else tg->updates[task.block] += 1;
+
+  if ((tg->panels_done == tg->number_of_blocks || tg->singular) && (tg->running == 0))
+     tg->active = false;                                                                  /* the matrix is decomposed */
+
+  exitMonitor (workerId, tg);
+}
+
+/**
+ *  \brief Release the decomposition of a matrix.
+ *
+ *  Operation carried out by the leader of the group, after getting TASK_NONE.
+ *
+ *  \param workerId worker identification
+ *  \param group group identification
+ *
+ *  \return sign of the determinant given by the row swaps (0 if the matrix is singular)
+ */
+double finishMatrix (unsigned int workerId, unsigned int group)
+{
+  struct TaskGroup * tg = &groups[group];
+  double sign;
+
+  enterMonitor (workerId, tg);
+
+  if (tg->singular)
+     sign = 0.0;
+  else sign = (tg->row_swaps % 2 == 0) ? 1.0 : -1.0;
+
+  free (tg->updates);
+  free (tg->busy);
+  free (tg->pivots);
+
+  exitMonitor (workerId, tg);
+
+  return sign;
+}
+
+/**
+ *  \brief Let the workers of a group know that there are no more matrices.
+ *
+ *  Operation carried out by the leader of the group.
+ *
+ *  \param workerId worker identification
+ *  \param group group identification
+ */
+void endTasks (unsigned int workerId, unsigned int group)
+{
+  struct TaskGroup * tg = &groups[group];
+
+  enterMonitor (workerId, tg);
+
+  tg->end = true;
+
+  exitMonitor (workerId, tg);
+}
@@ -0,0 +1,121 @@
+/**
+ *  \file tasks.h (interface file)
+ *
+ *  \brief Problem name: Compute Matrix Determinant.
+ *
+ *  In this file the functions to share the decomposition of a matrix by a group of threads are defined.
+ *  Synchronization based on monitors.
+ *  Both threads and the monitor are implemented using the pthread library which enables the creation of a
+ *  monitor of the Lampson / Redell type.
+ *
+ *  The blocked LU decomposition of a matrix is split in tasks: the decomposition of each panel and the update of each
+ *  block of LU_PANEL columns to its right. A panel is decomposed when its block was updated by all the panels before it,
+ *  and a block is updated by a panel when the panel was decomposed and the block was updated by all the panels before it.
+ *
+ *  Definition of the operations carried out by the main thread:
+ *     \li initTaskGroups.
+ *  Definition of the operations carried out by the leader of each group of workers:
+ *     \li startMatrix
+ *     \li finishMatrix
+ *     \li endTasks.
+ *  Definition of the operations carried out by the workers of each group:
+ *     \li getTask
+ *     \li taskDone.
+ *
+ *  \author Diogo Filipe Amaral Carvalho - 92969 - April 2022
+ *  \author Rafael Ferreira Baptista - 93367 - April 2022
+ */
+
+#ifndef TASKS_H
+#define TASKS_H
+
+#include "chunks.h"
+
+/** \brief kinds of task */
+enum TaskType { TASK_NONE, TASK_PANEL, TASK_UPDATE };
+
+/** \brief struct with a task of the decomposition of a matrix */
+struct Task {
+   int type;                        /* kind of task (TASK_NONE if there are no more tasks for the worker) */
+   int panel;                       /* block of columns of the panel */
+   int block;                       /* block of columns to update (the panel itself in a panel task) */
+   struct MatrixInfo matrix;        /* matrix being decomposed */
+   int row_length;                  /* number of coefficients of a row of the matrix, padding included */
+   int * pivots;                    /* row swapped with each row of the matrix */
+};
+
+/**
+ *  \brief Create the groups of workers.
+ *
+ *  Operation carried out by the main thread, before the workers are created.
+ *
+ *  \param number_of_groups number of groups of workers
+ */
+extern void initTaskGroups (int number_of_groups);
+
+
+/**
+ *  \brief Start the decomposition of a matrix by a group.
+ *
+ *  Operation carried out by the leader of the group.
+ *
+ *  \param workerId worker identification
+ *  \param group group identification
+ *  \param matrixinfo matrix to decompose
+ */
+extern void startMatrix (unsigned int workerId, unsigned int group, struct MatrixInfo matrixinfo);
+
+
+/**
+ *  \brief Get a task that is ready to run.
+ *
+ *  Operation carried out by the workers of a group.
+ *  The leader gets TASK_NONE when its matrix is decomposed; the other workers when there are no more matrices.
+ *
+ *  \param workerId worker identification
+ *  \param group group identification
+ *  \param leader true if the worker is the leader of the group
+ *
+ *  \return task
+ */
+extern struct Task getTask (unsigned int workerId, unsigned int group, bool leader);
+
+
+/**
+ *  \brief Signal that a task was done.
+ *
+ *  Operation carried out by the workers of a group.
+ *
+ *  \param workerId worker identification
+ *  \param group group identification
+ *  \param task task that was done
+ *  \param row_swaps number of row swaps of a panel task (-1 if the matrix is singular)
+ */
+extern void taskDone (unsigned int workerId, unsigned int group, struct Task task, int row_swaps);
+
+
+/**
+ *  \brief Release the decomposition of a matrix.
+ *
+ *  Operation carried out by the leader of the group, after getting TASK_NONE.
+ *
+ *  \param workerId worker identification
+ *  \param group group identification
+ *
+ *  \return sign of the determinant given by the row swaps (0 if the matrix is singular)
+ */
+extern double finishMatrix (unsigned int workerId, unsigned int group);
+
+
+/**
+ *  \brief Let the workers of a group know that there are no more matrices.
+ *
+ *  Operation carried out by the leader of the group.
+ *
+ *  \param workerId worker identification
+ *  \param group group identification
+ */
+extern void endTasks (unsigned int workerId, unsigned int group);
+
+
+#endif /* TASKS_H */
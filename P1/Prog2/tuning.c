@@ -0,0 +1,161 @@
+/**
+ *  \file tuning.c (implementation file)
+ *
+ *  \brief Problem name: Compute Matrix Determinant.
+ *
+ *  In this file the functions to choose the kernels and the tile width of the decomposition for each order of the
+ *  matrices are implemented.
+ *
+ *  A profile is a text file with a line for each order benchmarked by autotune, by increasing order:
+ *  "order update_kernel tile batch_kernel", the kernels by name (kernelNames); lines starting with # are comments.
+ *  The tuning of an order is used for the matrices of that order up to the next order of the profile.
+ *
+ *  Definition of the operations carried out by the main thread:
+ *     \li loadProfile
+ *     \li saveProfile.
+ *  Definition of the operations carried out by the worker threads:
+ *     \li tuningFor.
+ *
+ *  \author Diogo Filipe Amaral Carvalho - 92969 - April 2022
+ *  \author Rafael Ferreira Baptista - 93367 - April 2022
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+#include "kernels.h"
+#include "tuning.h"
+#include "probConst.h"
+
+/** \brief tuning of each order of the profile, by increasing order (NULL without a profile) */
+static struct Tuning * profile = NULL;
+
+/** \brief number of orders of the profile */
+static int profile_size = 0;
+
+/** \brief variant of the kernels of the built-in heuristics */
+static int heuristic_kernel = KERNEL_SCALAR;
+
+/**
+ *  \brief Find a variant of the kernels by its name.
+ *
+ *  \param name name of the variant
+ *
+ *  \return variant of the kernels, or -1 if there is none with the name
+ */
+static int kernelByName (const char * name)
+{
+  for (int variant = 0; variant < NUMBER_OF_KERNELS; variant++)
+    if (strcmp (name, kernelNames[variant]) == 0)
+       return variant;
+
+  return -1;
+}
+
+/**
+ *  \brief Load a profile, or fall back to the built-in heuristics if the profile does not exist.
+ *
+ *  Operation carried out by the main thread, before the workers are created. A profile that can not be read, or that
+ *  names a kernel the processor does not support, ends the program.
+ *
+ *  \param name name of the profile
+ *
+ *  \return number of orders of the profile (0 if it does not exist)
+ */
+int loadProfile (const char * name)
+{
+  heuristic_kernel = fastestKernel ();
+
+  FILE * file = fopen (name, "r");
+  if (file == NULL)
+     { if (errno == ENOENT)
+          return 0;
+       perror ("error on opening the tuning profile");
+       exit (EXIT_FAILURE);
+     }
+
+  char line[256];
+  int line_number = 0;
+  while (fgets (line, sizeof (line), file) != NULL)
+  { line_number += 1;
+
+    char update[16], batch[16];
+    struct Tuning tuning;
+    int fields = sscanf (line, "%d %15s %d %15s", &tuning.order, update, &tuning.tile, batch);
+    if ((fields <= 0) || (line[strspn (line, " \t")] == '#'))                     /* blank line or comment */
+       continue;
+
+    tuning.update_kernel = (fields == 4) ? kernelByName (update) : -1;
+    tuning.batch_kernel = (fields == 4) ? kernelByName (batch) : -1;
+    if ((tuning.update_kernel < 0) || (tuning.batch_kernel < 0) || (tuning.tile <= 0) || (tuning.tile % LU_PANEL != 0) ||
+        (tuning.order <= ((profile_size > 0) ? profile[profile_size - 1].order : 0)))
+       { fprintf (stderr, "%s: line %d: expected \"order update_kernel tile batch_kernel\", by increasing order\n",
+                  name, line_number);
+         exit (EXIT_FAILURE);
+       }
+    if (!kernelSupported (tuning.update_kernel) || !kernelSupported (tuning.batch_kernel))
+       { fprintf (stderr, "%s: line %d: the processor does not support the kernels of the profile, run autotune again\n",
+                  name, line_number);
+         exit (EXIT_FAILURE);
+       }
+
+    profile = realloc (profile, (profile_size + 1) * sizeof (struct Tuning));
+    profile[profile_size++] = tuning;
+  }
+
+  fclose (file);
+
+  return profile_size;
+}
+
+/**
+ *  \brief Write a profile.
+ *
+ *  Operation carried out by the main thread of autotune.
+ *
+ *  \param name name of the profile
+ *  \param tunings tuning of each order, by increasing order
+ *  \param number_of_tunings number of orders
+ *
+ *  \return true if the profile was written
+ */
+bool saveProfile (const char * name, const struct Tuning * tunings, int number_of_tunings)
+{
+  FILE * file = fopen (name, "w");
+  if (file == NULL)
+     return false;
+
+  fprintf (file, "# tuning profile of computeDet, written by autotune\n");
+  fprintf (file, "# order update_kernel tile batch_kernel\n");
+  for (int t = 0; t < number_of_tunings; t++)
+    fprintf (file, "%d %s %d %s\n", tunings[t].order, kernelNames[tunings[t].update_kernel], tunings[t].tile,
+             kernelNames[tunings[t].batch_kernel]);
+
+  return fclose (file) == 0;
+}
+
+/**
+ *  \brief Get the kernels and the tile width for the matrices of an order.
+ *
+ *  The tuning of the largest order of the profile up to the order is used (the first one for smaller orders).
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param order_of_matrix order of the matrices
+ *
+ *  \return tuning of the order
+ */
+struct Tuning tuningFor (int order_of_matrix)
+{
+  if (profile_size == 0)
+     return (struct Tuning) { order_of_matrix, heuristic_kernel, LU_TILE, heuristic_kernel };
+
+  int t = 0;
+  while ((t + 1 < profile_size) && (profile[t + 1].order <= order_of_matrix))
+    t += 1;
+
+  return profile[t];
+}
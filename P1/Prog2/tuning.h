@@ -0,0 +1,76 @@
+/**
+ *  \file tuning.h (interface file)
+ *
+ *  \brief Problem name: Compute Matrix Determinant.
+ *
+ *  In this file the functions to choose the kernels and the tile width of the decomposition for each order of the
+ *  matrices are defined.
+ *
+ *  The choices are read from a profile written by autotune, which benchmarks the variants on the local machine; without
+ *  a profile, the built-in heuristics are used: the kernels with the widest vectors supported and tiles of LU_TILE columns.
+ *
+ *  Definition of the operations carried out by the main thread:
+ *     \li loadProfile
+ *     \li saveProfile.
+ *  Definition of the operations carried out by the worker threads:
+ *     \li tuningFor.
+ *
+ *  \author Diogo Filipe Amaral Carvalho - 92969 - April 2022
+ *  \author Rafael Ferreira Baptista - 93367 - April 2022
+ */
+
+#ifndef TUNING_H
+#define TUNING_H
+
+#include <stdbool.h>
+
+/** \brief kernels and tile width of the decomposition of the matrices from an order on */
+struct Tuning {
+   int order;           /* smallest order of the matrices */
+   int update_kernel;   /* variant of the kernel of the trailing matrix update (enum KernelVariant) */
+   int tile;            /* number of columns of a tile of the trailing matrix update (a multiple of LU_PANEL) */
+   int batch_kernel;    /* variant of the batched kernel (enum KernelVariant) */
+};
+
+/**
+ *  \brief Load a profile, or fall back to the built-in heuristics if the profile does not exist.
+ *
+ *  Operation carried out by the main thread, before the workers are created. A profile that can not be read, or that
+ *  names a kernel the processor does not support, ends the program.
+ *
+ *  \param name name of the profile
+ *
+ *  \return number of orders of the profile (0 if it does not exist)
+ */
+extern int loadProfile (const char * name);
+
+
+/**
+ *  \brief Write a profile.
+ *
+ *  Operation carried out by the main thread of autotune.
+ *
+ *  \param name name of the profile
+ *  \param tunings tuning of each order, by increasing order
+ *  \param number_of_tunings number of orders
+ *
+ *  \return true if the profile was written
+ */
+extern bool saveProfile (const char * name, const struct Tuning * tunings, int number_of_tunings);
+
+
+/**
+ *  \brief Get the kernels and the tile width for the matrices of an order.
+ *
+ *  The tuning of the largest order of the profile up to the order is used (the first one for smaller orders).
+ *
+ *  Operation carried out by the worker threads.
+ *
+ *  \param order_of_matrix order of the matrices
+ *
+ *  \return tuning of the order
+ */
+extern struct Tuning tuningFor (int order_of_matrix);
+
+
+#endif /* TUNING_H */
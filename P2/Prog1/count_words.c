@@ -3,10 +3,22 @@
  *
  *  \brief Problem name: Count words.
  *
- *  Concurrency based on Message Passage Interface (MPI).
+ *  Concurrency based on Message Passage Interface (MPI) combined with a pool of threads inside each worker process.
+ *  The dispatcher groups the chunks in batches of about BATCH_SIZE bytes. Each batch starts with a header listing
+ *  the file, position and length of each chunk, followed by the data of the chunks.
+ *  Each worker process stores the chunks of the batches it receives in a monitor (P1/Prog1/chunks.c) shared by its
+ *  threads, and waits for them to process a batch with the monitor of the pending chunks (P1/Prog1/pending.c).
+ *  The receive of the next batch is posted in a second buffer before the worker waits for the threads, so the next
+ *  batch arrives while the current one is processed. A batch too large for the buffer is announced by a message with
+ *  its header alone and follows in a message of its own.
+ *  Optionally (-d), the batches go through a two-level dispatch tree: the dispatcher sends large batches to a
+ *  sub-dispatcher in each node, which splits them among the workers of its node.
  *
- *  How to compile: mpicc -Wall -o count_words count_words.c auxiliar_functions.c counters.c
- *  How to run: mpiexec -n 4 ./count_words text0.txt text1.txt text2.txt text3.txt text4.txt
+ *  How to compile: mpicc -Wall -o count_words count_words.c auxiliar_functions.c counters.c ../../P1/Prog1/chunks.c
+ *                  ../../P1/Prog1/pending.c -I../../P1/Prog1 -lpthread
+ *  How to run (hybrid): mpiexec -n 3 ./count_words -t 8 text0.txt text1.txt text2.txt text3.txt text4.txt
+ *  How to run (pure MPI, same number of cores): mpiexec -n 17 ./count_words -t 1 text0.txt text1.txt text2.txt text3.txt text4.txt
+ *  How to run (two-level dispatch tree): mpiexec -n 65 ./count_words -d -t 4 text0.txt text1.txt text2.txt text3.txt text4.txt
  *
  *  \author Diogo Filipe Amaral Carvalho - 92969 - April 2022
  *  \author Rafael Ferreira Baptista - 93367 - April 2022
@@ -18,52 +30,138 @@
 #include <string.h>
 #include <ctype.h> 
 #include <stdbool.h>
+#include <stdint.h>
 #include <wchar.h>
 #include <locale.h>
 #include <time.h>
+#include <unistd.h>
 #include <pthread.h>
 
+#include "chunks.h"
+#include "pending.h"
 #include "counters.h"
 #include "probConst.h"
 #include "auxiliar_functions.h"
 
 
-/** \brief struct to store the information of one chunk*/
-struct ChunkInfo {
-    int file_id;                                    /* file identifier */  
-    int chunk_size;                                 /* Number of bytes of the chunk */
-    unsigned char* chunk_info;                      /* Pointer to the start of the chunk */
+/** \brief header of a batch of chunks, followed by number_of_chunks entries and then by the data of the chunks */
+struct BatchHeader {
+    uint32_t number_of_chunks;                      /* number of chunks of the batch */
 };
 
-/** \brief struct to store the results of a file */
-struct FileResults {
-   int file_id;                                     /* file identifier */  
-   int total_num_of_words;                          /* Number of total words */
-   int num_of_words_starting_with_vowel_chars;      /* Number of words starting with vowel chars */
-   int num_of_words_ending_with_consonant_chars;    /* Number of words ending with consonant chars */
+/** \brief entry of a chunk in the header of a batch */
+struct BatchEntry {
+    uint32_t file_id;                               /* file identifier */
+    uint32_t offset;                                /* position of the chunk, counted from the start of the data of the chunks */
+    uint32_t length;                                /* number of bytes of the chunk */
 };
 
+/** \brief role of a process */
+enum Role { DISPATCHER, SUB_DISPATCHER, WORKER };
+
 /** \brief dispatcher life cycle routine */
 static void dispatcher(char *filenames[], int number_of_files);
 
+/** \brief sub-dispatcher life cycle routine */
+static void subDispatcher();
+
+/** \brief initialize the batches of a dispatcher */
+static void initBatches();
+
+/** \brief add a chunk to the batch being filled by a dispatcher */
+static unsigned char * appendChunk(uint32_t file_id, uint32_t chunk_length);
+
+/** \brief send the batch being filled by a dispatcher to a worker */
+static void sendBatch();
+
+/** \brief send the last batch of a dispatcher and let its workers know there are no more chunks */
+static void finishBatches();
+
+/** \brief size of the buffers of the batches received by a process */
+static size_t batchCapacity(uint32_t target);
+
+/** \brief wait for a batch received in a buffer (or in a message of its own if it did not fit) */
+static unsigned char * receiveBatch(unsigned char * buffer, MPI_Request * request, MPI_Comm comm, unsigned char ** oversized);
+
+/** \brief split the processes for the two-level dispatch tree */
+static int buildDispatchTree(int rank);
+
+/** \brief print the utilization of the dispatchers of each level */
+static void reportUtilization(int role, double elapsed);
+
 /** \brief worker life cycle routine */
 static void worker(int rank);
 
+/** \brief worker thread life cycle routine */
+static void *threadWorker(void *par);
+
 /** \brief count the words inside a chunk */
 static void processChunk(struct ChunkInfo * chunkinfo, int * total_num_of_words, int * num_of_words_starting_with_vowel_chars, int * num_of_words_ending_with_consonant_chars);
 
 /** \brief number of workers */
 int number_of_workers;
 
+/** \brief communicator shared by the dispatcher of this process and its workers */
+MPI_Comm workComm;
+
+/** \brief communicators of the two-level dispatch tree: the dispatcher with the sub-dispatchers, and each node */
+static MPI_Comm leaderComm = MPI_COMM_NULL, nodeComm = MPI_COMM_NULL;
+
+/** \brief time spent by the dispatcher of this process waiting for its workers */
+static double dispatcherWaitTime = 0.0;
+
 /** \brief ideally number of bytes that a chunk should have */
 int num_bytes = N;  
 
+/** \brief number of threads of each worker process */
+int num_of_threads = 1;
+
+/** \brief number of files to analyze */
+int num_of_files;
+
+/** \brief worker threads return status array */
+int *statusWorkers;
+
+/** \brief main thread of a worker process return status */
+int statusProd;
+
+/** \brief counters of each file computed by each thread of a worker process (3 counters per file, per thread) */
+static long long *threadCounters;
+
+/** \brief number of counters between the counters of two threads (3 per file, rounded up to a whole number of cache lines) */
+static int threadStride;
+
+/** \brief ideally number of bytes of chunk data of a batch */
+static uint32_t batch_target = BATCH_SIZE;
+
+/** \brief ideally number of bytes of chunk data of a batch received by this process */
+static uint32_t receive_target = BATCH_SIZE;
+
+/** \brief entries of the batch being filled by the dispatcher */
+static struct BatchEntry *batchEntries;
+
+/** \brief data of the chunks of the batch being filled by the dispatcher */
+static unsigned char *batchData;
+
+/** \brief number of chunks and number of bytes of data of the batch being filled by the dispatcher */
+static uint32_t batchChunks, batchBytes;
+
+/** \brief number of entries and number of bytes of data that fit in the batch being filled by the dispatcher */
+static uint32_t entriesCapacity, dataCapacity;
+
+/** \brief message being sent to each worker and its request */
+static unsigned char **batchMessages;
+static MPI_Request *reqSnd;
+
+/** \brief number of batches sent to workers */
+static int number_of_batches_sent = 0;
+
 /**
  *  \brief Main thread.
  *
  *  Its role is to initialize MPI, launch dispatcher and workers and measure execution time.
- *  The workers will receive chunks of data, process those chunks and send the results back to dispatcher.
- *  The dispatcher will read files, create chunks, send chunks to workers and receive results.
+ *  The workers will receive chunks of data, process those chunks and keep the counters of each file.
+ *  The dispatcher will read files, create chunks, send chunks to workers and, in the end, reduce the counters of all workers.
  */
 
 int main(int argc, char *argv[])
@@ -72,12 +170,46 @@ int main(int argc, char *argv[])
 
     /* Initialize MPI */
 
-    MPI_Init (&argc, &argv);
+    int provided;
+    MPI_Init_thread (&argc, &argv, MPI_THREAD_FUNNELED, &provided);
     MPI_Comm_rank (MPI_COMM_WORLD, &rank);
     MPI_Comm_size (MPI_COMM_WORLD, &size);
 
     setlocale(LC_ALL, "en_US.UTF-8");
 
+    if (provided < MPI_THREAD_FUNNELED) {
+        fprintf(stderr, "The MPI library does not support threads. \n");
+        MPI_Finalize();
+        return EXIT_FAILURE;
+    }
+
+    /* process command line arguments (the same in every process) */
+
+    int opt;                        /* selected option */
+    bool dispatch_tree = false;     /* use the two-level dispatch tree */
+
+    opterr = 0;
+    while ((opt = getopt(argc, argv, "dt:")) != -1) {
+        if (opt == 't' && atoi(optarg) > 0) {
+            num_of_threads = atoi(optarg);
+        } else if (opt == 'd') {
+            dispatch_tree = true;
+        } else {
+            if (rank == 0)
+                fprintf(stderr, "Usage: count_words [-d] [-t number of threads per worker] files\n");
+            MPI_Finalize();
+            return EXIT_FAILURE;
+        }
+    }
+
+    num_of_files = argc - optind;
+    if (num_of_files <= 0) {
+        if (rank == 0)
+            fprintf(stderr, "Usage: count_words [-d] [-t number of threads per worker] files\n");
+        MPI_Finalize();
+        return EXIT_FAILURE;
+    }
+
     number_of_workers = size - 1;   // Number of worker processes
 
     if (number_of_workers <= 0) {
@@ -86,7 +218,15 @@ int main(int argc, char *argv[])
         return EXIT_FAILURE;
     } else {
 
-        if (rank == 0) {
+        /* assign the role of this process */
+
+        workComm = MPI_COMM_WORLD;
+        int role = (rank == 0) ? DISPATCHER : WORKER;
+        if (dispatch_tree)
+            role = buildDispatchTree(rank);
+        double role_start = MPI_Wtime();
+
+        if (role == DISPATCHER) {
 
 
             /* measure time */
@@ -97,16 +237,16 @@ int main(int argc, char *argv[])
 
             /* Read File Names */
 
-            char *filenames[argc-1];
+            char *filenames[num_of_files];
 
-            for (int i = 1; i<argc; i++) {
-                filenames[i-1] = argv[i];
+            for (int i = optind; i<argc; i++) {
+                filenames[i-optind] = argv[i];
             }
 
 
             /* Launch Dispatcher */
 
-            dispatcher(filenames, argc-1);
+            dispatcher(filenames, num_of_files);
 
 
             /* measure time */
@@ -121,12 +261,22 @@ int main(int argc, char *argv[])
             printf("\nElapsed time = %.6f s\n", elapsed);
 
 
+        } else if (role == SUB_DISPATCHER) {
+
+            /* Launch sub-dispatcher life cycle */
+
+            subDispatcher();
+
         } else {
             
             /* Launch worker life cycle */
             
             worker(rank);
         }
+
+        /* report the utilization of the dispatchers */
+
+        reportUtilization(role, MPI_Wtime() - role_start);
     }
     
     MPI_Finalize();
@@ -139,24 +289,20 @@ int main(int argc, char *argv[])
 /**
  *  \brief Function dispatcher.
  *
- *  Its role is to read files, create chunks of data, send those chunks to workers, receive the results and save the results.
+ *  Its role is to read files, create chunks of data, group those chunks in batches and send the batches to workers.
+ *  Each batch is sent with a synchronous send, so a worker only gets a new batch after starting to receive the previous one,
+ *  and the next batch goes to the first worker that is free (a worker posts the receive of its next batch when it starts
+ *  processing one, so it holds at most one batch ahead). The counters of each worker are summed at the end.
+ *  With the two-level dispatch tree, the workers of this dispatcher are the sub-dispatchers of each node.
  *
  *  \param filenames pointer to array that contains the name of each file
  *  \param number_of_files total number of files to analyze
  */
 static void dispatcher(char *filenames[], int number_of_files) {
 
-    MPI_Request reqSnd[number_of_workers], reqRec[number_of_workers];
-    bool msgRec[number_of_workers];
-    struct FileResults results[number_of_workers];
-    int recVal = 0;
-
-    for (int i = 0; i < number_of_workers; i++) {
-        msgRec[i] = false;
-    } 
+    /* Initalize the batches */
 
-    int current_worker_to_receive_work = 1;  // Id of worker that will receive next chunk to process
-    int number_of_chunks_sent = 0;           // Number of chunks sent to workers    
+    initBatches();
 
     /* Initalize counters to 0 for each file */
 
@@ -167,7 +313,7 @@ static void dispatcher(char *filenames[], int number_of_files) {
     for(int i=0;i<number_of_files;i++){
 
         FILE * fpointer;
-        unsigned char byte;        // Variable used to store each byte of the file  
+        unsigned char byte;        // Variable used to store each byte of the file
         unsigned char *character;  // Variable used to store the char (singlebyte or multibyte)
 
         /* Open file */
@@ -184,7 +330,7 @@ static void dispatcher(char *filenames[], int number_of_files) {
         fseek(fpointer, 0, SEEK_SET);           // Seek file to the start
         int number_of_processed_bytes = 0;      // Variable to also keep track of the initial position of the current chunk
         int size_of_current_chunk;              // the size of the chunk will probably vary, not always num_bytes
-            
+
         /* While there are still bytes to create a chunk */
         while (number_of_processed_bytes < size_of_file) {
 
@@ -197,10 +343,10 @@ static void dispatcher(char *filenames[], int number_of_files) {
                 fseek(fpointer, number_of_processed_bytes + size_of_current_chunk, SEEK_SET);       // Seek file to the end of chunk
 
                 /* Update the size of chunk in order to cut the file without cutting a word or a multibyte char */
-                while (true) {                  
+                while (true) {
                     byte = fgetc(fpointer);    // Read a byte
 
-                    size_of_current_char = 1;  
+                    size_of_current_char = 1;
                     character = malloc((1+1)* sizeof(unsigned char) );      // the last byte of the character is required to be 0
                     character[0] = byte;
 
@@ -234,147 +380,542 @@ static void dispatcher(char *filenames[], int number_of_files) {
             /* Seek file to the initial position of the chunk */
             fseek(fpointer, number_of_processed_bytes, SEEK_SET);
 
-            /* Array with chunk information - the first element will be the file id, then it will be the chunk data */
-            unsigned char * chunk = (unsigned char*) malloc(size_of_current_chunk+size_of_current_char+sizeof(int));
-            chunk[0] = i;
-            int s = fread(chunk+1, size_of_current_chunk+size_of_current_char, 1, fpointer);
+            /* Append the chunk (chunk data + the last character) to the batch */
+            uint32_t chunk_length = size_of_current_chunk + size_of_current_char;
+            int s = fread(appendChunk(i, chunk_length), chunk_length, 1, fpointer);
             if (s != 1)
                 printf("Error creating chunk buffer.");
 
-            MPI_Isend(chunk, size_of_current_chunk+size_of_current_char+sizeof(int), MPI_BYTE, current_worker_to_receive_work, 1, MPI_COMM_WORLD, &reqSnd[current_worker_to_receive_work-1]);
-            
-            /* Update current_worker_to_receive_work and number_of_chunks_sent variables */
-            current_worker_to_receive_work = (current_worker_to_receive_work%number_of_workers)+1;
-            number_of_chunks_sent += 1;
-
             number_of_processed_bytes += size_of_current_chunk;
+        }
 
-            if (number_of_chunks_sent >= number_of_workers) {
-                // Check if results from workers are available
+        // Close file
+        fclose(fpointer);
+    }
 
-                for (int i = 1; i <= number_of_workers; i++) {
+    /* Send the last batch and let the workers know that there are no more chunks to process */
 
-                    recVal = 0;
+    finishBatches();
 
-                    if (!msgRec[i-1]) {
-                        MPI_Irecv(&results[i-1], sizeof(struct FileResults), MPI_BYTE, i, 0, MPI_COMM_WORLD, &reqRec[i-1]);
-                        msgRec[i-1] = true;
-                    }
+    /* Sum the counters of all workers (the dispatcher has none) */
 
-                    MPI_Test(&reqRec[i-1], &recVal, MPI_STATUS_IGNORE);
+    size_t number_of_counters = 3 * (size_t) number_of_files;      // 3 counters per file (number_of_files > 0)
+    long long * localCounters = calloc(number_of_counters, sizeof(long long));
+    long long * totalCounters = malloc(number_of_counters * sizeof(long long));
 
-                    if (recVal) {
-                        // Save results
-                        saveResults(results[i-1].file_id, results[i-1].total_num_of_words, results[i-1].num_of_words_starting_with_vowel_chars, results[i-1].num_of_words_ending_with_consonant_chars);
-                    
-                        number_of_chunks_sent-= 1;
-                        msgRec[i-1] = false;
-                    }
-                }
+    MPI_Reduce(localCounters, totalCounters, (int) number_of_counters, MPI_LONG_LONG, MPI_SUM, 0, workComm);
 
-            }
+    // Save results
+    for (int i = 0; i < number_of_files; i++) {
+        saveResults(i, totalCounters[3*i], totalCounters[3*i+1], totalCounters[3*i+2]);
+    }
+
+    free(localCounters);
+    free(totalCounters);
+}
+
+
+/**
+ *  \brief Function sub-dispatcher.
+ *
+ *  Its role, in the two-level dispatch tree, is to receive large batches from the dispatcher, split them
+ *  in batches for the workers of its node and, in the end, send the sum of the counters of its node to the dispatcher.
+ */
+static void subDispatcher() {
+
+    /* Initalize the batches of the workers of the node */
+
+    initBatches();
 
+    // Post the receive of the first large batch
+    size_t capacity = batchCapacity(receive_target);
+    unsigned char * buffers[2] = { malloc(capacity), malloc(capacity) };
+    MPI_Request reqRcv[2];
+    int current = 0;
+    MPI_Irecv(buffers[current], capacity, MPI_BYTE, 0, 1, leaderComm, &reqRcv[current]);
+
+    while (true) {
+
+        // Wait for the large batch
+        unsigned char * oversized;
+        double wait_start = MPI_Wtime();
+        unsigned char * batch = receiveBatch(buffers[current], &reqRcv[current], leaderComm, &oversized);
+        dispatcherWaitTime += MPI_Wtime() - wait_start;
+
+        // Checks if it is the batch that tells that there are no more chunks to process
+        struct BatchHeader * header = (struct BatchHeader *) batch;
+        if (header->number_of_chunks == 0) {
+            break;
         }
 
-        // Close file
-        fclose(fpointer);
+        // Post the receive of the next large batch in the other buffer
+        MPI_Irecv(buffers[1 - current], capacity, MPI_BYTE, 0, 1, leaderComm, &reqRcv[1 - current]);
+
+        // Append each chunk of the large batch to the batches of the node
+        struct BatchEntry * entries = (struct BatchEntry *) (batch + sizeof(struct BatchHeader));
+        unsigned char * data = (unsigned char *) (entries + header->number_of_chunks);
+        for (uint32_t c = 0; c < header->number_of_chunks; c++) {
+            memcpy(appendChunk(entries[c].file_id, entries[c].length), data + entries[c].offset, entries[c].length);
+        }
+
+        // Do not keep the last chunks of the large batch waiting for the next one
+        if (batchChunks > 0) {
+            sendBatch();
+        }
+
+        free(oversized);
+        current = 1 - current;
     }
 
-    /* Receive results of last chunks from workers */
-    while (number_of_chunks_sent > 0) {
+    free(buffers[0]);
+    free(buffers[1]);
 
-        for (int i = 1; i <= number_of_workers; i++) {
+    /* Let the workers of the node know that there are no more chunks to process */
 
-            recVal = 0;
+    finishBatches();
 
-            if (!msgRec[i-1]) {
-                MPI_Irecv(&results[i-1], sizeof(struct FileResults), MPI_BYTE, i, 0, MPI_COMM_WORLD, &reqRec[i-1]);
-                msgRec[i-1] = true;
-            }
+    /* Sum the counters of the workers of the node and send them to the dispatcher */
 
-            MPI_Test(&reqRec[i-1], &recVal, MPI_STATUS_IGNORE);
-            if (recVal) {
+    size_t number_of_counters = 3 * (size_t) num_of_files;         // 3 counters per file (num_of_files > 0)
+    long long * localCounters = calloc(number_of_counters, sizeof(long long));
+    long long * nodeCounters = malloc(number_of_counters * sizeof(long long));
 
-                // Save results
-                saveResults(results[i-1].file_id, results[i-1].total_num_of_words, results[i-1].num_of_words_starting_with_vowel_chars, results[i-1].num_of_words_ending_with_consonant_chars);
-            
-                number_of_chunks_sent-=1;
-                msgRec[i-1] = false;
-            }
-        }
-            
-    }        
+    MPI_Reduce(localCounters, nodeCounters, (int) number_of_counters, MPI_LONG_LONG, MPI_SUM, 0, workComm);
+    MPI_Reduce(nodeCounters, NULL, (int) number_of_counters, MPI_LONG_LONG, MPI_SUM, 0, leaderComm);
+
+    free(localCounters);
+    free(nodeCounters);
+}
+
+
+/**
+ *  \brief Function initBatches.
+ *
+ *  Its role is to initialize the batch to be filled and the messages being sent to each worker.
+ */
+static void initBatches() {
+
+    reqSnd = malloc(number_of_workers * sizeof(MPI_Request));
+    batchMessages = malloc(number_of_workers * sizeof(unsigned char *));
+
+    for (int i = 0; i < number_of_workers; i++) {
+        reqSnd[i] = MPI_REQUEST_NULL;
+        batchMessages[i] = NULL;
+    }
+
+    entriesCapacity = batch_target / num_bytes + 1;   // Number of entries that fit in the batch (grows if needed)
+    dataCapacity = batch_target + num_bytes;          // Number of bytes of chunk data that fit in the batch (grows if needed)
+    batchEntries = malloc(entriesCapacity * sizeof(struct BatchEntry));
+    batchData = malloc(dataCapacity);
+    batchChunks = 0;
+    batchBytes = 0;
+}
+
+
+/**
+ *  \brief Function appendChunk.
+ *
+ *  Its role is to add the entry of a chunk to the batch being filled. If the chunk does not fit in the batch,
+ *  the batch is sent first.
+ *
+ *  \param file_id file identifier
+ *  \param chunk_length number of bytes of the chunk
+ *
+ *  \return pointer to where the data of the chunk must be written
+ */
+static unsigned char * appendChunk(uint32_t file_id, uint32_t chunk_length) {
+
+    /* Send the batch if the chunk does not fit in it, or if its message would not fit in the buffers of the workers */
+    size_t message_size = sizeof(struct BatchHeader) + (batchChunks + 1) * sizeof(struct BatchEntry) + batchBytes + chunk_length;
+    if (batchChunks > 0 && (batchBytes + chunk_length > batch_target || message_size > batchCapacity(batch_target))) {
+        sendBatch();
+    }
+
+    /* Grow the batch if needed */
+    if (batchChunks == entriesCapacity) {
+        entriesCapacity *= 2;
+        batchEntries = realloc(batchEntries, entriesCapacity * sizeof(struct BatchEntry));
+    }
+    if (batchBytes + chunk_length > dataCapacity) {
+        dataCapacity = batchBytes + chunk_length;
+        batchData = realloc(batchData, dataCapacity);
+    }
+
+    unsigned char * chunk = batchData + batchBytes;
+
+    batchEntries[batchChunks].file_id = file_id;
+    batchEntries[batchChunks].offset = batchBytes;
+    batchEntries[batchChunks].length = chunk_length;
+    batchChunks += 1;
+    batchBytes += chunk_length;
+
+    return chunk;
+}
+
+
+/**
+ *  \brief Function sendBatch.
+ *
+ *  Its role is to frame the batch being filled (header, entries and data of the chunks) in a message
+ *  and send it to the first free worker. After that, the batch is empty.
+ */
+static void sendBatch() {
+
+    int current_worker_to_receive_work;      // Id of worker that will receive the batch
+
+    /* Frame the message */
+
+    size_t entries_size = batchChunks * sizeof(struct BatchEntry);
+    size_t message_size = sizeof(struct BatchHeader) + entries_size + batchBytes;
+    unsigned char * message = malloc(message_size);
+
+    ((struct BatchHeader *) message)->number_of_chunks = batchChunks;
+    memcpy(message + sizeof(struct BatchHeader), batchEntries, entries_size);
+    memcpy(message + sizeof(struct BatchHeader) + entries_size, batchData, batchBytes);
+
+    /* Choose the worker: each one gets a batch first, then the first one to start receiving its last batch */
+
+    if (number_of_batches_sent < number_of_workers) {
+        current_worker_to_receive_work = number_of_batches_sent + 1;
+    } else {
+        double wait_start = MPI_Wtime();
+        MPI_Waitany(number_of_workers, reqSnd, &current_worker_to_receive_work, MPI_STATUS_IGNORE);
+        dispatcherWaitTime += MPI_Wtime() - wait_start;
+        current_worker_to_receive_work += 1;
+        free(batchMessages[current_worker_to_receive_work-1]);
+    }
+    batchMessages[current_worker_to_receive_work-1] = message;
+
+    /* A batch (of a single large chunk) that does not fit in the buffers of the worker is announced by its header */
+
+    int tag = 1;
+    if (message_size > batchCapacity(batch_target)) {
+        MPI_Send(message, sizeof(struct BatchHeader), MPI_BYTE, current_worker_to_receive_work, 1, workComm);
+        tag = 2;
+    }
+    MPI_Issend(message, message_size, MPI_BYTE, current_worker_to_receive_work, tag, workComm, &reqSnd[current_worker_to_receive_work-1]);
+
+    number_of_batches_sent += 1;
+    batchChunks = 0;
+    batchBytes = 0;
+}
+
+
+/**
+ *  \brief Function finishBatches.
+ *
+ *  Its role is to send the last batch, wait for the workers to receive every batch and let the workers know
+ *  that there are no more chunks to process.
+ */
+static void finishBatches() {
+
+    /* Send the last batch */
+
+    if (batchChunks > 0) {
+        sendBatch();
+    }
+
+    /* Wait for the last batches to be received by the workers */
+
+    double wait_start = MPI_Wtime();
+    MPI_Waitall(number_of_workers, reqSnd, MPI_STATUSES_IGNORE);
+    dispatcherWaitTime += MPI_Wtime() - wait_start;
+    for (int i = 0; i < number_of_workers; i++) {
+        free(batchMessages[i]);
+    }
 
     /* Send message to each process to know that there are no more chunks to process */
 
+    struct BatchHeader lastBatch;
+    lastBatch.number_of_chunks = 0;
     for (int i = 1; i <= number_of_workers; i++) {
-        unsigned char* lastChunk = malloc(sizeof(unsigned char));
-        lastChunk[0] = 255;
-        // Send Special Chunk to Worker
-        MPI_Isend(lastChunk, sizeof(unsigned char), MPI_BYTE, i, 1, MPI_COMM_WORLD, &reqSnd[i-1]);
-    }    
+        // Send Special Batch to Worker
+        MPI_Send(&lastBatch, sizeof(struct BatchHeader), MPI_BYTE, i, 1, workComm);
+    }
 
+    free(batchEntries);
+    free(batchData);
+    free(batchMessages);
+    free(reqSnd);
 }
 
 
+/**
+ *  \brief Function batchCapacity.
+ *
+ *  Its role is to give the size of the buffers in which a process receives its batches: the data of the chunks of a
+ *  batch and room for their entries. The dispatchers send larger batches (of a single large chunk) in two messages.
+ *
+ *  \param target ideally number of bytes of chunk data of a batch
+ *
+ *  \return number of bytes of a buffer
+ */
+static size_t batchCapacity(uint32_t target) {
 
+    return sizeof(struct BatchHeader) + target + target / 8;
+}
+
+
+/**
+ *  \brief Function receiveBatch.
+ *
+ *  Its role is to wait for the receive of a batch posted in a buffer. If the message has the header of the batch alone,
+ *  the batch did not fit in the buffer and follows in a message of its own, which is received in a new buffer.
+ *
+ *  \param buffer pointer to the buffer of the receive
+ *  \param request pointer to the request of the receive
+ *  \param comm communicator of the receive
+ *  \param oversized pointer to store the new buffer, to be freed after the batch is processed (NULL if there is none)
+ *
+ *  \return pointer to the batch
+ */
+static unsigned char * receiveBatch(unsigned char * buffer, MPI_Request * request, MPI_Comm comm, unsigned char ** oversized) {
+
+    MPI_Status status;
+    int message_size;
+
+    MPI_Wait(request, &status);
+    MPI_Get_count(&status, MPI_BYTE, &message_size);
+
+    *oversized = NULL;
+    if (message_size == sizeof(struct BatchHeader) && ((struct BatchHeader *) buffer)->number_of_chunks > 0) {
+        MPI_Probe(0, 2, comm, &status);
+        MPI_Get_count(&status, MPI_BYTE, &message_size);
+        *oversized = (unsigned char *) malloc(message_size);
+        MPI_Recv(*oversized, message_size, MPI_BYTE, 0, 2, comm, MPI_STATUS_IGNORE);
+        return *oversized;
+    }
+
+    return buffer;
+}
+
+
+/**
+ *  \brief Function buildDispatchTree.
+ *
+ *  Its role is to split the processes in nodes (processes sharing memory) for the two-level dispatch tree.
+ *  The first process of each node is its sub-dispatcher and talks with the dispatcher (rank 0).
+ *  A process alone in its node is a worker of the dispatcher.
+ *
+ *  \param rank process identification
+ *
+ *  \return role of the process
+ */
+static int buildDispatchTree(int rank) {
+
+    int node_rank = 0, node_size = 0;
+
+    // The dispatcher does not belong to any node
+    MPI_Comm_split_type(MPI_COMM_WORLD, (rank == 0) ? MPI_UNDEFINED : MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &nodeComm);
+    if (nodeComm != MPI_COMM_NULL) {
+        MPI_Comm_rank(nodeComm, &node_rank);
+        MPI_Comm_size(nodeComm, &node_size);
+    }
+
+    // The dispatcher and the first process of each node
+    MPI_Comm_split(MPI_COMM_WORLD, (rank == 0 || node_rank == 0) ? 0 : MPI_UNDEFINED, rank, &leaderComm);
+
+    if (rank == 0) {
+        workComm = leaderComm;
+        MPI_Comm_size(workComm, &number_of_workers);
+        number_of_workers -= 1;
+        batch_target = NODE_BATCH_SIZE;
+        return DISPATCHER;
+    } else if (node_rank == 0 && node_size > 1) {
+        workComm = nodeComm;
+        number_of_workers = node_size - 1;
+        receive_target = NODE_BATCH_SIZE;
+        return SUB_DISPATCHER;
+    } else if (node_rank == 0) {
+        workComm = leaderComm;
+        receive_target = NODE_BATCH_SIZE;
+        return WORKER;
+    }
+
+    workComm = nodeComm;
+    return WORKER;
+}
+
+
+/**
+ *  \brief Function reportUtilization.
+ *
+ *  Its role is to print the fraction of the time the dispatchers of each level were not waiting for workers.
+ *  Every process takes part in the reduction of the values of the sub-dispatchers.
+ *
+ *  \param role role of the process
+ *  \param elapsed time spent by the process in its role
+ */
+static void reportUtilization(int role, double elapsed) {
+
+    double utilization = 0.0;
+    if (role != WORKER && elapsed > 0)
+        utilization = 100.0 * (1.0 - dispatcherWaitTime / elapsed);
+
+    double sub_dispatchers[2] = {0.0, 0.0};   // Sum of the utilization of the sub-dispatchers and number of sub-dispatchers
+    double max_utilization = 0.0;
+    if (role == SUB_DISPATCHER) {
+        sub_dispatchers[0] = utilization;
+        sub_dispatchers[1] = 1.0;
+        max_utilization = utilization;
+    }
+
+    double total[2], max_total;
+    MPI_Reduce(sub_dispatchers, total, 2, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&max_utilization, &max_total, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+    if (role == DISPATCHER) {
+        printf("Dispatcher utilization (level 0) = %.1f %%\n", utilization);
+        if (total[1] > 0)
+            printf("Sub-dispatcher utilization (level 1, %d nodes) = %.1f %% average, %.1f %% maximum\n",
+                   (int) total[1], total[0] / total[1], max_total);
+    }
+}
 
 
 
 /**
  *  \brief Function worker.
  *
- *  Its role is to get chunks of data and count the words. After that, it sends the results back to dispatcher.
+ *  Its role is to get batches of chunks and store their chunks in the FIFO of its threads, which count the words.
+ *  In the end, it sums the counters of its threads and sends them to its dispatcher with a single reduction.
  *
  *  \param rank worker process identification
  */
 static void worker(int rank) {
 
-    MPI_Request reqSnd;
-    
+    int *status_p;
+
+    /* generate worker threads */
+
+    statusWorkers = malloc(num_of_threads * sizeof(int));                       // Allocate memory to save the status of each thread
+    // Allocate memory to save the counters of each thread, in cache lines of its own so the threads do not share them
+    int counters_per_line = CACHE_LINE / sizeof(long long);
+    threadStride = (3 * num_of_files + counters_per_line - 1) / counters_per_line * counters_per_line;
+    threadCounters = aligned_alloc(CACHE_LINE, (size_t) num_of_threads * threadStride * sizeof(long long));
+    memset(threadCounters, 0, (size_t) num_of_threads * threadStride * sizeof(long long));
+    pthread_t tIdWorkers[num_of_threads];
+    unsigned int workers[num_of_threads];
+    for (int i = 0; i < num_of_threads; i++)
+        workers[i] = i;
+
+    for (int i = 0; i < num_of_threads; i++)
+    if (pthread_create (&tIdWorkers[i], NULL, threadWorker, &workers[i]) != 0)                      /* thread worker */
+    { perror ("error on creating thread worker");
+        exit (EXIT_FAILURE);
+    }
+
+    // Post the receive of the first batch
+    size_t capacity = batchCapacity(receive_target);
+    unsigned char * buffers[2] = { malloc(capacity), malloc(capacity) };
+    MPI_Request reqRcv[2];
+    int current = 0;
+    MPI_Irecv(buffers[current], capacity, MPI_BYTE, 0, 1, workComm, &reqRcv[current]);
+
     while (true) {
 
-        // Struct to save information of the chunk
-        struct ChunkInfo newChunk;
+        // Wait for the batch
+        unsigned char * oversized;
+        unsigned char * batch = receiveBatch(buffers[current], &reqRcv[current], workComm, &oversized);
 
-        // Get message size
-        MPI_Status status;
-        MPI_Probe(0, 1, MPI_COMM_WORLD, &status);
-        int message_size;
-        MPI_Get_count(&status, MPI_BYTE, &message_size);
+        // Checks if it is the batch that tells that there are no more chunks to process
+        struct BatchHeader * header = (struct BatchHeader *) batch;
+        if (header->number_of_chunks == 0) {
+            break;
+        }
 
-        // Alocate memory to read the chunk information
-        newChunk.chunk_info = (unsigned char*) malloc(message_size);
-        MPI_Recv(newChunk.chunk_info, message_size, MPI_BYTE, 0, 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+        // Post the receive of the next batch in the other buffer (free, its batch is done), so it arrives while the
+        // threads process this one
+        MPI_Irecv(buffers[1 - current], capacity, MPI_BYTE, 0, 1, workComm, &reqRcv[1 - current]);
+
+        // Save each chunk of the batch in FIFO, letting MPI progress the receive while the FIFO is full
+        struct BatchEntry * entries = (struct BatchEntry *) (batch + sizeof(struct BatchHeader));
+        unsigned char * data = (unsigned char *) (entries + header->number_of_chunks);
+        for (uint32_t c = 0; c < header->number_of_chunks; c++) {
+            int arrived;
+            addPending();
+            putChunk(data + entries[c].offset, entries[c].length, entries[c].file_id);
+            MPI_Iprobe(0, MPI_ANY_TAG, workComm, &arrived, MPI_STATUS_IGNORE);
+        }
 
-        // Checks if it is the chunk that tells that there are no more chunks to process
-        if (newChunk.chunk_info[0] == 255) break;
+        // Wait until the threads have processed every chunk
+        waitPending();
 
-        // Convert info to the struct ChunkInfo
-        newChunk.file_id = newChunk.chunk_info[0];
-        newChunk.chunk_info = newChunk.chunk_info + 1;
-        newChunk.chunk_size = message_size - sizeof(int);
+        // Free the memory of the batch, if it did not fit in the buffer
+        free(oversized);
+        current = 1 - current;
+    }
+
+    free(buffers[0]);
+    free(buffers[1]);
+
+    /* save a struct in fifo for each thread to know that there are no more chunks to process */
+
+    for (int i = 0; i < num_of_threads; i++) {
+        endChunk();
+    }
+
+    /* waiting for the termination of the worker threads */
+
+    for (int i = 0; i < num_of_threads; i++)
+    { if (pthread_join (tIdWorkers[i], (void *) &status_p) != 0)
+        { perror ("error on waiting for thread worker");
+            exit (EXIT_FAILURE);
+        }
+    }
+
+    /* sum the counters of the threads and then the counters of all workers in the dispatcher */
+
+    size_t number_of_counters = 3 * (size_t) num_of_files;         // 3 counters per file (num_of_files > 0)
+    long long * localCounters = calloc(number_of_counters, sizeof(long long));
+    for (int i = 0; i < num_of_threads; i++) {
+        for (size_t c = 0; c < number_of_counters; c++) {
+            localCounters[c] += threadCounters[(size_t) i * threadStride + c];
+        }
+    }
+
+    MPI_Reduce(localCounters, NULL, (int) number_of_counters, MPI_LONG_LONG, MPI_SUM, 0, workComm);
 
-        // Process chunk of data
+    free(localCounters);
+    free(threadCounters);
+    free(statusWorkers);
+}
+
+
+/**
+ *  \brief Function thread worker.
+ *
+ *  Its role is to get sub-chunks of data from the FIFO of its worker process and count the words.
+ *
+ *  \param par pointer to application defined thread identification
+ */
+static void *threadWorker(void *par) {
+    unsigned int id = *((unsigned int *) par);      // thread id
+
+    while (true) {
+        // Get sub-chunk of data
+        struct ChunkInfo chunkinfo = getChunk(id);
+
+        // Checks if it is the chunk that tells that there are no more chunks to process
+        if (chunkinfo.fileId == -1) break;
+
+        // Process sub-chunk of data
         int total_num_of_words = 0;
         int num_of_words_starting_with_vowel_chars = 0;
         int num_of_words_ending_with_consonant_chars = 0;
+        processChunk(&chunkinfo, &total_num_of_words, &num_of_words_starting_with_vowel_chars, &num_of_words_ending_with_consonant_chars);
 
-        processChunk(&newChunk, &total_num_of_words, &num_of_words_starting_with_vowel_chars, &num_of_words_ending_with_consonant_chars);
-
-        // Free the memory of the buffer
-        free(newChunk.chunk_info-1);
+        // Save results in the counters of the thread
+        long long * counters = threadCounters + id * threadStride + chunkinfo.fileId * 3;
+        counters[0] += total_num_of_words;
+        counters[1] += num_of_words_starting_with_vowel_chars;
+        counters[2] += num_of_words_ending_with_consonant_chars;
 
-        // Send results back to dispatcher
-        struct FileResults results;
-        results.file_id = newChunk.file_id;
-        results.total_num_of_words = total_num_of_words;
-        results.num_of_words_starting_with_vowel_chars = num_of_words_starting_with_vowel_chars;
-        results.num_of_words_ending_with_consonant_chars = num_of_words_ending_with_consonant_chars;
-        
-        MPI_Isend(&results, sizeof(struct FileResults), MPI_BYTE, 0, 0, MPI_COMM_WORLD, &reqSnd);
+        removePending(id);
     }
 
+    statusWorkers[id] = EXIT_SUCCESS;
+    pthread_exit (&statusWorkers[id]);
 }
 
 
@@ -395,7 +936,7 @@ static void processChunk(struct ChunkInfo * chunkinfo, int * total_num_of_words,
     // Flag used to check if the last char of a word was consonant or not     
     bool lastCharWasConsonant = false;
     
-    //printf("Chunk data: %s\n", (*chunkinfo).chunk_info);
+    //printf("Chunk data: %s\n", (*chunkinfo).chunk_pointer);
     unsigned char byte;             // Variable used to store each byte of the chunk
     int i = 0;                      // Counter to make sure to read only chunk_size bytes
     unsigned char *character;       // Initialization of variable used to store the char (singlebyte or multibyte)
@@ -405,7 +946,7 @@ static void processChunk(struct ChunkInfo * chunkinfo, int * total_num_of_words,
     while (i < (*chunkinfo).chunk_size) {
 
         // Construction of the char
-        byte = (*chunkinfo).chunk_info[i];        // Read a byte
+        byte = (*chunkinfo).chunk_pointer[i];        // Read a byte
 
 
         character = malloc((1+1)* sizeof(unsigned char) );      // Allocate memory to store the character. For now, it is a single byte
@@ -414,23 +955,23 @@ static void processChunk(struct ChunkInfo * chunkinfo, int * total_num_of_words,
         if (byte > 192 && byte < 224) {   // 2-byte char
             i++;
             character = realloc(character, (2+1)* sizeof(unsigned char) );
-            character[1] = (*chunkinfo).chunk_info[i];
+            character[1] = (*chunkinfo).chunk_pointer[i];
             character[2] = 0;
         } else if ( byte > 224 && byte < 240) {     // 3-byte char
             character = realloc(character, (3+1)* sizeof(unsigned char) );
             i++;
-            character[1] = (*chunkinfo).chunk_info[i];
+            character[1] = (*chunkinfo).chunk_pointer[i];
             i++;
-            character[2] = (*chunkinfo).chunk_info[i];
+            character[2] = (*chunkinfo).chunk_pointer[i];
             character[3] = 0;
         } else if ( byte > 240 ) {     // 4-byte char
             character = realloc(character, (4+1)* sizeof(unsigned char) );
             i++;
-            character[1] = (*chunkinfo).chunk_info[i];
+            character[1] = (*chunkinfo).chunk_pointer[i];
             i++;
-            character[2] = (*chunkinfo).chunk_info[i];
+            character[2] = (*chunkinfo).chunk_pointer[i];
             i++;
-            character[3] = (*chunkinfo).chunk_info[i];
+            character[3] = (*chunkinfo).chunk_pointer[i];
             character[4] = 0;
         } else {        // single byte char
             character[1] = 0;
@@ -26,9 +26,9 @@
 /** \brief struct to store the counters of a file */
 struct FileCounters {
    char* file_name;                                   /* file name */  
-   int total_num_of_words;                            /* Number of total words */
-   int num_of_words_starting_with_vowel_chars;        /* Number of words starting with vowel chars */
-   int num_of_words_ending_with_consonant_chars;      /* Number of words ending with consonant chars */
+   long long total_num_of_words;                            /* Number of total words */
+   long long num_of_words_starting_with_vowel_chars;        /* Number of words starting with vowel chars */
+   long long num_of_words_ending_with_consonant_chars;      /* Number of words ending with consonant chars */
 };
 
 /** \brief total number of files to process */
@@ -49,7 +49,7 @@ static struct FileCounters * mem;
  *  \param num_of_words_ending_with_consonant_chars
  * 
  */
-void saveResults (int file_id, int total_words, int num_of_words_starting_with_vowel_chars, int num_of_words_ending_with_consonant_chars)
+void saveResults (int file_id, long long total_words, long long num_of_words_starting_with_vowel_chars, long long num_of_words_ending_with_consonant_chars)
 {
 
   mem[file_id].total_num_of_words += total_words;
@@ -93,9 +93,9 @@ void printResults ()
 {
   for (int i = 0; i<num_of_files; i++) {
     printf("File name: %s\n", mem[i].file_name);
-    printf("Total number of words: %d\n", mem[i].total_num_of_words);
-    printf("Number of words starting with a vowel char: %d\n", mem[i].num_of_words_starting_with_vowel_chars);
-    printf("Number of words ending with a consonant char: %d\n", mem[i].num_of_words_ending_with_consonant_chars);
+    printf("Total number of words: %lld\n", mem[i].total_num_of_words);
+    printf("Number of words starting with a vowel char: %lld\n", mem[i].num_of_words_starting_with_vowel_chars);
+    printf("Number of words ending with a consonant char: %lld\n", mem[i].num_of_words_ending_with_consonant_chars);
   }
   
 }
\ No newline at end of file
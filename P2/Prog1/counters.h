@@ -39,7 +39,7 @@ extern void storeFileNames(int nFileNames, char *fileNames[]);
  *  \param num_of_words_ending_with_consonant_chars
  *
  */
-extern void saveResults (int file_id, int total_words, int num_of_words_starting_with_vowel_chars, int num_of_words_ending_with_consonant_chars);
+extern void saveResults (int file_id, long long total_words, long long num_of_words_starting_with_vowel_chars, long long num_of_words_ending_with_consonant_chars);
 
 /**
  *  \brief Print final results
@@ -53,9 +53,9 @@ extern void printResults ();
 /** \brief struct to store the counters of a file*/
 struct FileCounters {
    char* file_name;                                /* file name */  
-   int total_num_of_words;                         /* Number of total words */
-   int num_of_words_starting_with_vowel_chars;     /* Number of words starting with vowel chars */
-   int num_of_words_ending_with_consonant_chars;   /* Number of words ending with consonant chars */
+   long long total_num_of_words;                         /* Number of total words */
+   long long num_of_words_starting_with_vowel_chars;     /* Number of words starting with vowel chars */
+   long long num_of_words_ending_with_consonant_chars;   /* Number of words ending with consonant chars */
 } FileCounters;
 
 #endif /* COUNTERS_H */
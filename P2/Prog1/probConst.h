@@ -17,4 +17,16 @@
 /** \brief size of data chunk */
 #define  N           4000
 
+/** \brief ideally number of bytes of chunk data sent to a worker in a single message */
+#define  BATCH_SIZE  (1024 * 1024)
+
+/** \brief ideally number of bytes of chunk data sent to the sub-dispatcher of a node in a single message (two-level dispatch tree) */
+#define  NODE_BATCH_SIZE  (16 * 1024 * 1024)
+
+/** \brief number of bytes of a cache line (the counters of each thread start in a cache line of their own) */
+#define  CACHE_LINE   64
+
+/** \brief data transfer region nominal capacity (in number of values that can be stored) in the FIFO of each worker process */
+#define  K            10
+
 #endif /* PROBCONST_H_ */
@@ -3,10 +3,26 @@
  *
  *  \brief Problem name: Compute Matrix Determinant.
  *
- *  Concurrency based on Message Passing Interface (MPI).
+ *  Concurrency based on Message Passing Interface (MPI) combined with a pool of threads inside each worker process.
+ *  Each worker process stores the matrices of the batches it receives in a monitor (chunks.c) shared by its threads,
+ *  and waits for them to process a batch with the monitor of the pending work of P1/Prog1 (pending.c).
+ *  Every matrix travels as a derived datatype {id, order, coefficients}, and the batches of fixed size are sent and received
+ *  through persistent requests on two buffers of each worker, so that a worker receives a batch while processing the other.
+ *  Optionally (-d), the batches go through a two-level dispatch tree: the dispatcher sends large batches to a
+ *  sub-dispatcher in each node, which splits them among the workers of its node.
  *
- *  How to compile: mpicc -Wall -o computeDet computeDet.c
- *  How to run: mpiexec -n 5 ./computeDet -f mat128_32.bin
+ *  In the exact mode (-e), the threads compute the determinants of matrices of integers exactly, by multi-modular
+ *  arithmetic (P1/Prog2/exact.c), and the workers send them back in decimal, as text, after the results of each batch.
+ *
+ *  How to compile: mpicc -Wall -O3 -o computeDet computeDet.c chunks.c ../../P1/Prog1/pending.c ../../P1/Prog2/det.c
+ *                  ../../P1/Prog2/kernels.c ../../P1/Prog2/tuning.c ../../P1/Prog2/exact.c ../../P1/Prog2/check.c
+ *                  -I../../P1/Prog2 -I../../P1/Prog1 -lpthread -lm
+ *  How to run (hybrid): mpiexec -n 3 ./computeDet -t 8 -f mat128_32.bin
+ *  How to run (pure MPI, same number of cores): mpiexec -n 17 ./computeDet -t 1 -f mat128_32.bin
+ *  How to run (two-level dispatch tree): mpiexec -n 65 ./computeDet -d -t 4 -f mat128_32.bin
+ *  How to run (sign and log10 of the determinants): mpiexec -n 3 ./computeDet -l -t 8 -f mat128_32.bin
+ *  How to run (exact determinants of matrices of integers): mpiexec -n 3 ./computeDet -e -t 8 -f integers.bin
+ *  How to run (check the determinants written by P1/Prog2/generate): mpiexec -n 3 ./computeDet -t 8 -f mat128_32.bin -c mat128_32.txt
  *
  *  \author Diogo Filipe Amaral Carvalho - 92969 - April 2022
  *  \author Rafael Ferreira Baptista - 93367 - April 2022
@@ -15,6 +31,8 @@
 #include <mpi.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <math.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdbool.h>
 #include <time.h>
@@ -22,37 +40,112 @@
 #include <unistd.h>
 #include <pthread.h>
 
-
-/** \brief struct to store the information of one matrix */
-struct MatrixInfo {
-   int matrix_id;           /* matrix identifier */  
-   int order_of_matrix;     /* Order of the matrix */
-   double * matrix_pointer; /* Pointer to the start of the matrix */
+#include "chunks.h"
+#include "pending.h"
+#include "det.h"
+#include "check.h"
+#include "exact.h"
+#include "probConst.h"
+
+/** \brief struct with the start of a matrix in a batch, followed by its coefficients */
+struct MatrixHeader {
+   int matrix_id;                                     /* matrix identifier */
+   int order_of_matrix;                               /* Order of the matrix */
 };
 
 /** \brief struct to store the results of a matrix */
 struct MatrixResults {
    int matrix_id;                                     /* matrix identifier */  
-   double determinant;                                /* Number of total words */
+   double determinant;                                /* mantissa of the determinant */
+   int exponent;                                      /* binary exponent of the determinant */
 };
 
 /** \brief function responsible to present the program usage */
 static void printUsage(char *cmdName);
 
+/** \brief role of a process */
+enum Role { DISPATCHER, SUB_DISPATCHER, WORKER };
+
 /** \brief worker life cycle routine */
-static void worker(int rank);
+static bool worker(int rank);
+
+/** \brief worker thread life cycle routine */
+static void *threadWorker(void *par);
 
 /** \brief dispatcher life cycle routine */
-static int dispatcher(char *fName);
+static int dispatcher(char *fName, int *order);
+
+/** \brief function to let the workers know that there is no work to do */
+static void dismissWorkers();
+
+/** \brief function to create the datatype of a matrix of a given order */
+static void createMatrixType(int order_of_matrix);
+
+/** \brief sub-dispatcher life cycle routine */
+static bool subDispatcher();
+
+/** \brief split the processes for the two-level dispatch tree */
+static int buildDispatchTree(int rank);
+
+/** \brief print the utilization of the dispatchers of each level */
+static void reportUtilization(int role, double elapsed);
 
 /** \brief number of workers */
 int number_of_workers;
 
-/** \brief to store the determinant of each matrix */
+/** \brief communicator shared by the dispatcher of this process and its workers */
+MPI_Comm workComm;
+
+/** \brief communicators of the two-level dispatch tree: the dispatcher with the sub-dispatchers, and each node */
+static MPI_Comm leaderComm = MPI_COMM_NULL, nodeComm = MPI_COMM_NULL;
+
+/** \brief time spent by the dispatcher of this process waiting for its workers */
+static double dispatcherWaitTime = 0.0;
+
+/** \brief number of batches of a worker in each batch sent by the dispatcher */
+static int batch_multiplier = 1;
+
+/** \brief datatype of a matrix (header and coefficients) */
+static MPI_Datatype matrixType = MPI_DATATYPE_NULL;
+
+/** \brief number of bytes of a matrix (header and coefficients) in a batch */
+static size_t matrixSize;
+
+/** \brief number of threads of each worker process */
+int num_of_threads = 1;
+
+/** \brief worker threads return status array */
+int *statusWorkers;
+
+/** \brief main thread of a worker process return status */
+int statusProd;
+
+/** \brief results of the batch being processed by the threads of a worker process */
+static struct MatrixResults * batchResults;
+
+/** \brief identifier of the first matrix of the batch being processed */
+static int batchFirstId;
+
+/** \brief to store the determinant of each matrix (its mantissa, with the binary exponent in matrixExponents) */
 double * matrixDeterminants;
 
-/** \brief function to compute determinant of a matrix */
-static void computeDeterminant(struct MatrixInfo * matrixinfo, double * determinant);
+/** \brief to store the binary exponent of the determinant of each matrix */
+int * matrixExponents;
+
+/** \brief log mode: the sign and log10 of the absolute value of each determinant are printed, so they do not overflow */
+static bool log_mode = false;
+
+/** \brief exact mode: the matrices are of integers and their determinants are computed exactly, by multi-modular arithmetic */
+static bool exact = false;
+
+/** \brief exact determinants of the batch being processed by the threads of a worker process, in decimal */
+static char ** batchExact;
+
+/** \brief to store the exact determinant of each matrix, in decimal */
+static char ** matrixExact;
+
+/** \brief function to receive the exact determinants of a batch from a worker, as "id determinant" lines */
+static void receiveExact(int source);
 
 int main(int argc, char *argv[])
 {   
@@ -61,7 +154,8 @@ int main(int argc, char *argv[])
 
     /* Initialize MPI */
 
-    MPI_Init (&argc, &argv);
+    int provided;
+    MPI_Init_thread (&argc, &argv, MPI_THREAD_FUNNELED, &provided);
     MPI_Comm_rank (MPI_COMM_WORLD, &rank);
     MPI_Comm_size (MPI_COMM_WORLD, &size);
 
@@ -71,20 +165,48 @@ int main(int argc, char *argv[])
 
     if (number_of_workers <= 0) {
         fprintf(stderr, "You must have at least 1 worker, meaning, n value must be higher than 1. \n"); 
+    } else if (provided < MPI_THREAD_FUNNELED) {
+        fprintf(stderr, "The MPI library does not support threads. \n");
     } else {
 
-        if (rank == 0) {
+        /* assign the role of this process (every process must know if the dispatch tree is used) */
+
+        bool dispatch_tree = false;
+        int opt;            /* selected option */
+
+        opterr = 0;
+        while ((opt = getopt(argc, argv, "dlet:f:c:h")) != -1) {
+            if (opt == 'd')
+                dispatch_tree = true;
+            else if (opt == 'e')
+                exact = true;
+        }
+        optind = 1;         /* the dispatcher parses the options again, reporting the errors */
+
+        workComm = MPI_COMM_WORLD;
+        int role = (rank == 0) ? DISPATCHER : WORKER;
+        if (dispatch_tree)
+            role = buildDispatchTree(rank);
+        double role_start = MPI_Wtime();
+
+        if (role == DISPATCHER) {
 
             /* process command line arguments */
 
-            int opt;            /* selected option */
             char *fName = "";   /* file name (initialized to "no name" by default) */
+            char *aName = NULL; /* file with the known determinants (NULL if they are not checked) */
 
-            opterr = 0;
             do
             {
-                switch ((opt = getopt(argc, argv, "f:h")))
+                switch ((opt = getopt(argc, argv, "dlet:f:c:h")))
                 {
+                case 'd': /* two-level dispatch tree */
+                    break;
+                case 'l': /* log mode */
+                    log_mode = true;
+                    break;
+                case 'e': /* exact mode */
+                    break;
                 case 'f': /* file name */
                     if (optarg[0] == '-')
                     {
@@ -92,30 +214,46 @@ int main(int argc, char *argv[])
                         printUsage(basename(argv[0]));
 
                         /* Send message to each worker to know that there is no work to do */
-                        for (int i = 1; i <= number_of_workers; i++) {
-                            struct MatrixInfo newMatrix;
-                            newMatrix.matrix_id = -1;
-                            newMatrix.order_of_matrix = -1;
-                            // Send Special Message to Worker
-                            MPI_Send(&newMatrix, sizeof(struct MatrixInfo), MPI_BYTE, i, 0, MPI_COMM_WORLD);
-                        } 
+                        dismissWorkers();
 
                         MPI_Finalize();
                         return EXIT_FAILURE;
                     }
                     fName = optarg;
                     break;
+                case 'c': /* file with the known determinants */
+                    if (optarg[0] == '-')
+                    {
+                        fprintf(stderr, "%s: answers file name is missing\n", basename(argv[0]));
+                        printUsage(basename(argv[0]));
+
+                        /* Send message to each worker to know that there is no work to do */
+                        dismissWorkers();
+
+                        MPI_Finalize();
+                        return EXIT_FAILURE;
+                    }
+                    aName = optarg;
+                    break;
+                case 't': /* number of threads */
+                    if (atoi(optarg) <= 0)
+                    {
+                        fprintf(stderr, "%s: number of threads must be positive\n", basename(argv[0]));
+                        printUsage(basename(argv[0]));
+
+                        /* Send message to each worker to know that there is no work to do */
+                        dismissWorkers();
+
+                        MPI_Finalize();
+                        return EXIT_FAILURE;
+                    }
+                    num_of_threads = atoi(optarg);
+                    break;
                 case 'h': /* help mode */
                     printUsage(basename(argv[0]));
 
                     /* Send message to each worker to know that there is no work to do */
-                    for (int i = 1; i <= number_of_workers; i++) {
-                        struct MatrixInfo newMatrix;
-                        newMatrix.matrix_id = -1;
-                        newMatrix.order_of_matrix = -1;
-                        // Send Special Message to Worker
-                        MPI_Send(&newMatrix, sizeof(struct MatrixInfo), MPI_BYTE, i, 0, MPI_COMM_WORLD);
-                    } 
+                    dismissWorkers();
 
                     MPI_Finalize();
                     return EXIT_SUCCESS;
@@ -124,13 +262,7 @@ int main(int argc, char *argv[])
                     printUsage(basename(argv[0]));
 
                     /* Send message to each worker to know that there is no work to do */
-                    for (int i = 1; i <= number_of_workers; i++) {
-                        struct MatrixInfo newMatrix;
-                        newMatrix.matrix_id = -1;
-                        newMatrix.order_of_matrix = -1;
-                        // Send Special Message to Worker
-                        MPI_Send(&newMatrix, sizeof(struct MatrixInfo), MPI_BYTE, i, 0, MPI_COMM_WORLD);
-                    } 
+                    dismissWorkers();
 
                     MPI_Finalize();
                     return EXIT_FAILURE;
@@ -144,13 +276,18 @@ int main(int argc, char *argv[])
                 printUsage(basename(argv[0]));
 
                 /* Send message to each worker to know that there is no work to do */
-                for (int i = 1; i <= number_of_workers; i++) {
-                    struct MatrixInfo newMatrix;
-                    newMatrix.matrix_id = -1;
-                    newMatrix.order_of_matrix = -1;
-                    // Send Special Message to Worker
-                    MPI_Send(&newMatrix, sizeof(struct MatrixInfo), MPI_BYTE, i, 0, MPI_COMM_WORLD);
-                } 
+                dismissWorkers();
+
+                MPI_Finalize();
+                return EXIT_FAILURE;
+            }
+            if (exact && (dispatch_tree || log_mode || aName != NULL))
+            {
+                fprintf(stderr, "%s: the exact mode (-e) can not be combined with -d, -l or -c\n", basename(argv[0]));
+                printUsage(basename(argv[0]));
+
+                /* Send message to each worker to know that there is no work to do */
+                dismissWorkers();
 
                 MPI_Finalize();
                 return EXIT_FAILURE;
@@ -163,8 +300,8 @@ int main(int argc, char *argv[])
             clock_gettime(CLOCK_MONOTONIC_RAW, &start);
 
             /* Launch Dispatcher */
-            int number_of_matrix;
-            number_of_matrix = dispatcher(fName);
+            int number_of_matrix, order_of_matrix;
+            number_of_matrix = dispatcher(fName, &order_of_matrix);
 
             /* measure time */
             
@@ -175,19 +312,43 @@ int main(int argc, char *argv[])
             /* print final results */
             
             for (int matrix_id = 0; matrix_id < number_of_matrix; matrix_id++) {
+                double mantissa = matrixDeterminants[matrix_id];
                 printf("Processing matrix %d \n", matrix_id + 1);
-                printf("Determinant: %.3e \n\n", matrixDeterminants[matrix_id]);
+                if (exact) {
+                    printf("Determinant: %s \n\n", matrixExact[matrix_id]);
+                    free(matrixExact[matrix_id]);
+                } else if (log_mode)
+                    printf("Determinant: sign %d, log10|det| %.6f \n\n", (mantissa > 0) - (mantissa < 0),
+                           log10(fabs(mantissa)) + matrixExponents[matrix_id] * log10(2.0));
+                else
+                    printf("Determinant: %.3e \n\n", ldexp(mantissa, matrixExponents[matrix_id]));
             }
 
             printf ("\nElapsed time = %.6f s\n", elapsed);
-            
+            printf ("Throughput = %.1f matrices/s, %.3f GFLOP/s \n", number_of_matrix / elapsed,
+                    number_of_matrix * 2.0 / 3.0 * pow(order_of_matrix, 3) / elapsed / 1e9);
+
+            if (aName != NULL)
+                checkDeterminants(aName, matrixDeterminants, matrixExponents, number_of_matrix);
+
+            /* report the utilization of the dispatchers */
+
+            reportUtilization(role, MPI_Wtime() - role_start);
         
         
+        } else if (role == SUB_DISPATCHER) {
+
+            /* Launch sub-dispatcher life cycle */
+
+            if (subDispatcher())
+                reportUtilization(role, MPI_Wtime() - role_start);
+
         } else {
             
             /* Launch worker life cycle */
             
-            worker(rank);
+            if (worker(rank))
+                reportUtilization(role, MPI_Wtime() - role_start);
         }
     }
     
@@ -206,7 +367,11 @@ static void printUsage(char *cmdName)
                     "  OPTIONS:\n"
                     "  -h      --- print this help\n"
                     "  -f      --- filename\n"
-                    "  -t      --- number of threads\n",
+                    "  -t      --- number of threads of each worker\n"
+                    "  -d      --- use a two-level dispatch tree (a sub-dispatcher in each node)\n"
+                    "  -l      --- print the sign and log10 of the absolute value of each determinant\n"
+                    "  -e      --- exact mode: the determinants of matrices of integers are computed exactly\n"
+                    "  -c      --- file with the known determinants, to check the ones computed (written by P1/Prog2/generate)\n",
             cmdName);
 }
 
@@ -214,39 +379,35 @@ static void printUsage(char *cmdName)
 /**
  *  \brief Function dispatcher.
  *
- *  Its role is to read the file, create matrix, send those matrix to workers, receive the results and save the results.
+ *  Its role is to read the file, create batches of matrices, send those batches to workers, receive the results and save the results.
  *
  *  \param fName name of the file with matrix
+ *  \param order pointer to an int to store the order of the matrices
+ *
+ *  \return number of matrices
  */
-static int dispatcher(char *fName) {
+static int dispatcher(char *fName, int *order) {
 
-    int current_worker_to_receive_work = 1;  // Id of worker that will receive next matrix to process
-    int number_of_matrix_sent = 0;           // Number of matrix sent to workers
+    int current_worker_to_receive_work = 1;  // Id of worker that will receive next batch to process
+    int number_of_batches_sent = 0;          // Number of batches sent to workers
 
-    MPI_Request reqSnd[number_of_workers], reqRec[number_of_workers];
+    MPI_Request reqSnd[number_of_workers][2], reqRec[number_of_workers];
+    MPI_Request reqLast = MPI_REQUEST_NULL;              // Request of the last batch, if it is not full
+    MPI_Status status;
     bool msgRec[number_of_workers];
-    struct MatrixResults results[number_of_workers];
+    int next_buffer[number_of_workers];                  // Buffer of each worker to be filled next
+    unsigned char * batches[number_of_workers][2];       // Batches being sent to each worker (double buffering)
+    struct MatrixResults * results[number_of_workers];    // Results being received from each worker
     int recVal = 0;
 
-    for (int i = 0; i < number_of_workers; i++) {
-        msgRec[i] = false;
-    } 
-
     /* open the text file */
 
     FILE * fpointer;
     fpointer = fopen(fName, "rb");
 
     if (fpointer == NULL) {
-        fprintf(stderr, "It occoured an error while openning file. \n"); 
-        /* Send message to each worker to know that there is no work to do */
-        for (int i = 1; i <= number_of_workers; i++) {
-            struct MatrixInfo newMatrix;
-            newMatrix.matrix_id = -1;
-            newMatrix.order_of_matrix = -1;
-            // Send Special Message to Worker
-            MPI_Send(&newMatrix, sizeof(struct MatrixInfo), MPI_BYTE, i, 0, MPI_COMM_WORLD);
-        } 
+        fprintf(stderr, "It occoured an error while openning file. \n");
+        dismissWorkers();
         MPI_Finalize();
         exit(EXIT_FAILURE);
     }
@@ -255,43 +416,86 @@ static int dispatcher(char *fName) {
 
     int number_of_matrix;
     int order_of_matrix;
-    
+
     // Read Number of Matrix from File
     if(fread(&number_of_matrix, sizeof(int), 1, fpointer) != 1)
         strerror(1);
     printf("Number of matrices to be read = %i \n", number_of_matrix);
 
     // Allocate memory to store each determinant
-    matrixDeterminants = malloc( number_of_matrix * sizeof(double));        
+    matrixDeterminants = malloc( number_of_matrix * sizeof(double));
+    matrixExponents = malloc( number_of_matrix * sizeof(int));
+    if (exact)
+        matrixExact = malloc( number_of_matrix * sizeof(char *));
 
     // Read Order of Matrix from File
     if(fread(&order_of_matrix, sizeof(int), 1, fpointer) != 1)
         strerror(1);
     printf("Matrices order = %i \n", order_of_matrix);
 
-    // Send a message with the order of the matrices to all workers
+    // Each batch has enough matrices to keep all the threads of a worker busy (or all the workers of a node busy)
+    int batch_size = num_of_threads * MATRICES_PER_THREAD * batch_multiplier;
+    createMatrixType(order_of_matrix);
+
+    // Send a message with the order of the matrices, number of threads and batch size to all workers
+    int params[3] = {order_of_matrix, num_of_threads, batch_size};
     for (int i = 1; i <= number_of_workers; i++) {
-        MPI_Isend(&order_of_matrix, sizeof(int), MPI_INT, i, 1, MPI_COMM_WORLD, &reqSnd[i-1]);
+        MPI_Send(params, 3, MPI_INT, i, 1, workComm);
+    }
+
+    // Every full batch and every result is sent and received through persistent requests
+    for (int i = 0; i < number_of_workers; i++) {
+        for (int b = 0; b < 2; b++) {
+            batches[i][b] = malloc(batch_size * matrixSize);
+            MPI_Send_init(batches[i][b], batch_size, matrixType, i+1, 0, workComm, &reqSnd[i][b]);
+        }
+        results[i] = malloc(batch_size * sizeof(struct MatrixResults));
+        MPI_Recv_init(results[i], batch_size * sizeof(struct MatrixResults), MPI_BYTE, i+1, 0, workComm, &reqRec[i]);
+        next_buffer[i] = 0;
+        msgRec[i] = false;
     }
 
-    // Send matrices to workers
-    for (int m = 1; m<=number_of_matrix; m++) {
+    // Send batches of matrices to workers
+    for (int m = 1; m<=number_of_matrix; m+=batch_size) {
 
-        double * matrix = malloc(order_of_matrix * order_of_matrix * sizeof(double) + sizeof(int));
-        matrix[0] = m;
+        int number_of_matrix_in_batch = (number_of_matrix - m + 1 < batch_size) ? number_of_matrix - m + 1 : batch_size;
 
-        int s = fread(matrix+1, order_of_matrix * order_of_matrix * sizeof(double), 1, fpointer);
-        if (s != 1)
-            printf("Error creating matrix buffer.");
+        // Wait until the batch sent before from the next buffer of this worker has left it
+        int w = current_worker_to_receive_work-1;
+        unsigned char * batch = batches[w][next_buffer[w]];
+        double wait_start = MPI_Wtime();
+        MPI_Wait(&reqSnd[w][next_buffer[w]], MPI_STATUS_IGNORE);
+        dispatcherWaitTime += MPI_Wtime() - wait_start;
 
-        /* Send Matrix to Worker */
-        MPI_Isend(matrix, (1 + order_of_matrix * order_of_matrix) * sizeof(double) + sizeof(int), MPI_BYTE, current_worker_to_receive_work, 0, MPI_COMM_WORLD, &reqSnd[current_worker_to_receive_work-1]);
+        // Read each matrix after its header
+        for (int i = 0; i < number_of_matrix_in_batch; i++) {
+            struct MatrixHeader * header = (struct MatrixHeader *) (batch + i * matrixSize);
+            header->matrix_id = m + i;
+            header->order_of_matrix = order_of_matrix;
 
-        /* Update current_worker_to_receive_work and number_of_matrix_sent variables */
+            int s = fread(header + 1, order_of_matrix * order_of_matrix * sizeof(double), 1, fpointer);
+            if (s != 1)
+                printf("Error creating matrix buffer.");
+
+            // The exact mode only takes matrices of integers
+            if (exact && primesNeeded((double *) (header + 1), order_of_matrix, order_of_matrix) < 0) {
+                fprintf(stderr, "%s: matrix %d is not a matrix of integers of less than 63 bits, required by the exact mode\n", fName, m + i);
+                MPI_Abort(workComm, EXIT_FAILURE);
+            }
+        }
+
+        /* Send Batch to Worker (only the last batch may not be full) */
+        if (number_of_matrix_in_batch == batch_size)
+            MPI_Start(&reqSnd[w][next_buffer[w]]);
+        else
+            MPI_Isend(batch, number_of_matrix_in_batch, matrixType, current_worker_to_receive_work, 0, workComm, &reqLast);
+        next_buffer[w] = 1 - next_buffer[w];
+
+        /* Update current_worker_to_receive_work and number_of_batches_sent variables */
         current_worker_to_receive_work = (current_worker_to_receive_work%number_of_workers)+1;
-        number_of_matrix_sent += 1;
+        number_of_batches_sent += 1;
 
-        if (number_of_matrix_sent >= number_of_workers) {
+        if (number_of_batches_sent >= number_of_workers) {
             // Receive results from workers
 
             for (int i = 1; i <= number_of_workers; i++) {
@@ -299,176 +503,584 @@ static int dispatcher(char *fName) {
                 recVal = 0;
 
                 if (!msgRec[i-1]) {
-                    MPI_Irecv(&results[i-1], sizeof(struct MatrixResults), MPI_BYTE, i, 0, MPI_COMM_WORLD, &reqRec[i-1]);
+                    MPI_Start(&reqRec[i-1]);
                     msgRec[i-1] = true;
                 }
 
-                MPI_Test(&reqRec[i-1], &recVal, MPI_STATUS_IGNORE);
+                MPI_Test(&reqRec[i-1], &recVal, &status);
 
                 if (recVal) {
                     // Save results
-                    matrixDeterminants[results[i-1].matrix_id - 1] = results[i-1].determinant;
-                    number_of_matrix_sent-= 1;
+                    int number_of_results;
+                    MPI_Get_count(&status, MPI_BYTE, &number_of_results);
+                    number_of_results /= sizeof(struct MatrixResults);
+                    for (int r = 0; r < number_of_results; r++) {
+                        matrixDeterminants[results[i-1][r].matrix_id - 1] = results[i-1][r].determinant;
+                        matrixExponents[results[i-1][r].matrix_id - 1] = results[i-1][r].exponent;
+                    }
+                    if (exact)
+                        receiveExact(i);
+                    number_of_batches_sent-= 1;
                     msgRec[i-1] = false;
                 }
             }
         }
     }
-    
+
     /* close the text file */
 
     fclose(fpointer);
 
-    /* Receive results of last matrix from workers */
-    while (number_of_matrix_sent > 0) {
+    /* Receive results of last batches from workers */
+    double wait_start = MPI_Wtime();
+    while (number_of_batches_sent > 0) {
 
         for (int i = 1; i <= number_of_workers; i++) {
-            
+
             recVal = 0;
 
             if (!msgRec[i-1]) {
-                MPI_Irecv(&results[i-1], sizeof(struct MatrixResults), MPI_BYTE, i, 0, MPI_COMM_WORLD, &reqRec[i-1]);
+                MPI_Start(&reqRec[i-1]);
                 msgRec[i-1] = true;
             }
 
-            MPI_Test(&reqRec[i-1], &recVal, MPI_STATUS_IGNORE);
+            MPI_Test(&reqRec[i-1], &recVal, &status);
 
             if (recVal) {
                 // Save results
-                matrixDeterminants[results[i-1].matrix_id - 1] = results[i-1].determinant;
-                number_of_matrix_sent-= 1;
+                int number_of_results;
+                MPI_Get_count(&status, MPI_BYTE, &number_of_results);
+                number_of_results /= sizeof(struct MatrixResults);
+                for (int r = 0; r < number_of_results; r++) {
+                    matrixDeterminants[results[i-1][r].matrix_id - 1] = results[i-1][r].determinant;
+                    matrixExponents[results[i-1][r].matrix_id - 1] = results[i-1][r].exponent;
+                }
+                if (exact)
+                    receiveExact(i);
+                number_of_batches_sent-= 1;
                 msgRec[i-1] = false;
             }
         }
 
     }
+    dispatcherWaitTime += MPI_Wtime() - wait_start;
 
     /* Send message to each process to know that there are no more matrix to process */
 
+    MPI_Wait(&reqLast, MPI_STATUS_IGNORE);
     for (int i = 1; i <= number_of_workers; i++) {
-        double * lastMatrix = malloc(order_of_matrix * order_of_matrix * sizeof(double) + sizeof(int));
-        lastMatrix[0] = 0;
+        MPI_Waitall(2, reqSnd[i-1], MPI_STATUSES_IGNORE);
+
+        // Special batch without matrices
+        MPI_Send(batches[i-1][0], 0, matrixType, i, 0, workComm);
+
+        for (int b = 0; b < 2; b++) {
+            MPI_Request_free(&reqSnd[i-1][b]);
+            free(batches[i-1][b]);
+        }
+        MPI_Request_free(&reqRec[i-1]);
+        free(results[i-1]);
+    }
 
-        // Send Special Matrix to Worker
-        MPI_Isend(lastMatrix, (1 + order_of_matrix * order_of_matrix) * sizeof(double) + sizeof(int), MPI_BYTE, i, 0, MPI_COMM_WORLD, &reqSnd[i-1]);
-    } 
+    MPI_Type_free(&matrixType);
 
+    *order = order_of_matrix;
     return number_of_matrix;
 }
 
 
+/**
+ *  \brief Function receiveExact.
+ *
+ *  Its role is to receive the exact determinants of the batch whose results were just received from a worker: they
+ *  follow the results, as "id determinant" lines of text, and are saved in matrixExact.
+ *
+ *  \param source worker process identification
+ */
+static void receiveExact(int source) {
+    MPI_Status status;
+    int length;
+
+    MPI_Probe(source, 2, workComm, &status);
+    MPI_Get_count(&status, MPI_CHAR, &length);
+    char * text = malloc(length + 1);
+    MPI_Recv(text, length, MPI_CHAR, source, 2, workComm, MPI_STATUS_IGNORE);
+    text[length] = '\0';
+
+    for (char * line = strtok(text, "\n"); line != NULL; line = strtok(NULL, "\n")) {
+        char * value = strchr(line, ' ');
+        *value = '\0';
+        matrixExact[atoi(line) - 1] = strdup(value + 1);
+    }
+
+    free(text);
+}
+
+
+/**
+ *  \brief Function dismissWorkers.
+ *
+ *  Its role is to let each worker know that there is no work to do.
+ *  With the two-level dispatch tree, the sub-dispatchers let the workers of their node know.
+ */
+static void dismissWorkers() {
+    int params[3] = {-1, -1, -1};
+
+    for (int i = 1; i <= number_of_workers; i++) {
+        // Send Special Message to Worker
+        MPI_Send(params, 3, MPI_INT, i, 1, workComm);
+    }
+}
+
+
+/**
+ *  \brief Function createMatrixType.
+ *
+ *  Its role is to create the datatype of a matrix in a batch: its header (id and order) followed by its coefficients.
+ *  Every matrix has the same order, so every matrix of a batch has the same size.
+ *
+ *  \param order_of_matrix order of the matrices
+ */
+static void createMatrixType(int order_of_matrix) {
+    int block_lengths[2] = {2, order_of_matrix * order_of_matrix};
+    MPI_Aint displacements[2] = {offsetof(struct MatrixHeader, matrix_id), sizeof(struct MatrixHeader)};
+    MPI_Datatype types[2] = {MPI_INT, MPI_DOUBLE};
+    MPI_Datatype structType;
+
+    matrixSize = sizeof(struct MatrixHeader) + order_of_matrix * order_of_matrix * sizeof(double);
+
+    MPI_Type_create_struct(2, block_lengths, displacements, types, &structType);
+    MPI_Type_create_resized(structType, 0, matrixSize, &matrixType);
+    MPI_Type_commit(&matrixType);
+    MPI_Type_free(&structType);
+}
+
+
 /**
  *  \brief Function worker.
  *
- *  Its role is to receive matrices of data and compute the determinant.
+ *  Its role is to receive batches of matrices, store them in the FIFO of its threads and send the determinants back.
  *
- *  \param par pointer to application defined worker identification
+ *  \param rank worker process identification
+ *
+ *  \return false if there was no work to do
  */
-static void worker(int rank) {
+static bool worker(int rank) {
 
-    MPI_Request reqSnd;
-    
-    int order_of_matrix;
-    MPI_Recv(&order_of_matrix, sizeof(int), MPI_INT, 0, 1, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    MPI_Request reqSnd = MPI_REQUEST_NULL, reqRec[2];
+    MPI_Request reqText = MPI_REQUEST_NULL;         // Request of the exact determinants of the previous batch
+    char * text = NULL;                             // Exact determinants of the previous batch, as text
+    MPI_Status status;
+    int *status_p;
+
+    // Receive the order of the matrices, number of threads and batch size
+    int params[3];
+    MPI_Recv(params, 3, MPI_INT, 0, 1, workComm, MPI_STATUS_IGNORE);
+
+    // Checks if it is the message that tells that there is no work to do
+    if (params[0] <= 0) return false;
+
+    int order_of_matrix = params[0];
+    num_of_threads = params[1];
+    int batch_size = params[2];
+    createMatrixType(order_of_matrix);
+
+    // The kernels and the tile width chosen by autotune for each order (computeDet.profile), or the built-in heuristics
+    det_init(NULL);
+
+    // The exact mode needs, at most, the primes of the Hadamard bound of a matrix of integers of 62 bits of this order
+    if (exact) {
+        initPrimes(primesForOrder(order_of_matrix));
+        batchExact = malloc(batch_size * sizeof(char *));
+    }
+
+    /* generate worker threads */
+
+    statusWorkers = malloc(num_of_threads * sizeof(int));   // Allocate memory to save the status of each thread
+    pthread_t tIdWorkers[num_of_threads];
+    unsigned int workers[num_of_threads];
+    for (int i = 0; i < num_of_threads; i++)
+        workers[i] = i;
+
+    for (int i = 0; i < num_of_threads; i++)
+    if (pthread_create (&tIdWorkers[i], NULL, threadWorker, &workers[i]) != 0)                      /* thread worker */
+    { perror ("error on creating thread worker");
+        exit (EXIT_FAILURE);
+    }
 
+    // Alocate memory to read the batches (double buffering) and save its results
+    unsigned char * batches[2];
+    batchResults = malloc(batch_size * sizeof(struct MatrixResults));
+
+    // Both buffers wait for a batch, so the next batch is received while the threads process the current one
+    for (int b = 0; b < 2; b++) {
+        batches[b] = malloc(batch_size * matrixSize);
+        MPI_Recv_init(batches[b], batch_size, matrixType, 0, 0, workComm, &reqRec[b]);
+        MPI_Start(&reqRec[b]);
+    }
+
+    int b = 0;      // Buffer of the current batch
     while (true) {
-        // Get matrix
-        struct MatrixInfo newMatrix;
+        // Get batch
+        MPI_Wait(&reqRec[b], &status);
+        int number_of_matrix_in_batch;
+        MPI_Get_count(&status, matrixType, &number_of_matrix_in_batch);
 
-        // Alocate memory to read the matrix information
-        newMatrix.matrix_pointer = malloc(  (1 + order_of_matrix * order_of_matrix) * sizeof(double) + sizeof(int));
-        MPI_Recv(newMatrix.matrix_pointer, (1 + order_of_matrix * order_of_matrix) * sizeof(double) + sizeof(int), MPI_BYTE, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
-        
         // Checks if it is the message that tells that there are no more matrices to process
-        if ( (int) newMatrix.matrix_pointer[0] == 0) break;
+        if (number_of_matrix_in_batch == 0) break;
+
+        // The results of the previous batch must have been sent before being overwritten
+        MPI_Wait(&reqSnd, MPI_STATUS_IGNORE);
+        MPI_Wait(&reqText, MPI_STATUS_IGNORE);
+        free(text);
+        text = NULL;
+        batchFirstId = ((struct MatrixHeader *) batches[b])->matrix_id;
+
+        // Save matrices in FIFO: at small orders, runs of MATRICES_PER_THREAD matrices, for the batched kernels
+        int run = (det_backend(order_of_matrix, MATRICES_PER_THREAD, NULL) == DET_BATCHED) ? MATRICES_PER_THREAD : 1;
+        for (int i = 0; i < number_of_matrix_in_batch; i += run) {
+            struct MatrixHeader * header = (struct MatrixHeader *) (batches[b] + i * matrixSize);
+            addPending();
+            putMatrix((double *) (header + 1), header->order_of_matrix, header->matrix_id,
+                      (i + run < number_of_matrix_in_batch) ? run : number_of_matrix_in_batch - i);
+        }
+
+        // Wait until the threads have processed every matrix
+        waitPending();
 
-        // Convert info to struct MatrinInfo
-        newMatrix.matrix_id = (int) newMatrix.matrix_pointer[0];
-        newMatrix.order_of_matrix = order_of_matrix;
-        newMatrix.matrix_pointer = newMatrix.matrix_pointer + 1;
-        
-        // Process matrix
-        double determinant = 1;
-        computeDeterminant(&newMatrix, &determinant);
-        
-        // Free the memory of the buffer
-        free(newMatrix.matrix_pointer-1);
-        
         // Send results back to dispatcher
-        struct MatrixResults results;
-        results.matrix_id = newMatrix.matrix_id;
-        results.determinant = determinant;
+        MPI_Isend(batchResults, number_of_matrix_in_batch * sizeof(struct MatrixResults), MPI_BYTE, 0, 0, workComm, &reqSnd);
+
+        // Followed by the exact determinants, as "id determinant" lines
+        if (exact) {
+            size_t length = 0;
+            for (int i = 0; i < number_of_matrix_in_batch; i++)
+                length += strlen(batchExact[i]) + 16;
+            text = malloc(length + 1);
+            length = 0;
+            for (int i = 0; i < number_of_matrix_in_batch; i++) {
+                length += sprintf(text + length, "%d %s\n", batchFirstId + i, batchExact[i]);
+                free(batchExact[i]);
+            }
+            MPI_Isend(text, length, MPI_CHAR, 0, 2, workComm, &reqText);
+        }
 
-        // Save result
-        MPI_Isend(&results, sizeof(struct MatrixResults), MPI_BYTE, 0, 0, MPI_COMM_WORLD, &reqSnd);
+        // The buffer waits for the batch after the next one
+        MPI_Start(&reqRec[b]);
+        b = 1 - b;
     }
 
+    MPI_Wait(&reqSnd, MPI_STATUS_IGNORE);
+    MPI_Wait(&reqText, MPI_STATUS_IGNORE);
+    free(text);
+
+    // The other buffer is still waiting for a batch that will never come
+    MPI_Cancel(&reqRec[1-b]);
+    MPI_Wait(&reqRec[1-b], MPI_STATUS_IGNORE);
+    for (int i = 0; i < 2; i++) {
+        MPI_Request_free(&reqRec[i]);
+        free(batches[i]);
+    }
+    MPI_Type_free(&matrixType);
+
+    /* save a struct in fifo for each thread to know that there are no more matrices to process */
+
+    for (int i = 0; i < num_of_threads; i++) {
+        endMatrix();
+    }
+
+    /* waiting for the termination of the worker threads */
+
+    for (int i = 0; i < num_of_threads; i++)
+    { if (pthread_join (tIdWorkers[i], (void *) &status_p) != 0)
+        { perror ("error on waiting for thread worker");
+            exit (EXIT_FAILURE);
+        }
+    }
+
+    free(batchResults);
+    free(batchExact);
+    free(statusWorkers);
+
+    return true;
 }
 
 
 /**
- *  \brief Function to compute the determinant of a matrix. 
+ *  \brief Function sub-dispatcher.
+ *
+ *  Its role, in the two-level dispatch tree, is to receive large batches of matrices from the dispatcher,
+ *  split them in batches for the workers of its node and send the determinants of each large batch back to the dispatcher.
  *
- *  \param matrixinfo pointer to the struct MatrixInfo containing the information about the matrix
- *  \param determinant pointer to a double to save the determinant value
+ *  \return false if there was no work to do
  */
-static void computeDeterminant(struct MatrixInfo * matrixinfo, double * determinant) {
+static bool subDispatcher() {
 
-    // Get information about the matrix
-    int order_of_matrix = (*matrixinfo).order_of_matrix;
-    double *matrix_pointer = (*matrixinfo).matrix_pointer;
+    // Receive the order of the matrices, number of threads and size of the large batches
+    int params[3];
+    MPI_Recv(params, 3, MPI_INT, 0, 1, leaderComm, MPI_STATUS_IGNORE);
 
-    // Define matrix coeficients structure (2D Array)
-    double matrix_coeficients[order_of_matrix][order_of_matrix];
+    // Checks if it is the message that tells that there is no work to do
+    if (params[0] <= 0) {
+        dismissWorkers();
+        return false;
+    }
 
-    // Read Matrix Coefficients from buffer and save it to 2D array
-    for (int l = 0; l < order_of_matrix; l++) {
-        int line_offset = l * order_of_matrix;
-        for (int column = 0; column < order_of_matrix; column++) {
-            double coefficient = *(matrix_pointer + column + line_offset);
-            matrix_coeficients[l][column] = coefficient;
-        }
+    int order_of_matrix = params[0];
+    num_of_threads = params[1];
+    int node_batch_size = params[2];
+    createMatrixType(order_of_matrix);
+
+    // Each batch of a worker of the node has enough matrices to keep all its threads busy
+    int batch_size = num_of_threads * MATRICES_PER_THREAD;
+
+    // Send a message with the order of the matrices, number of threads and batch size to the workers of the node
+    int workerParams[3] = {order_of_matrix, num_of_threads, batch_size};
+    for (int i = 1; i <= number_of_workers; i++) {
+        MPI_Send(workerParams, 3, MPI_INT, i, 1, workComm);
     }
 
-    // Transform Matrix in a upper triangular matrix
-    for (int l = 0; l < order_of_matrix-1; l++) {
-        if (matrix_coeficients[l][l] != 0.0) {
-            
-            for(int k=l+1; k<order_of_matrix; k++){
-                double  term=matrix_coeficients[k][l]/ matrix_coeficients[l][l];
-                for(int j=0; j< order_of_matrix; j++){
-                    matrix_coeficients[k][j]=matrix_coeficients[k][j]-term*matrix_coeficients[l][j];
-                }
-            }
+    MPI_Request reqSnd[number_of_workers], reqRec[number_of_workers], reqNode;
+    MPI_Status status;
 
-        } else {
-            // Find column != 0.0 to be changed
-            int columnToChange = -1;
-            for (int j=l+1; j<order_of_matrix; j++) {
-                if (matrix_coeficients[l][j] != 0.0) {
-                    columnToChange = j;
-                }
-            }
+    for (int i = 0; i < number_of_workers; i++) {
+        reqSnd[i] = MPI_REQUEST_NULL;
+        reqRec[i] = MPI_REQUEST_NULL;
+    }
 
-            if (columnToChange == -1) {
-                *determinant = 0;
-                break;
-            } else {
-                int temp;
-                for (int i = 0; i < order_of_matrix; ++i) {
-                    temp = matrix_coeficients[i][l - 1];
-                    matrix_coeficients[i][l - 1] = matrix_coeficients[i][columnToChange - 1];
-                    matrix_coeficients[i][columnToChange - 1] = temp;
-                }
+    // Alocate memory to read the large batches and save its results
+    unsigned char * nodeBatch = malloc(node_batch_size * matrixSize);
+    struct MatrixResults * nodeResults = malloc(node_batch_size * sizeof(struct MatrixResults));
+    MPI_Recv_init(nodeBatch, node_batch_size, matrixType, 0, 0, leaderComm, &reqNode);
+
+    while (true) {
+        // Get large batch
+        double wait_start = MPI_Wtime();
+        MPI_Start(&reqNode);
+        MPI_Wait(&reqNode, &status);
+        dispatcherWaitTime += MPI_Wtime() - wait_start;
+
+        int number_of_matrix_in_node_batch;
+        MPI_Get_count(&status, matrixType, &number_of_matrix_in_node_batch);
+
+        // Checks if it is the message that tells that there are no more matrices to process
+        if (number_of_matrix_in_node_batch == 0) break;
+
+        // Split the large batch in batches for the workers of the node
+        for (int m = 0; m < number_of_matrix_in_node_batch; m += batch_size) {
+
+            int number_of_matrix_in_batch = (number_of_matrix_in_node_batch - m < batch_size) ? number_of_matrix_in_node_batch - m : batch_size;
+
+            // Choose a worker without a batch, or wait for the first one to send its results
+            int w = 0;
+            while (w < number_of_workers && reqRec[w] != MPI_REQUEST_NULL)
+                w++;
+            if (w == number_of_workers) {
+                wait_start = MPI_Wtime();
+                MPI_Waitany(number_of_workers, reqRec, &w, MPI_STATUS_IGNORE);
+                dispatcherWaitTime += MPI_Wtime() - wait_start;
             }
+            MPI_Wait(&reqSnd[w], MPI_STATUS_IGNORE);
 
+            /* Send Batch to Worker straight from the large batch and receive its results in the place of the batch */
+            MPI_Isend(nodeBatch + m * matrixSize, number_of_matrix_in_batch, matrixType, w+1, 0, workComm, &reqSnd[w]);
+            MPI_Irecv(nodeResults + m, number_of_matrix_in_batch * sizeof(struct MatrixResults), MPI_BYTE, w+1, 0, workComm, &reqRec[w]);
         }
+
+        // Wait for the results of the large batch and send them back to dispatcher
+        wait_start = MPI_Wtime();
+        MPI_Waitall(number_of_workers, reqRec, MPI_STATUSES_IGNORE);
+        MPI_Waitall(number_of_workers, reqSnd, MPI_STATUSES_IGNORE);
+        dispatcherWaitTime += MPI_Wtime() - wait_start;
+
+        MPI_Send(nodeResults, number_of_matrix_in_node_batch * sizeof(struct MatrixResults), MPI_BYTE, 0, 0, leaderComm);
     }
 
-    
-    // Calculate Determinant from upper triangular matrix  (Multiply Diagonal Values)
-    for(int l = 0; l < order_of_matrix; l++){
-        *determinant = *determinant*matrix_coeficients[l][l];
+    /* Send message to each process of the node to know that there are no more matrix to process */
+
+    for (int i = 1; i <= number_of_workers; i++) {
+        // Special batch without matrices
+        MPI_Send(nodeBatch, 0, matrixType, i, 0, workComm);
+    }
+
+    MPI_Request_free(&reqNode);
+    MPI_Type_free(&matrixType);
+    free(nodeBatch);
+    free(nodeResults);
+
+    return true;
+}
+
+
+/**
+ *  \brief Function buildDispatchTree.
+ *
+ *  Its role is to split the processes in nodes (processes sharing memory) for the two-level dispatch tree.
+ *  The first process of each node is its sub-dispatcher and talks with the dispatcher (rank 0).
+ *  A process alone in its node is a worker of the dispatcher.
+ *
+ *  \param rank process identification
+ *
+ *  \return role of the process
+ */
+static int buildDispatchTree(int rank) {
+
+    int node_rank = 0, node_size = 0;
+
+    // The dispatcher does not belong to any node
+    MPI_Comm_split_type(MPI_COMM_WORLD, (rank == 0) ? MPI_UNDEFINED : MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &nodeComm);
+    if (nodeComm != MPI_COMM_NULL) {
+        MPI_Comm_rank(nodeComm, &node_rank);
+        MPI_Comm_size(nodeComm, &node_size);
+    }
+
+    // The dispatcher and the first process of each node
+    MPI_Comm_split(MPI_COMM_WORLD, (rank == 0 || node_rank == 0) ? 0 : MPI_UNDEFINED, rank, &leaderComm);
+
+    if (rank == 0) {
+        workComm = leaderComm;
+        MPI_Comm_size(workComm, &number_of_workers);
+        number_of_workers -= 1;
+        batch_multiplier = NODE_BATCHES;
+        return DISPATCHER;
+    } else if (node_rank == 0 && node_size > 1) {
+        workComm = nodeComm;
+        number_of_workers = node_size - 1;
+        return SUB_DISPATCHER;
+    } else if (node_rank == 0) {
+        workComm = leaderComm;
+        return WORKER;
+    }
+
+    workComm = nodeComm;
+    return WORKER;
+}
+
+
+/**
+ *  \brief Function reportUtilization.
+ *
+ *  Its role is to print the fraction of the time the dispatchers of each level were not waiting for workers.
+ *  Every process takes part in the reduction of the values of the sub-dispatchers.
+ *
+ *  \param role role of the process
+ *  \param elapsed time spent by the process in its role
+ */
+static void reportUtilization(int role, double elapsed) {
+
+    double utilization = 0.0;
+    if (role != WORKER && elapsed > 0)
+        utilization = 100.0 * (1.0 - dispatcherWaitTime / elapsed);
+
+    double sub_dispatchers[2] = {0.0, 0.0};   // Sum of the utilization of the sub-dispatchers and number of sub-dispatchers
+    double max_utilization = 0.0;
+    if (role == SUB_DISPATCHER) {
+        sub_dispatchers[0] = utilization;
+        sub_dispatchers[1] = 1.0;
+        max_utilization = utilization;
     }
 
+    double total[2], max_total;
+    MPI_Reduce(sub_dispatchers, total, 2, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    MPI_Reduce(&max_utilization, &max_total, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+
+    if (role == DISPATCHER) {
+        printf("Dispatcher utilization (level 0) = %.1f %%\n", utilization);
+        if (total[1] > 0)
+            printf("Sub-dispatcher utilization (level 1, %d nodes) = %.1f %% average, %.1f %% maximum\n",
+                   (int) total[1], total[0] / total[1], max_total);
+    }
+}
+
+
+/**
+ *  \brief Function thread worker.
+ *
+ *  Its role is to get matrices from the FIFO of its worker process and compute the determinant.
+ *
+ *  \param par pointer to application defined thread identification
+ */
+static void *threadWorker(void *par) {
+    unsigned int id = *((unsigned int *) par);      // thread id
+    uint64_t * scratch = NULL;                      // matrix being decomposed modulo a prime, in the exact mode
+    uint64_t * residues = NULL;                     // determinant modulo each prime, in the exact mode
+    double * lu = NULL;                             // aligned and padded matrix being decomposed (libdet)
+    double * packed = NULL;                         // matrices of a run, one after the other, for the batched kernels
+    double determinants[MATRICES_PER_THREAD];       // mantissas of the determinants of a run
+    int exponents[MATRICES_PER_THREAD];             // binary exponents of the determinants of a run
+
+    while (true) {
+        // Get a run of matrices (a single matrix, but at small orders)
+        struct MatrixInfo matrixinfo = getMatrix(id);
+
+        // Checks if it is the matrix struct that tells that there are no more matrices to process
+        if (matrixinfo.matrix_id == -1) break;
+
+        int order_of_matrix = matrixinfo.order_of_matrix;
+        size_t size = (size_t) order_of_matrix * order_of_matrix;
+        struct MatrixResults * results = batchResults + (matrixinfo.matrix_id - batchFirstId);
+
+        // Exact mode: the determinant modulo each prime of the matrix, combined by the Chinese remainder theorem
+        if (exact) {
+            if (scratch == NULL) {
+                scratch = malloc(size * sizeof(uint64_t));
+                residues = malloc(primesForOrder(order_of_matrix) * sizeof(uint64_t));
+            }
+            for (int m = 0; m < matrixinfo.number_of_matrices; m++) {
+                double * matrix = (double *) ((unsigned char *) matrixinfo.matrix_pointer + m * matrixSize);
+                int number_of_primes = primesNeeded(matrix, order_of_matrix, order_of_matrix);
+                for (int prime = 0; prime < number_of_primes; prime++)
+                    residues[prime] = determinantModulo(matrix, order_of_matrix, order_of_matrix, prime, scratch);
+                batchExact[matrixinfo.matrix_id - batchFirstId + m] = combineResidues(residues, number_of_primes);
+
+                results[m].matrix_id = matrixinfo.matrix_id + m;
+                results[m].determinant = 0;
+                results[m].exponent = 0;
+            }
+            removePending(id);
+            continue;
+        }
+
+        // The scratch buffer of the decompositions is allocated once (every matrix has the same order)
+        if (lu == NULL && (lu = det_scratch(order_of_matrix)) == NULL) {
+            perror("error on allocating the scratch buffer");
+            statusWorkers[id] = EXIT_FAILURE;
+            pthread_exit(&statusWorkers[id]);
+        }
+
+        // A run is packed first, so the batched kernels compute its determinants together
+        const double * matrices = matrixinfo.matrix_pointer;
+        if (matrixinfo.number_of_matrices > 1) {
+            if (packed == NULL)
+                packed = malloc(MATRICES_PER_THREAD * size * sizeof(double));
+            for (int m = 0; m < matrixinfo.number_of_matrices; m++)
+                memcpy(packed + m * size, (unsigned char *) matrixinfo.matrix_pointer + m * matrixSize, size * sizeof(double));
+            matrices = packed;
+        }
+
+        // Process matrices (libdet, P1/Prog2/det.c)
+        if (det_batch_r(matrices, order_of_matrix, matrixinfo.number_of_matrices, determinants,
+                        &(struct DetOptions) { DET_AUTO, exponents }, lu) != 0) {
+            perror("error on computing the determinant");
+            statusWorkers[id] = EXIT_FAILURE;
+            pthread_exit(&statusWorkers[id]);
+        }
+
+        // Save results
+        for (int m = 0; m < matrixinfo.number_of_matrices; m++) {
+            results[m].matrix_id = matrixinfo.matrix_id + m;
+            results[m].determinant = determinants[m];
+            results[m].exponent = exponents[m];
+        }
+
+        removePending(id);
+    }
+
+    free(scratch);
+    free(residues);
+    free(lu);
+    free(packed);
+
+    statusWorkers[id] = EXIT_SUCCESS;
+    pthread_exit (&statusWorkers[id]);
 }
@@ -0,0 +1,27 @@
+/**
+ *  \file probConst.h (interface file)
+ *
+ *  \brief Problem name: Compute Matrix Determinant.
+ *
+ *  Problem parameters.
+ *
+ *  \author Diogo Filipe Amaral Carvalho - 92969 - April 2022
+ *  \author Rafael Ferreira Baptista - 93367 - April 2022
+ */
+
+#ifndef PROBCONST_H_
+#define PROBCONST_H_
+
+/* Generic parameters */
+
+/** \brief data transfer region nominal capacity (in number of values that can be stored) in the FIFO of each worker process */
+#define  K            10
+
+/** \brief number of matrices of a batch sent to a worker process, for each of its threads */
+#define  MATRICES_PER_THREAD   4
+
+/** \brief number of batches of a worker process in each batch sent to the sub-dispatcher of a node (two-level dispatch tree) */
+#define  NODE_BATCHES   8
+
+
+#endif /* PROBCONST_H_ */
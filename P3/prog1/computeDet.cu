@@ -5,8 +5,13 @@
  *
  *  Concurrency based on CUDA with the approach of calculation of the determinant by columns, and comparison to CPU version.
  *
+ *  The determinants are computed on the CPU as well, to check the ones of the device, by a pool of threads that get the
+ *  matrices from the work queue of P1/Prog2 (chunks.c) and compute them by libdet (P1/Prog2/det.c), with the kernels of
+ *  the tuning profile of P1/Prog2/autotune, if there is one; with --cpu-only, only on the CPU, on a machine with no device.
+ *
  *  How to compile: make all
  *  How to run: ./computeDet -f mat128_32.bin
+ *              ./computeDet -t 8 --cpu-only -f mat128_32.bin
  *
  *  \author Diogo Filipe Amaral Carvalho - 92969 - June 2022
  *  \author Rafael Ferreira Baptista - 93367 - June 2022
@@ -19,15 +24,28 @@
 #include <stdbool.h>
 #include <libgen.h>
 #include <unistd.h> 
+#include <getopt.h>
+#include <pthread.h>
 
 #include "common.h"
 #include <cuda_runtime.h>
 
+extern "C" {
+#include "chunks.h"
+#include "det.h"
+#include "probConst.h"
+}
+
+/** \brief consumer threads return status array (of the work queue) */
+int *statusWorkers;
+
+/** \brief determinants computed by the cpu workers */
+static double * cpu_determinants;
+
 /* allusion to internal functions */
 
-/** \brief function to compute determinant of a matrix in cpu */
-static void calculate_determinant_cpu_kernel (double * matrix_pointer, double * determinant,
-                                              unsigned int order_of_matrix);
+/** \brief worker life cycle routine: it computes the determinants of the matrices of the work queue in cpu */
+static void *cpu_worker (void *par);
 
 /** \brief cuda kernel function to compute determinant of a matrix in gpu */
 __global__ static void calculate_determinant_cuda_kernel (double * __restrict__ mat, double * __restrict__ determinants,
@@ -53,11 +71,14 @@ int main (int argc, char **argv)
 
   int opt;            /* selected option */
   char *fName;        /* file name */
+  int num_of_threads = (int) sysconf (_SC_NPROCESSORS_ONLN);   /* number of cpu workers (all the cores by default) */
+  bool cpu_only = false;                                        /* the determinants are only computed in cpu */
+  static struct option long_options[] = { { "cpu-only", no_argument, NULL, 'C' }, { NULL, 0, NULL, 0 } };
 
   opterr = 0;
   do
   {
-      switch ((opt = getopt(argc, argv, "f:h")))
+      switch ((opt = getopt_long(argc, argv, "f:t:h", long_options, NULL)))
       {
       case 'f': /* file name */
           if (optarg[0] == '-')
@@ -69,6 +90,19 @@ int main (int argc, char **argv)
           }
           fName = optarg;
           break;
+      case 't': /* number of cpu workers */
+          if (atoi(optarg) <= 0)
+          {
+              fprintf(stderr, "%s: number of threads must be positive\n", basename(argv[0]));
+              printUsage(basename(argv[0]));
+
+              return EXIT_FAILURE;
+          }
+          num_of_threads = atoi(optarg);
+          break;
+      case 'C': /* cpu only mode */
+          cpu_only = true;
+          break;
       case 'h': /* help mode */
           printUsage(basename(argv[0]));
 
@@ -118,19 +152,21 @@ int main (int argc, char **argv)
 
   int dev = 0;
 
-  cudaDeviceProp deviceProp;
-  CHECK (cudaGetDeviceProperties (&deviceProp, dev));
-  printf("Using Device %d: %s\n", dev, deviceProp.name);
-  CHECK (cudaSetDevice (dev));
+  if (!cpu_only)
+     { cudaDeviceProp deviceProp;
+       CHECK (cudaGetDeviceProperties (&deviceProp, dev));
+       printf("Using Device %d: %s\n", dev, deviceProp.name);
+       CHECK (cudaSetDevice (dev));
+     }
 
-  /* create memory areas in host and device memory where the matrices data and determinants will be stored */
+  /* create memory areas in host and device memory (host only, in the cpu only mode) where the matrices and determinants will be stored */
 
   int mat_size = order_of_matrix * order_of_matrix * sizeof(double);
   size_t mat_area_size = number_of_matrix * mat_size;
   double * host_mat, * host_determinants;
   double * device_mat, * device_determinants;
 
-  if ((mat_area_size + number_of_matrix * sizeof(double)) > (size_t) 1.3e9)
+  if (!cpu_only && (mat_area_size + number_of_matrix * sizeof(double)) > (size_t) 1.3e9)
      { fprintf (stderr,"The GeForce GTX 1660 Ti cannot handle more than 5GB of memory!\n");
        exit (1);
      }
@@ -138,8 +174,10 @@ int main (int argc, char **argv)
   
   host_mat = (double *) malloc (mat_area_size);
   host_determinants = (double *) malloc (number_of_matrix*sizeof(double));
-  CHECK (cudaMalloc ((void **) &device_mat, mat_area_size));
-  CHECK (cudaMalloc ((void **) &device_determinants, number_of_matrix*sizeof(double)));
+  if (!cpu_only)
+     { CHECK (cudaMalloc ((void **) &device_mat, mat_area_size));
+       CHECK (cudaMalloc ((void **) &device_determinants, number_of_matrix*sizeof(double)));
+     }
 
   /* initialize the host data */
 
@@ -156,160 +194,155 @@ int main (int argc, char **argv)
 
   printf ("The initialization of host data took %.3e seconds\n",get_delta_time ());
 
-  /* copy the host data to the device memory */
+  double *determinants = NULL;
 
-  (void) get_delta_time ();
-  CHECK (cudaMemcpy (device_mat, host_mat, mat_area_size, cudaMemcpyHostToDevice));
-  CHECK (cudaMemcpy (device_determinants, host_determinants, number_of_matrix * sizeof(double), cudaMemcpyHostToDevice));
-  printf ("The transfer of %d bytes from the host to the device took %.3e seconds\n",
-          (int) mat_area_size , get_delta_time ());
-
-  /* run the computational kernel */
-
-  unsigned int gridDimX,gridDimY,gridDimZ,blockDimX,blockDimY,blockDimZ;
-  int n_sectors, sector_size;
-
-  n_sectors = number_of_matrix * order_of_matrix;
-  sector_size = order_of_matrix;
-  blockDimX = order_of_matrix;
-  blockDimY = 1 << 0;                                             // optimize!
-  blockDimZ = 1 << 0;                                             // do not change!
-  gridDimX = number_of_matrix;
-  gridDimY = 1 << 0;                                              // optimize!
-  gridDimZ = 1 << 0;                                              // do not change!
-
-  dim3 grid (gridDimX, gridDimY, gridDimZ);
-  dim3 block (blockDimX, blockDimY, blockDimZ);
-
-  if ((gridDimX * gridDimY * gridDimZ * blockDimX * blockDimY * blockDimZ) != n_sectors)
-     { printf ("Wrong configuration!\n");
-       return 1;
-     }
-  (void) get_delta_time ();
-  calculate_determinant_cuda_kernel <<<grid, block>>> (device_mat, device_determinants, n_sectors, sector_size);
-  CHECK (cudaDeviceSynchronize ());                            // wait for kernel to finish
-  CHECK (cudaGetLastError ());                                 // check for kernel errors
-  printf("The CUDA kernel <<<(%d,%d,%d), (%d,%d,%d)>>> took %.3e seconds to run\n",
-         gridDimX, gridDimY, gridDimZ, blockDimX, blockDimY, blockDimZ, get_delta_time ());
+  if (!cpu_only) {
+
+    /* copy the host data to the device memory */
+
+    (void) get_delta_time ();
+    CHECK (cudaMemcpy (device_mat, host_mat, mat_area_size, cudaMemcpyHostToDevice));
+    CHECK (cudaMemcpy (device_determinants, host_determinants, number_of_matrix * sizeof(double), cudaMemcpyHostToDevice));
+    printf ("The transfer of %d bytes from the host to the device took %.3e seconds\n",
+            (int) mat_area_size , get_delta_time ());
+
+    /* run the computational kernel */
+
+    unsigned int gridDimX,gridDimY,gridDimZ,blockDimX,blockDimY,blockDimZ;
+    int n_sectors, sector_size;
+
+    n_sectors = number_of_matrix * order_of_matrix;
+    sector_size = order_of_matrix;
+    blockDimX = order_of_matrix;
+    blockDimY = 1 << 0;                                             // optimize!
+    blockDimZ = 1 << 0;                                             // do not change!
+    gridDimX = number_of_matrix;
+    gridDimY = 1 << 0;                                              // optimize!
+    gridDimZ = 1 << 0;                                              // do not change!
+
+    dim3 grid (gridDimX, gridDimY, gridDimZ);
+    dim3 block (blockDimX, blockDimY, blockDimZ);
+
+    if ((gridDimX * gridDimY * gridDimZ * blockDimX * blockDimY * blockDimZ) != n_sectors)
+       { printf ("Wrong configuration!\n");
+         return 1;
+       }
+    (void) get_delta_time ();
+    calculate_determinant_cuda_kernel <<<grid, block>>> (device_mat, device_determinants, n_sectors, sector_size);
+    CHECK (cudaDeviceSynchronize ());                            // wait for kernel to finish
+    CHECK (cudaGetLastError ());                                 // check for kernel errors
+    printf("The CUDA kernel <<<(%d,%d,%d), (%d,%d,%d)>>> took %.3e seconds to run\n",
+           gridDimX, gridDimY, gridDimZ, blockDimX, blockDimY, blockDimZ, get_delta_time ());
 
-  /* copy kernel result back to host side */
+    /* copy kernel result back to host side */
 
-  double *determinants;
-  determinants = (double *) malloc (number_of_matrix*sizeof(double));
-  CHECK (cudaMemcpy (determinants, device_determinants, number_of_matrix*sizeof(double), cudaMemcpyDeviceToHost));
-  printf ("The transfer of %d bytes from the device to the host took %.3e seconds\n",
-          (int) mat_area_size, get_delta_time ());
+    determinants = (double *) malloc (number_of_matrix*sizeof(double));
+    CHECK (cudaMemcpy (determinants, device_determinants, number_of_matrix*sizeof(double), cudaMemcpyDeviceToHost));
+    printf ("The transfer of %d bytes from the device to the host took %.3e seconds\n",
+            (int) mat_area_size, get_delta_time ());
 
-  /* free device global memory */
+    /* free device global memory */
 
-  CHECK (cudaFree (device_mat));
-  CHECK (cudaFree (device_determinants));
+    CHECK (cudaFree (device_mat));
+    CHECK (cudaFree (device_determinants));
 
-  /* reset the device */
+    /* reset the device */
 
-  CHECK (cudaDeviceReset ());
+    CHECK (cudaDeviceReset ());
 
-  /* compute the determinants on the CPU */
+  }
+
+  /* compute the determinants on the CPU, the matrices handed out to the workers by the work queue */
 
   (void) get_delta_time ();
-  double *cpu_determinants;
   cpu_determinants = (double *) malloc (number_of_matrix*sizeof(double));
-  
-  for (int i = 0; i < number_of_matrix; i++) {
-    cpu_determinants[i] = 1;
-    calculate_determinant_cpu_kernel (host_mat + (i*order_of_matrix*order_of_matrix), &cpu_determinants[i], order_of_matrix);
+  det_init (NULL);
+  initMatrices (host_mat, number_of_matrix, order_of_matrix, (order_of_matrix <= BATCH_MAX_ORDER) ? MATRICES_PER_BATCH : 1);
+
+  statusWorkers = (int *) malloc (num_of_threads * sizeof (int));
+  pthread_t tIdWorkers[num_of_threads];
+  unsigned int workers[num_of_threads];
+  int *status_p;
+
+  for (int i = 0; i < num_of_threads; i++)
+  { workers[i] = i;
+    if (pthread_create (&tIdWorkers[i], NULL, cpu_worker, &workers[i]) != 0)                    /* thread worker */
+       { perror ("error on creating thread worker");
+         exit (EXIT_FAILURE);
+       }
   }
-  printf("The cpu kernel took %.3e seconds to run (single core)\n",get_delta_time ());
+  for (int i = 0; i < num_of_threads; i++)
+    if ((pthread_join (tIdWorkers[i], (void **) &status_p) != 0) || (*status_p != EXIT_SUCCESS))
+       { perror ("error on waiting for thread worker");
+         exit (EXIT_FAILURE);
+       }
+  printf("The cpu kernel took %.3e seconds to run (%d threads)\n", get_delta_time (), num_of_threads);
 
   /* show final results */
 
   for (int i = 0; i < number_of_matrix; i++) {
     printf("Processing matrix %d \n", i + 1);
-    printf("GPU Determinant: %.3e \nCPU Determinant: %.3e \n\n", determinants[i], cpu_determinants[i]);
+    if (cpu_only)
+       printf("CPU Determinant: %.3e \n\n", cpu_determinants[i]);
+    else printf("GPU Determinant: %.3e \nCPU Determinant: %.3e \n\n", determinants[i], cpu_determinants[i]);
   }
 
   /* compare results */
-  
-  for(int i = 0; i < number_of_matrix; i++) {
+
+  for(int i = 0; !cpu_only && i < number_of_matrix; i++) {
     if (fabs(determinants[i] / cpu_determinants[i]) > 1.0001 || fabs(determinants[i] / cpu_determinants[i]) < 0.9999 )
       { 
       printf ("Mismatch in matrix %d. GPU calculated %.4e CPU calculated %.4e \n", i, determinants[i], cpu_determinants[i]);
       exit(1);
       }
   }
-  printf ("All is well!\n");
+  if (!cpu_only)
+     printf ("All is well!\n");
 
   /* free host memory */
 
   free (host_mat);
   free (host_determinants);
   free (determinants);
+  free (cpu_determinants);
+  free (statusWorkers);
 
   return 0;
 }
 
 /**
- * @brief function to compute determinant of a matrix in cpu
- * 
- * @param matrix_pointer 
- * @param determinant 
- * @param order_of_matrix 
+ * @brief worker life cycle routine
+ *
+ * Its role is to get matrices (or runs of small matrices) from the work queue and compute their determinants in cpu,
+ * until there are no more matrices.
+ *
+ * @param par pointer to application defined worker identification
  */
-static void calculate_determinant_cpu_kernel (double * matrix_pointer, double * determinant,
-                                              unsigned int order_of_matrix)
+static void *cpu_worker (void *par)
 {
-  // Define matrix coeficients structure (2D Array)
-  double matrix_coeficients[order_of_matrix][order_of_matrix];
-
-  // Read Matrix Coefficients from buffer and save it to 2D array
-  for (int l = 0; l < order_of_matrix; l++) {
-      int line_offset = l * order_of_matrix;
-      for (int column = 0; column < order_of_matrix; column++) {
-          double coefficient = *(matrix_pointer + column + line_offset);
-          matrix_coeficients[l][column] = coefficient;
-      }
-  }
-
-  for (int l = 0; l < order_of_matrix-1; l++) {
-      if (matrix_coeficients[l][l] != 0.0) {
-          
-          for(int k=l+1; k<order_of_matrix; k++){
-              double term=matrix_coeficients[k][l]/ matrix_coeficients[l][l];
-              for(int j=0; j< order_of_matrix; j++){
-                  matrix_coeficients[k][j]=matrix_coeficients[k][j]-term*matrix_coeficients[l][j];
-              }
-          }
-
-      } else {
-          // Find column != 0.0 to be changed
-          int columnToChange = -1;
-          for (int j=l+1; j<order_of_matrix; j++) {
-              if (matrix_coeficients[l][j] != 0.0) {
-                  columnToChange = j;
-              }
-          }
-
-          if (columnToChange == -1) {
-              *determinant = 0;
-              break;
-          } else {
-              int temp;
-              for (int i = 0; i < order_of_matrix; ++i) {
-                  temp = matrix_coeficients[i][l - 1];
-                  matrix_coeficients[i][l - 1] = matrix_coeficients[i][columnToChange - 1];
-                  matrix_coeficients[i][columnToChange - 1] = temp;
-              }
-          }
-
-      }
-
-  }
-
-  // Calculate Determinant from upper triangular matrix (Multiply Diagonal Values)
-  for(int l = 0; l < order_of_matrix; l++){
-      *determinant = *determinant*matrix_coeficients[l][l];
+  unsigned int id = *((unsigned int *) par);                                                       /* worker id */
+  double * scratch = NULL;                               /* aligned and padded matrix being decomposed, allocated once */
+
+  while (true)
+  { struct MatrixInfo matrixinfo = getMatrix (id);
+    if (matrixinfo.matrix_id == -1)                                          /* there are no more matrices to process */
+       break;
+    if ((scratch == NULL) && ((scratch = det_scratch (matrixinfo.order_of_matrix)) == NULL))
+       { perror ("error on allocating the scratch buffer");
+         statusWorkers[id] = EXIT_FAILURE;
+         pthread_exit (&statusWorkers[id]);
+       }
+    if (det_batch_r (matrixinfo.matrix_pointer, matrixinfo.order_of_matrix, matrixinfo.number_of_matrices,
+                     &cpu_determinants[matrixinfo.matrix_id - 1], NULL, scratch) != 0)      /* libdet, P1/Prog2/det.c */
+       { perror ("error on computing the determinants in cpu");
+         statusWorkers[id] = EXIT_FAILURE;
+         pthread_exit (&statusWorkers[id]);
+       }
   }
 
+  free (scratch);
+  statusWorkers[id] = EXIT_SUCCESS;
+  pthread_exit (&statusWorkers[id]);
 }
 
 /**
@@ -407,7 +440,9 @@ static void printUsage(char *cmdName)
 {
     fprintf(stderr, "\nSynopsis: %s OPTIONS [filename]\n"
                     "  OPTIONS:\n"
-                    "  -h      --- print this help\n"
-                    "  -f      --- filename\n",
+                    "  -h          --- print this help\n"
+                    "  -f          --- filename\n"
+                    "  -t          --- number of cpu threads (all the cores by default)\n"
+                    "  --cpu-only  --- compute the determinants only in cpu (no device is needed)\n",
             cmdName);
 }
\ No newline at end of file